@@ -120,6 +120,8 @@ check_symbol_exists(mkstemp "stdlib.h;unistd.h" HAVE_MKSTEMP)
 check_symbol_exists(mktemp "stdlib.h;unistd.h" HAVE_MKTEMP)
 if( NOT LLVM_ON_WIN32 )
   check_symbol_exists(pthread_mutex_lock pthread.h HAVE_PTHREAD_MUTEX_LOCK)
+  check_symbol_exists(pthread_rwlock_init pthread.h HAVE_PTHREAD_RWLOCK_INIT)
+  check_symbol_exists(pthread_getspecific pthread.h HAVE_PTHREAD_GETSPECIFIC)
 endif()
 check_symbol_exists(sbrk unistd.h HAVE_SBRK)
 check_symbol_exists(strdup string.h HAVE_STRDUP)
@@ -140,6 +142,12 @@ IF (HAVE_LONG_LONG AND HAVE_UNSIGNED_LONG_LONG)
     SET(YASM_HAVE_LONG_LONG 1)
 ENDIF (HAVE_LONG_LONG AND HAVE_UNSIGNED_LONG_LONG)
 
+# 128-bit integers (used for intermediate IntNum results)
+CHECK_CXX_SOURCE_COMPILES("
+__extension__ typedef __int128 int128;
+int main() { int128 x = 1; x <<= 100; return static_cast<int>(x >> 100) - 1; }
+" YASM_HAVE_INT128)
+
 set(headers "")
 if (HAVE_SYS_TYPES_H)
   set(headers ${headers} "sys/types.h")
@@ -215,18 +223,47 @@ endif( MSVC )
 # FIXME: Signal handler return type, currently hardcoded to 'void'
 set(RETSIGTYPE void)
 
-#if( LLVM_ENABLE_THREADS )
-#  if( HAVE_PTHREAD_H OR WIN32 )
-#    set(ENABLE_THREADS 1)
-#  endif( HAVE_PTHREAD_H OR WIN32 )
-#endif( LLVM_ENABLE_THREADS )
-#
-#if( ENABLE_THREADS )
-#  message(STATUS "Threads enabled.")
-#else( ENABLE_THREADS )
-#  message(STATUS "Threads disabled.")
-#endif( ENABLE_THREADS )
-set(LLVM_HAS_ATOMICS 0)
+# Threads (pthreads only for now)
+# The LLVM support library locks (Mutex, SmartMutex, ManagedStatic) are no-ops
+# unless LLVM_ENABLE_THREADS is set, so it must follow YASM_ENABLE_THREADS.
+set(LIBPTHREAD "")
+set(LLVM_ENABLE_THREADS 0)
+if( ENABLE_THREADS AND HAVE_PTHREAD_H AND HAVE_LIBPTHREAD
+    AND HAVE_PTHREAD_MUTEX_LOCK )
+  set(YASM_ENABLE_THREADS 1)
+  set(LLVM_ENABLE_THREADS 1)
+  set(LIBPTHREAD "pthread")
+  message(STATUS "Threads enabled.")
+else( ENABLE_THREADS AND HAVE_PTHREAD_H AND HAVE_LIBPTHREAD
+      AND HAVE_PTHREAD_MUTEX_LOCK )
+  message(STATUS "Threads disabled.")
+endif( ENABLE_THREADS AND HAVE_PTHREAD_H AND HAVE_LIBPTHREAD
+       AND HAVE_PTHREAD_MUTEX_LOCK )
+
+# Thread-local storage class
+CHECK_CXX_SOURCE_COMPILES("
+static __thread int x;
+int main() { return x; }
+" YASM_HAVE_GCC_THREAD)
+if( NOT YASM_HAVE_GCC_THREAD )
+  CHECK_CXX_SOURCE_COMPILES("
+static __declspec(thread) int x;
+int main() { return x; }
+" YASM_HAVE_DECLSPEC_THREAD)
+endif( NOT YASM_HAVE_GCC_THREAD )
+
+# Atomic builtins (used for statistics counters)
+if( MSVC )
+  set(LLVM_HAS_ATOMICS 1)
+else( MSVC )
+  CHECK_CXX_SOURCE_COMPILES("
+int main() {
+  volatile unsigned int x = 0;
+  __sync_add_and_fetch(&x, 1);
+  return __sync_val_compare_and_swap(&x, 1, 0);
+}
+" LLVM_HAS_ATOMICS)
+endif( MSVC )
 
 if(WIN32)
   if(CYGWIN)
@@ -620,6 +657,11 @@ CONFIGURE_FILE(
     include/yasmx/Config/longlong.h.cmake
     ${CMAKE_CURRENT_BINARY_DIR}/include/yasmx/Config/longlong.h
     )
+CONFIGURE_FILE(
+    include/yasmx/Config/threads.h.cmake
+    ${CMAKE_CURRENT_BINARY_DIR}/include/yasmx/Config/threads.h
+    )
+
 IF(BUILD_TESTS)
     CONFIGURE_FILE(
         unittests/unittest_config.h.cmake
@@ -26,7 +26,11 @@
 //
 #include "config.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/STLExtras.h"
@@ -38,6 +42,7 @@
 #include "llvm/Support/system_error.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/FileSystemStatCache.h"
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Frontend/DiagnosticOptions.h"
 #include "yasmx/Frontend/TextDiagnosticPrinter.h"
@@ -45,7 +50,9 @@
 #include "yasmx/Parse/HeaderSearch.h"
 #include "yasmx/Parse/Parser.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Support/registry.h"
+#include "yasmx/Support/ThreadPool.h"
 #include "yasmx/System/plugin.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Assembler.h"
@@ -90,10 +97,11 @@ static cl::extrahelp help_tail(
     "\n"
     "Sample invocation:\n"
     "   yasm -f elf -o object.o source.asm\n"
+    "   yasm -f elf -j 4 a.asm b.asm c.asm\n"
     "\n"
     "Report bugs to bug-yasm@tortall.net\n");
 
-static cl::opt<std::string> in_filename(cl::Positional,
+static cl::list<std::string> in_filenames(cl::Positional,
     cl::desc("file"));
 
 // -a, --arch
@@ -223,6 +231,14 @@ static cl::alias list_filename_long("list",
     cl::value_desc("listfile"),
     cl::aliasopt(list_filename));
 
+// -j
+static cl::opt<unsigned int> num_jobs("j",
+    cl::desc("Assemble up to N input files at once, or optimize the sections "
+             "of a single input file with N threads (0 for one per CPU)"),
+    cl::value_desc("N"),
+    cl::Prefix,
+    cl::init(1));
+
 // -M
 static cl::opt<bool> generate_make_dependencies("M",
     cl::desc("generate Makefile dependencies on stdout"));
@@ -291,6 +307,16 @@ static cl::opt<bool> error_stdout("s",
     cl::desc("redirect error messages to stdout"),
     cl::ZeroOrMore);
 
+// --span-hints
+static cl::opt<std::string> span_hints_filename("span-hints",
+    cl::desc("Reuse jump sizes found by the last assembly of the same "
+             "input, and update them in <file>"),
+    cl::value_desc("file"));
+
+// --time-report
+static cl::opt<bool> time_report("time-report",
+    cl::desc("Print the time taken by each assembly phase"));
+
 // -U, -u
 static cl::list<std::string> undefine_macros("U",
     cl::desc("Undefine a macro"),
@@ -521,6 +547,51 @@ ConfigureObject(Object& object)
     }
 }
 
+typedef std::vector<std::pair<unsigned int, std::string> > PositionedOptions;
+
+template <typename T>
+static void
+AddPositionedOptions(PositionedOptions& opts,
+                     const char* name,
+                     const cl::list<T>& list)
+{
+    for (unsigned int i=0; i<list.size(); ++i)
+    {
+        std::string str;
+        llvm::raw_string_ostream os(str);
+        os << name << '=' << list[i];
+        opts.push_back(std::make_pair(list.getPosition(i), os.str()));
+    }
+}
+
+// Describe the options that can change the assembled output, so that span
+// hints are only reused by an equivalent assembly.  Options such as
+// --stats or -o don't matter, and positions only matter relative to
+// each other.
+static std::string
+GetSpanHintsOptions()
+{
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    os << full_version << '\0' << arch_keyword << '\0' << parser_keyword
+       << '\0' << machine_name << '\0' << objfmt_keyword << '\0'
+       << dbgfmt_keyword << '\0' << force_strict << '\0' << optimize_level;
+
+    PositionedOptions opts;
+    AddPositionedOptions(opts, "N", plugin_names);
+    AddPositionedOptions(opts, "I", include_paths);
+    AddPositionedOptions(opts, "D", predefine_macros);
+    AddPositionedOptions(opts, "U", undefine_macros);
+    AddPositionedOptions(opts, "P", preinclude_files);
+    AddPositionedOptions(opts, "execstack", execstack);
+    AddPositionedOptions(opts, "noexecstack", noexecstack);
+    std::sort(opts.begin(), opts.end());
+    for (PositionedOptions::const_iterator i=opts.begin(), end=opts.end();
+         i != end; ++i)
+        os << '\0' << i->second;
+    return os.str();
+}
+
 static void
 ApplyPreprocessorBuiltins(Preprocessor& preproc)
 {
@@ -692,7 +763,9 @@ do_preproc_only(void)
 }
 #endif
 static int
-do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
+do_assemble(const std::string& in_filename,
+            SourceManager& source_mgr,
+            DiagnosticsEngine& diags)
 {
     // Apply warning settings
     ApplyWarningSettings(diags);
@@ -704,10 +777,23 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     if (diags.hasFatalErrorOccurred())
         return EXIT_FAILURE;
 
+    assembler.setTimeReport(time_report);
+
+    // Batch jobs already run in parallel; only a single file uses threads
+    // to optimize its sections.
+    if (in_filenames.size() == 1)
+        assembler.setOptimizeThreads(num_jobs == 0 ?
+                                     ThreadPool::getHardwareConcurrency() :
+                                     num_jobs);
+
     // Set object filename if specified.
     if (!obj_filename.empty())
         assembler.setObjectFilename(obj_filename);
 
+    // A hints file describes a single input.
+    if (!span_hints_filename.empty() && in_filenames.size() == 1)
+        assembler.setSpanHints(span_hints_filename, GetSpanHintsOptions());
+
     // Set parser.
     assembler.setParser(parser_keyword, diags);
 
@@ -824,6 +910,112 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     return EXIT_SUCCESS;
 }
 
+static void
+InitDiagnosticOptions(DiagnosticOptions& diag_opts)
+{
+    diag_opts.Format = ewmsg_style;
+    diag_opts.ShowOptionNames = 1;
+    diag_opts.ShowSourceRanges = 1;
+}
+
+// One input file of a multiple file assembly.
+struct BatchJob
+{
+    std::string in_filename;
+    std::string diag_output;    // diagnostics, printed once all jobs finish
+    int status;
+};
+
+static void
+RunBatchJob(BatchJob* job, const SharedStatCache::StatMap* stat_calls)
+{
+    llvm::raw_string_ostream os(job->diag_output);
+    DiagnosticOptions diag_opts;
+    InitDiagnosticOptions(diag_opts);
+    TextDiagnosticPrinter diag_printer(os, diag_opts);
+    IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine diags(diagids, &diag_printer, false);
+    FileSystemOptions opts;
+    FileManager file_mgr(opts);
+    file_mgr.addStatCache(new SharedStatCache(*stat_calls));
+    SourceManager source_mgr(diags, file_mgr);
+    diags.setSourceManager(&source_mgr);
+    diag_printer.setPrefix("yasm");
+
+    job->status = do_assemble(job->in_filename, source_mgr, diags);
+    os.flush();
+}
+
+// Assemble each input file with its own Assembler, running up to num_jobs
+// of them at once.  Each file's object filename is derived from its name.
+static int
+do_assemble_batch(DiagnosticsEngine& diags)
+{
+    // Each object filename is derived from the input's base name, so inputs
+    // with the same base name in different directories would write the
+    // same object file at the same time.
+    std::auto_ptr<ObjectFormatModule> objfmt_module =
+        LoadModule<ObjectFormatModule>(objfmt_keyword);
+    std::map<std::string, std::string> obj_inputs;
+    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+         end=in_filenames.end(); i != end; ++i)
+    {
+        std::string obj = Assembler::getDefaultObjectFilename(*i,
+            objfmt_module->getExtension());
+        std::pair<std::map<std::string, std::string>::iterator, bool> ins =
+            obj_inputs.insert(std::make_pair(obj, *i));
+        if (!ins.second)
+        {
+            diags.Report(diag::fatal_objfile_duplicate)
+                << ins.first->second << *i << obj;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Stat the inputs and search directories once for all of the jobs.
+    SharedStatCache::StatMap stat_calls;
+    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+         end=in_filenames.end(); i != end; ++i)
+        SharedStatCache::Add(stat_calls, i->c_str());
+    for (std::vector<std::string>::const_iterator i=include_paths.begin(),
+         end=include_paths.end(); i != end; ++i)
+        SharedStatCache::Add(stat_calls, i->c_str());
+    for (std::vector<std::string>::const_iterator i=preinclude_files.begin(),
+         end=preinclude_files.end(); i != end; ++i)
+        SharedStatCache::Add(stat_calls, i->c_str());
+
+    std::vector<BatchJob> jobs(in_filenames.size());
+    unsigned int nthreads = num_jobs;
+    if (nthreads == 0)
+        nthreads = ThreadPool::getHardwareConcurrency();
+    if (nthreads > jobs.size())
+        nthreads = jobs.size();
+
+    {
+        // A single job runs everything on this thread.
+        ThreadPool pool(nthreads > 1 ? nthreads : 0);
+        for (std::size_t i=0; i<jobs.size(); ++i)
+        {
+            jobs[i].in_filename = in_filenames[i];
+            jobs[i].status = EXIT_FAILURE;
+            pool.Async(TR1::bind(&RunBatchJob, &jobs[i], &stat_calls));
+        }
+        pool.Wait();
+    }
+
+    // Report diagnostics in input file order.
+    int status = EXIT_SUCCESS;
+    for (std::vector<BatchJob>::const_iterator i=jobs.begin(), end=jobs.end();
+         i != end; ++i)
+    {
+        *errfile << i->diag_output;
+        if (i->status != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+    errfile->flush();
+    return status;
+}
+
 // main function
 int
 main(int argc, char* argv[])
@@ -868,9 +1060,7 @@ main(int argc, char* argv[])
         errfile.reset(new llvm::raw_stderr_ostream);
 
     DiagnosticOptions diag_opts;
-    diag_opts.Format = ewmsg_style;
-    diag_opts.ShowOptionNames = 1;
-    diag_opts.ShowSourceRanges = 1;
+    InitDiagnosticOptions(diag_opts);
     TextDiagnosticPrinter diag_printer(*errfile, diag_opts);
     IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
     DiagnosticsEngine diags(diagids, &diag_printer, false);
@@ -944,12 +1134,25 @@ main(int argc, char* argv[])
 
     // Require an input filename.  We don't use llvm::cl facilities for this
     // as we want to allow e.g. "yasm --license".
-    if (in_filename.empty())
+    if (in_filenames.empty())
     {
         diags.Report(diag::fatal_no_input_files);
         return EXIT_FAILURE;
     }
 
+    // With multiple input files, each object filename is derived from its
+    // input filename.
+    if (in_filenames.size() > 1 && !obj_filename.empty())
+    {
+        diags.Report(diag::fatal_objfile_multiple_inputs);
+        return EXIT_FAILURE;
+    }
+
+    // A hints file describes a single input; do_assemble() doesn't use it
+    // for batch jobs.
+    if (in_filenames.size() > 1 && !span_hints_filename.empty())
+        diags.Report(diag::warn_span_hints_multiple_inputs);
+
     // If not already specified, default to bin as the object format.
     if (objfmt_keyword.empty())
         objfmt_keyword = "bin";
@@ -971,6 +1174,8 @@ main(int argc, char* argv[])
             listfmt_keyword = "nasm";
     }
 
-    return do_assemble(source_mgr, diags);
+    if (in_filenames.size() > 1)
+        return do_assemble_batch(diags);
+    return do_assemble(in_filenames[0], source_mgr, diags);
 }
 
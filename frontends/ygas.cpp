@@ -163,6 +163,10 @@ static cl::opt<std::string> obj_filename("o",
     cl::value_desc("filename"),
     cl::Prefix);
 
+// --time-report
+static cl::opt<bool> time_report("time-report",
+    cl::desc("Print the time taken by each assembly phase"));
+
 // -w
 static cl::opt<bool> ignored_w("w",
     cl::desc("Ignored"),
@@ -378,6 +382,8 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     if (diags.hasFatalErrorOccurred())
         return EXIT_FAILURE;
 
+    assembler.setTimeReport(time_report);
+
     // Set object filename if specified.
     if (!obj_filename.empty())
         assembler.setObjectFilename(obj_filename);
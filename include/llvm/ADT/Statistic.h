@@ -33,6 +33,11 @@
 namespace llvm {
 class raw_ostream;
 
+/// Set by -stats or EnableStatistics().  Counters are left untouched while
+/// this is false, so the atomic updates below are only paid for when the
+/// statistics will actually be printed.
+extern YASM_LIB_EXPORT bool StatisticsEnabled;
+
 class YASM_LIB_EXPORT Statistic {
 public:
   const char *Name;
@@ -58,6 +63,7 @@ public:
   }
 
   const Statistic &operator++() {
+    if (!StatisticsEnabled) return *this;
     // FIXME: This function and all those that follow carefully use an
     // atomic operation to update the value safely in the presence of
     // concurrent accesses, but not to read the return value, so the
@@ -67,6 +73,7 @@ public:
   }
 
   unsigned operator++(int) {
+    if (!StatisticsEnabled) return Value;
     init();
     unsigned OldValue = Value;
     sys::AtomicIncrement(&Value);
@@ -74,11 +81,13 @@ public:
   }
 
   const Statistic &operator--() {
+    if (!StatisticsEnabled) return *this;
     sys::AtomicDecrement(&Value);
     return init();
   }
 
   unsigned operator--(int) {
+    if (!StatisticsEnabled) return Value;
     init();
     unsigned OldValue = Value;
     sys::AtomicDecrement(&Value);
@@ -86,27 +95,42 @@ public:
   }
 
   const Statistic &operator+=(const unsigned &V) {
-    if (!V) return *this;
+    if (!V || !StatisticsEnabled) return *this;
     sys::AtomicAdd(&Value, V);
     return init();
   }
 
   const Statistic &operator-=(const unsigned &V) {
-    if (!V) return *this;
+    if (!V || !StatisticsEnabled) return *this;
     sys::AtomicAdd(&Value, -V);
     return init();
   }
 
   const Statistic &operator*=(const unsigned &V) {
+    if (!StatisticsEnabled) return *this;
     sys::AtomicMul(&Value, V);
     return init();
   }
 
   const Statistic &operator/=(const unsigned &V) {
+    if (!StatisticsEnabled) return *this;
     sys::AtomicDiv(&Value, V);
     return init();
   }
 
+  /// updateMax - Raise the value to V if it is currently less than V.
+  const Statistic &updateMax(unsigned V) {
+    if (!StatisticsEnabled) return *this;
+    sys::cas_flag OldValue = Value;
+    while (V > (unsigned)OldValue) {
+      sys::cas_flag Prev = sys::CompareAndSwap(&Value, V, OldValue);
+      if (Prev == OldValue)
+        break;
+      OldValue = Prev;
+    }
+    return init();
+  }
+
 protected:
   Statistic &init() {
     bool tmp = Initialized;
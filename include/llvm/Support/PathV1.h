@@ -598,6 +598,14 @@ namespace sys {
       static const char *MapInFilePages(int FD, size_t FileSize,
                                         off_t Offset);
 
+      /// MapInFilePagesWithZeroPage - Like MapInFilePages, but additionally
+      /// maps a zero filled page directly after the file pages.  This allows
+      /// a file that is an exact multiple of the page size to be mapped as a
+      /// null terminated buffer.  The extra page is released by calling
+      /// UnMapFilePages with a size that covers it.
+      static const char *MapInFilePagesWithZeroPage(int FD, size_t FileSize,
+                                                    off_t Offset);
+
       /// UnMapFilePages - Free pages mapped into the current process by
       /// MapInFilePages.
       ///
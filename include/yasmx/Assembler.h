@@ -29,6 +29,8 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <string>
+
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
@@ -41,6 +43,7 @@ namespace yasm
 {
 
 class Arch;
+class Arena;
 class ArchModule;
 class DebugFormat;
 class DebugFormatModule;
@@ -54,6 +57,7 @@ class ObjectFormat;
 class ObjectFormatModule;
 class Parser;
 class ParserModule;
+struct PhaseTimers;
 class SourceManager;
 
 /// An assembler.
@@ -89,6 +93,14 @@ public:
     /// @param obj_filename     object filename (e.g. "file.o")
     void setObjectFilename(StringRef obj_filename);
 
+    /// Determine the object filename used for a source filename when none
+    /// is set with setObjectFilename().
+    /// @param in_filename      source filename
+    /// @param extension        object format extension (e.g. ".o")
+    /// @return Object filename.
+    static std::string getDefaultObjectFilename(StringRef in_filename,
+                                                StringRef extension);
+
     /// Set the machine of architecture; if not set prior to assembly,
     /// determined by object format.
     /// @param machine          machine name
@@ -144,6 +156,26 @@ public:
     /// @return True on success, false on failure.
     bool Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags);
 
+    /// Enable or disable timing of each assembly phase.  If enabled, a
+    /// report is printed when the assembler is destroyed (see
+    /// llvm::TimerGroup).
+    /// @param enable           true to time each phase
+    void setTimeReport(bool enable);
+
+    /// Set the number of threads used to optimize sections concurrently.
+    /// @param nthreads         number of threads; 0 or 1 to optimize on
+    ///                         the calling thread
+    void setOptimizeThreads(unsigned int nthreads);
+
+    /// Read and update span (e.g. jump size) hints in a file, so that
+    /// assembling the same input again starts optimization from the sizes
+    /// found last time.  The hints are only used if the sources and
+    /// options are unchanged.
+    /// @param filename         hints filename; empty to not use hints
+    /// @param options          anything besides the sources that affects
+    ///                         assembly (e.g. the command line)
+    void setSpanHints(StringRef filename, StringRef options);
+
     /// Write assembly results to output file.  Fails if assembly not
     /// performed first.
     /// @param os               output stream
@@ -172,6 +204,11 @@ private:
     util::scoped_ptr<DebugFormatModule> m_dbgfmt_module;
     util::scoped_ptr<ListFormatModule> m_listfmt_module;
 
+    /// Arena for bytecodes, their contents and fixups, expressions, and
+    /// relocations.  Declared before everything that may hold memory
+    /// allocated from it, so it is destroyed last.
+    util::scoped_ptr<Arena> m_arena;
+
     util::scoped_ptr<Arch> m_arch;
     util::scoped_ptr<Parser> m_parser;
     util::scoped_ptr<ObjectFormat> m_objfmt;
@@ -180,9 +217,14 @@ private:
 
     util::scoped_ptr<Object> m_object;
 
+    util::scoped_ptr<PhaseTimers> m_timers;
+
     std::string m_obj_filename;
     std::string m_machine;
     Assembler::ObjectDumpTime m_dump_time;
+    unsigned int m_optimize_threads;
+    std::string m_hints_filename;
+    std::string m_hints_options;
 };
 
 } // namespace yasm
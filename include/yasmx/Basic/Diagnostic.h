@@ -1032,8 +1032,9 @@ inline const DiagnosticBuilder &operator<<(const DiagnosticBuilder &DB,
 inline DiagnosticBuilder DiagnosticsEngine::Report(SourceLocation Loc,
                                             unsigned DiagID){
   assert(CurDiagID == ~0U && "Multiple diagnostics in flight at once!");
-  assert(SourceMgr != 0 && "Generated unexpected diagnostic!");
-  CurDiagLoc = FullSourceLoc(Loc, *SourceMgr);
+  // The location is kept raw; it is only resolved against the source
+  // manager by consumers that need to (an engine may have none).
+  CurDiagLoc = Loc;
   CurDiagID = DiagID;
   return DiagnosticBuilder(this);
 }
@@ -1285,6 +1286,50 @@ class IgnoringDiagConsumer : public DiagnosticConsumer {
   }
 };
 
+/// \brief A diagnostic client that records diagnostics so they can later be
+/// reported to another DiagnosticsEngine.
+///
+/// Diagnostics are kept in their raw form (ID, location and arguments), so
+/// when replayed they are subject to the target engine's mappings and are
+/// counted by it as if they had been reported there directly.  This lets
+/// work running on another thread report through its own engine and have
+/// the results merged in a deterministic order afterwards.  The reporting
+/// engine needs no source manager, so the worker never touches the shared one.
+class YASM_LIB_EXPORT DeferredDiagConsumer : public DiagnosticConsumer {
+public:
+  DeferredDiagConsumer();
+  ~DeferredDiagConsumer();
+
+  void HandleDiagnostic(DiagnosticsEngine::Level DiagLevel,
+                        const Diagnostic &Info);
+  DiagnosticConsumer *clone(DiagnosticsEngine &Diags) const;
+  void clear();
+
+  /// \brief Determine whether any diagnostics have been recorded.
+  bool empty() const { return Recorded.empty(); }
+
+  /// \brief Report each recorded diagnostic to \p Diags, in the order they
+  /// were originally reported.
+  void Replay(DiagnosticsEngine &Diags) const;
+
+private:
+  struct Arg {
+    DiagnosticsEngine::ArgumentKind Kind;
+    intptr_t Val;
+    std::string Str;
+  };
+
+  struct Record {
+    unsigned ID;
+    SourceLocation Loc;
+    std::vector<Arg> Args;
+    std::vector<CharSourceRange> Ranges;
+    std::vector<FixItHint> FixIts;
+  };
+
+  std::vector<Record> Recorded;
+};
+
 /// Special character that the diagnostic printer will use to toggle the bold
 /// attribute.  The character itself will be not be printed.
 const char ToggleHighlight = 127;
@@ -101,6 +101,29 @@ public:
                                int *FileDescriptor);
 };
 
+/// \brief A stat "cache" that answers from a table of 'stat' results
+/// gathered ahead of time, going to the file system for any other path.
+/// The table is never modified by lookups, so one table may be shared by
+/// FileManagers running on different threads.
+class YASM_LIB_EXPORT SharedStatCache : public FileSystemStatCache {
+public:
+  typedef llvm::StringMap<struct stat, llvm::BumpPtrAllocator> StatMap;
+
+  /// \brief Use the stat results in \p StatCalls, which must outlive this
+  /// cache and not be modified while it is in use.
+  explicit SharedStatCache(const StatMap &StatCalls) : StatCalls(StatCalls) {}
+
+  /// \brief Stat \p Path and record the result in \p StatCalls if the path
+  /// exists.
+  static void Add(StatMap &StatCalls, const char *Path);
+
+  virtual LookupResult getStat(const char *Path, struct stat &StatBuf,
+                               int *FileDescriptor);
+
+private:
+  const StatMap &StatCalls;
+};
+
 } // end namespace yasm
 
 #endif
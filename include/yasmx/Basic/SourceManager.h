@@ -59,6 +59,7 @@ class SourceManager;
 class FileManager;
 class FileEntry;
 class LineTableInfo;
+struct LineEntry;
 class LangOptions;
 class ASTWriter;
 class ASTReader;
@@ -1559,6 +1560,54 @@ private:
 
   friend class ASTReader;
   friend class ASTWriter;
+  friend class SourceLineCursor;
+};
+
+/// \brief Maps a series of source locations to presumed file names and line
+/// numbers.
+///
+/// A lookup in the same file as the previous one, at or after it, steps
+/// forward through the file's line offsets and line directives from where the
+/// previous lookup left off.  Visiting the locations of a file in source order
+/// thus takes amortized constant time per lookup, where getPresumedLoc()
+/// searches the line table every time.  Other lookups fall back to a binary
+/// search.  The results match those of getPresumedLoc().
+class YASM_LIB_EXPORT SourceLineCursor {
+  const SourceManager &SM;
+
+  /// \brief The file of the previous lookup.
+  FileID FID;
+
+  /// \brief The name of the file, ignoring line directives.
+  const char *FileName;
+
+  /// \brief The offsets of the lines of the file.
+  const unsigned *LineStarts;
+  unsigned NumLines;
+
+  /// \brief The line directives of the file, or null if it has none.
+  const std::vector<LineEntry> *Entries;
+
+  /// \brief The file offset of the previous lookup.
+  unsigned Pos;
+
+  /// \brief The number of lines and of line directives at or before Pos.
+  unsigned LineNo;
+  unsigned NumEntries;
+
+  /// \brief The physical line number of the last line directive at or before
+  /// Pos.
+  unsigned MarkerLineNo;
+
+  bool EnterFile(FileID NewFID);
+
+public:
+  explicit SourceLineCursor(const SourceManager &SM);
+
+  /// \brief Look up the presumed file name and line number of \p Loc.
+  ///
+  /// \returns False if \p Loc is invalid or not in a file.
+  bool Lookup(SourceLocation Loc, const char **Filename, unsigned *Line);
 };
 
 /// \brief Comparison function object.
@@ -119,6 +119,16 @@ public:
   /// If there is no line entry before \p Offset in \p FID, returns null.
   const LineEntry *FindNearestLineEntry(FileID FID, unsigned Offset);
 
+  /// \brief Get the line entries of \p FID, sorted by offset.
+  ///
+  /// If there are no line entries in \p FID, returns null.
+  const std::vector<LineEntry> *getLineEntries(FileID FID) const {
+    std::map<FileID, std::vector<LineEntry> >::const_iterator I =
+      LineEntries.find(FID);
+    if (I == LineEntries.end() || I->second.empty()) return 0;
+    return &I->second;
+  }
+
   // Low-level access
   typedef std::map<FileID, std::vector<LineEntry> >::iterator iterator;
   iterator begin() { return LineEntries.begin(); }
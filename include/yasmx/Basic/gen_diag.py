@@ -220,6 +220,12 @@ add_fatal("fatal_file_open", "could not open file '%0'")
 add_fatal("fatal_standard_modules", "could not load standard modules")
 add_warning("warn_plugin_load", "could not load plugin '%0'")
 add_fatal("fatal_no_input_files", "no input files specified")
+add_fatal("fatal_objfile_multiple_inputs",
+          "cannot specify an object file name with multiple input files")
+add_fatal("fatal_objfile_duplicate",
+          "input files '%0' and '%1' would both write object file '%2'")
+add_warning("warn_span_hints_multiple_inputs",
+            "ignoring span hints file with multiple input files")
 add_fatal("fatal_unrecognized_module", "unrecognized %0 '%1'")
 add_warning("warn_unknown_command_line_option",
             "unknown command line argument '%0'; try '-help'")
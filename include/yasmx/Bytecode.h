@@ -37,6 +37,8 @@
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/Support/Arena.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/DebugDumper.h"
@@ -92,6 +94,12 @@ public:
         Contents();
         virtual ~Contents();
 
+        /// Contents are allocated from the current Arena (see Arena).
+        static void* operator new(std::size_t size)
+        { return Arena::Allocate(size); }
+        static void operator delete(void* p, std::size_t size)
+        { Arena::Deallocate(p, size); }
+
         /// Finalizes the bytecode after parsing.
         /// Called from Bytecode::Finalize().
         /// @param bc           bytecode
@@ -201,6 +209,12 @@ public:
     /// Create a bytecode of no type.
     Bytecode();
 
+    /// Bytecodes are allocated from the current Arena (see Arena).
+    static void* operator new(std::size_t size)
+    { return Arena::Allocate(size); }
+    static void operator delete(void* p, std::size_t size)
+    { Arena::Deallocate(p, size); }
+
     Bytecode(const Bytecode& oth);
     Bytecode& operator= (const Bytecode& rhs);
 
@@ -351,6 +365,13 @@ public:
               unsigned int size,
               std::auto_ptr<Expr> e,
               SourceLocation source);
+
+        /// Fixups are allocated from the current Arena (see Arena).
+        static void* operator new(std::size_t size)
+        { return Arena::Allocate(size); }
+        static void operator delete(void* p, std::size_t size)
+        { Arena::Deallocate(p, size); }
+
         void swap(Fixup& oth);
         unsigned int getOffset() const { return m_off; }
 
@@ -365,7 +386,16 @@ public:
         unsigned int m_off;
     };
 
-    void AppendFixup(const Fixup& fixup) { m_fixed_fixups.push_back(fixup); }
+    void AppendFixup(const Fixup& fixup)
+    { m_fixed_fixups.push_back(new Fixup(fixup)); }
+
+    /// Determine if the bytecode has any fixups in its fixed portion.
+    /// @return True if there are fixups.
+    bool hasFixups() const { return !m_fixed_fixups.empty(); }
+
+    /// Get the number of fixups in the fixed portion.
+    /// @return Number of fixups.
+    std::size_t getNumFixups() const { return m_fixed_fixups.size(); }
 
 #ifdef WITH_XML
     /// Write an XML representation.  For debugging purposes.
@@ -380,7 +410,8 @@ private:
     Bytes m_fixed;
 
     /// To allow combination of more complex values, fixups can be specified.
-    std::vector<Fixup> m_fixed_fixups;
+    stdx::ptr_vector<Fixup> m_fixed_fixups;
+    stdx::ptr_vector_owner<Fixup> m_fixed_fixups_owner;
 
     /// Implementation-specific tail.
     util::scoped_ptr<Contents> m_contents;
@@ -30,8 +30,10 @@
 /// @endlicense
 ///
 #include <memory>
+#include <vector>
 
 #include "yasmx/Basic/LLVM.h"
+#include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Support/EndianState.h"
 #include "yasmx/Support/ptr_vector.h"
@@ -48,7 +50,6 @@ class DiagnosticsEngine;
 class Expr;
 class IntNum;
 class Section;
-class SourceLocation;
 
 /// A bytecode container.
 class YASM_LIB_EXPORT BytecodeContainer
@@ -100,6 +101,37 @@ public:
 
     stdx::ptr_vector<Bytecode>::size_type size() { return m_bcs.size(); }
 
+    /// Where an instruction starts and the source location it came from.
+    /// An instruction's bytes may share a bytecode with others (e.g. when
+    /// they are only fixed bytes), so its bytecode source isn't enough.
+    struct InsnSource
+    {
+        Location loc;
+        SourceLocation source;
+    };
+    typedef std::vector<InsnSource> InsnSources;
+
+    /// Determine whether instruction starts are recorded.  They are only
+    /// needed for debug line information, so this is only true when the
+    /// object's TrackInsnSources option is set.
+    /// @return True if AddInsnSource() should be called.
+    bool isTrackingInsnSources() const;
+
+    /// Record where an appended instruction starts.
+    /// @param loc          start of the instruction (the end of the
+    ///                     container before it was appended)
+    /// @param source       source location of the instruction
+    void AddInsnSource(Location loc, SourceLocation source)
+    {
+        InsnSource insn = { loc, source };
+        m_insn_sources.push_back(insn);
+    }
+
+    /// Get the recorded instruction starts, in the order the instructions
+    /// were appended.
+    /// @return Instruction sources.
+    const InsnSources& getInsnSources() const { return m_insn_sources; }
+
     /// Get location for start of a bytecode container.
     Location getBeginLoc()
     {
@@ -121,11 +153,24 @@ public:
     /// @note Errors/warnings are stored into diags.
     void Optimize(DiagnosticsEngine& diags);
 
-    /// Update all bytecode offsets.
+    /// Update bytecode offsets.  Only the bytecodes from the first one
+    /// whose offset may have changed (see InvalidateOffsets()) onward are
+    /// visited.
     /// @param diags        diagnostic reporting
     /// @note Errors/warnings are stored into errwarns.
     void UpdateOffsets(DiagnosticsEngine& diags);
 
+    /// Note that the length of a bytecode has changed, so the offsets of
+    /// the bytecodes following it must be updated by the next
+    /// UpdateOffsets().  Bytecode indexes must have been set (as during
+    /// optimization).
+    /// @param bc           bytecode in this container
+    void InvalidateOffsets(const Bytecode& bc);
+
+    /// Note that the offsets of all bytecodes must be updated by the next
+    /// UpdateOffsets().
+    void InvalidateOffsets() { m_stale_offsets = 0; }
+
 #ifdef WITH_XML
     /// Write an XML representation.  For debugging purposes.
     /// @param out          XML node
@@ -145,6 +190,12 @@ private:
     stdx::ptr_vector_owner<Bytecode> m_bcs_owner;
 
     bool m_last_gap;        ///< Last bytecode is a gap bytecode
+
+    /// Position of the first bytecode whose offset may be stale.
+    stdx::ptr_vector<Bytecode>::size_type m_stale_offsets;
+
+    /// Instruction starts (see AddInsnSource()).
+    InsnSources m_insn_sources;
 };
 
 /// The factory functions append to the end of a section.
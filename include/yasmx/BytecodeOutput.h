@@ -170,6 +170,7 @@ private:
     DiagnosticsEngine& m_diags; ///< Diagnostic reporting
     Bytes m_scratch;            ///< Reusable scratch area
     Bytes m_bc_scratch;         ///< Reusable scratch area for Bytecode class
+    Value m_value_scratch;      ///< Reusable value for Bytecode class
     unsigned long m_num_output; ///< Total number of bytes+gap output
 };
 
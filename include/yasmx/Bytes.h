@@ -29,9 +29,11 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
-#include <vector>
+#include <iterator>
+#include <stdexcept>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
@@ -42,14 +44,20 @@
 namespace yasm
 {
 
-/// A vector of bytes.
+/// Number of bytes a Bytes stores inline; see Bytes::INLINE_SIZE.
+enum { BYTES_INLINE_SIZE = 16 };
+
+/// A vector of bytes.  Up to INLINE_SIZE bytes (enough for any single
+/// instruction encoding) are stored inline without a heap allocation.
 class YASM_LIB_EXPORT Bytes
-    : private std::vector<unsigned char>
+    : private SmallVector<unsigned char, BYTES_INLINE_SIZE>
     , public EndianState
 {
-    typedef std::vector<unsigned char> base_vector;
+    typedef SmallVector<unsigned char, BYTES_INLINE_SIZE> base_vector;
 
 public:
+    enum { INLINE_SIZE = BYTES_INLINE_SIZE };
+
     Bytes() {}
 
     template <class InputIterator>
@@ -64,6 +72,8 @@ public:
     typedef base_vector::value_type value_type;
     typedef base_vector::reverse_iterator reverse_iterator;
     typedef base_vector::const_reverse_iterator const_reverse_iterator;
+    typedef base_vector::pointer pointer;
+    typedef base_vector::const_pointer const_pointer;
 
     using base_vector::begin;
     using base_vector::end;
@@ -76,7 +86,7 @@ public:
     using base_vector::empty;
     using base_vector::reserve;
     using base_vector::operator[];
-    using base_vector::at;
+    using base_vector::data;
     using base_vector::front;
     using base_vector::back;
     using base_vector::assign;
@@ -86,6 +96,26 @@ public:
     using base_vector::erase;
     using base_vector::clear;
 
+    reference at(size_type n)
+    {
+        if (n >= size())
+            throw std::out_of_range("Bytes::at");
+        return (*this)[n];
+    }
+    const_reference at(size_type n) const
+    {
+        if (n >= size())
+            throw std::out_of_range("Bytes::at");
+        return (*this)[n];
+    }
+
+    template <class InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        clear();
+        insert(end(), first, last);
+    }
+
     void swap(Bytes& oth);
 
     /// Copy from a byte array, appending the values to the end.
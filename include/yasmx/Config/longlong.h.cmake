@@ -2,5 +2,6 @@
 #define YASM_LONGLONG_H
 
 #cmakedefine YASM_HAVE_LONG_LONG 1
+#cmakedefine YASM_HAVE_INT128 1
 
 #endif
@@ -0,0 +1,17 @@
+#ifndef YASM_THREADS_H
+#define YASM_THREADS_H
+
+#cmakedefine YASM_ENABLE_THREADS 1
+#cmakedefine YASM_HAVE_GCC_THREAD 1
+#cmakedefine YASM_HAVE_DECLSPEC_THREAD 1
+
+// Storage class for variables with a separate instance in each thread.
+#if defined(YASM_HAVE_GCC_THREAD)
+# define YASM_THREAD_LOCAL __thread
+#elif defined(YASM_HAVE_DECLSPEC_THREAD)
+# define YASM_THREAD_LOCAL __declspec(thread)
+#else
+# define YASM_THREAD_LOCAL
+#endif
+
+#endif
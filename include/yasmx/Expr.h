@@ -37,6 +37,7 @@
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/Arena.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Location.h"
@@ -384,6 +385,12 @@ public:
     /// Empty constructor.
     Expr() {}
 
+    /// Expressions are allocated from the current Arena (see Arena).
+    static void* operator new(std::size_t size)
+    { return Arena::Allocate(size); }
+    static void operator delete(void* p, std::size_t size)
+    { Arena::Deallocate(p, size); }
+
     /// Assign to expression.
     /// @param term     expression value
     template <typename T>
@@ -47,8 +47,11 @@ namespace yasm
 
 class Arch;
 class DiagnosticsEngine;
+class Optimizer;
 class Section;
+class SpanHints;
 class Symbol;
+class ThreadPool;
 
 /// An object.  This is the internal representation of an object file.
 class YASM_LIB_EXPORT Object
@@ -66,6 +69,10 @@ public:
 
         /// Alignment directives specify power-of-2.  Defaults to false.
         bool PowerOfTwoAlignment;
+
+        /// Record where each instruction starts in its container (see
+        /// BytecodeContainer::AddInsnSource()).  Defaults to false.
+        bool TrackInsnSources;
     };
 
     /// Generic object configuration.
@@ -117,9 +124,19 @@ public:
     /// Optimize an object.  Takes the unoptimized object and optimizes it.
     /// If successful, the object is ready for output to an object file.
     /// @param diags    diagnostic reporting
-    void Optimize(DiagnosticsEngine& diags);
-
-    /// Updates all bytecode offsets in object.
+    /// @param pool     if not NULL, thread pool used to optimize sections
+    ///                 concurrently
+    /// @param hints    if not NULL, hints from a previous assembly of the
+    ///                 same input; updated with this assembly's expansions
+    void Optimize(DiagnosticsEngine& diags,
+                  ThreadPool* pool = 0,
+                  SpanHints* hints = 0);
+
+    /// Updates bytecode offsets in object.  In each section, only the
+    /// bytecodes from the first stale one onward are visited, so callers
+    /// that change a bytecode's length must first mark it with
+    /// BytecodeContainer::InvalidateOffsets() (or invalidate the whole
+    /// section if the change can't be pinned to one bytecode).
     /// @param diags    diagnostic reporting
     void UpdateBytecodeOffsets(DiagnosticsEngine& diags);
 
@@ -255,6 +272,14 @@ private:
     Object(const Object&);                  // not implemented
     const Object& operator=(const Object&); // not implemented
 
+    /// Optimize steps 1c through 3, after Optimize() step 1b.
+    void OptimizeFinish(Optimizer& opt, DiagnosticsEngine& diags);
+
+    /// Optimize() with a separate optimizer for each section.
+    void OptimizeSections(DiagnosticsEngine& diags,
+                          ThreadPool& pool,
+                          SpanHints* hints);
+
     std::string m_src_filename;         ///< Source filename
     std::string m_obj_filename;         ///< Object filename
 
@@ -39,6 +39,7 @@ namespace yasm
 
 class Bytecode;
 class DiagnosticsEngine;
+class SpanHints;
 class Value;
 
 /// Optimizer.  Determines jump sizes, offset setters, all offsets.
@@ -69,6 +70,31 @@ public:
 
     // Step 3: update offsets
 
+    /// Determine if any span depends on a distance between bytecodes
+    /// outside the container of the span's own bytecode.  Such spans
+    /// prevent optimizing containers independently.  Only valid after
+    /// Step1b().
+    /// @return True if a span has such a dependency.
+    bool hasExternalTerms() const;
+
+    /// Move all spans and offset setters from another optimizer into this
+    /// one, as if they had been added to this optimizer after its own.
+    /// Used to combine per-container optimizers after Step1b().
+    /// @param oth          other optimizer; left empty
+    void Absorb(Optimizer& oth);
+
+    /// Use hints from a previous assembly of the same input: spans it
+    /// expanded are expanded in Step1b() instead of being discovered in
+    /// Step2(), which still verifies and completes the result.  The
+    /// expansions made are recorded for SaveHints().  Hints are only read
+    /// during the steps, so one set may be shared by several optimizers.
+    /// @param hints        hints (may be null)
+    void setHints(SpanHints* hints);
+
+    /// Add the expansions made to the hints given to setHints().  Must not
+    /// be called concurrently with other optimizers sharing the hints.
+    void SaveHints();
+
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
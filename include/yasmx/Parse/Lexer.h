@@ -32,6 +32,7 @@
 //
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "yasmx/Config/export.h"
 #include "yasmx/Parse/Token.h"
@@ -127,7 +128,7 @@ public:
     /// Forwarding function for diagnostics.  This translate a source
     /// position in the current buffer into a SourceLocation object for
     /// rendering.
-    DiagnosticBuilder Diag(const char* loc, unsigned diag_id) const;
+    DiagnosticBuilder Diag(const char* loc, unsigned diag_id);
 
     /// Return a source location identifier for the specified
     /// offset in the current file.
@@ -228,9 +229,17 @@ protected:
     /// Note that in raw mode that the PP pointer may be null.
     bool m_lexing_raw_mode;
 
-    /// Character information.
-    /// XXX: Make non-static.
+    /// If non-null, every token returned from this file is appended here so
+    /// that the preprocessor can replay the file if it is included again.
+    /// Dropped if the lexer issues a diagnostic, as a replay would not
+    /// repeat it.  Owned by the lexer.
+    std::vector<Token>* m_recorded_tokens;
+
+    /// Character information.  Filled in once at startup; lexers that
+    /// classify additional characters keep their own table.
     static unsigned char s_char_info[256];
+    static const bool s_char_info_init;
+    static bool InitCharacterInfo();
 
     /// Character types.
     enum
@@ -35,6 +35,7 @@
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallVector.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -52,6 +53,7 @@ namespace yasm
 {
 
 class DirectoryLookup;
+class FileEntry;
 class HeaderSearch;
 
 class YASM_LIB_EXPORT Preprocessor
@@ -123,6 +125,15 @@ public:
                          const DirectoryLookup* dir,
                          SourceLocation loc);
 
+    /// Enter an included file.  This is the same as EnterSourceFile(),
+    /// except that the tokens of a file that this preprocessor has already
+    /// lexed in full are replayed rather than lexed again.  Replayed tokens
+    /// have their locations moved into cur_file_id, so they read as if
+    /// lexed from it.
+    void EnterIncludeFile(FileID cur_file_id,
+                          const DirectoryLookup* dir,
+                          SourceLocation loc);
+
     /// Add a "macro" context to the top of the include stack,
     /// which will cause the lexer to start returning the specified tokens.
     ///
@@ -134,10 +145,14 @@ public:
     /// tokens has a permanent owner somewhere, so they do not need to be copied.
     /// If it is true, it assumes the array of tokens is allocated with new[] and
     /// must be freed.
+    ///
+    /// The stream is returned Repeat times in succession (not at all if Repeat
+    /// is 0); repeats replay the same tokens rather than copies of them.
     void EnterTokenStream(const Token* toks,
                           unsigned int num_toks,
                           bool disable_macro_expansion,
-                          bool owns_tokens);
+                          bool owns_tokens,
+                          unsigned long repeat = 1);
 
     /// Pop the current lexer/macro exp off the top of the
     /// lexer stack.  This should only be used in situations where the current
@@ -174,8 +189,14 @@ public:
     /// current lexer or macro object.
     void Lex(Token* result)
     {
-        if (m_cur_lexer.get() != 0)
-            m_cur_lexer->Lex(result);
+        if (Lexer* lexer = m_cur_lexer.get())
+        {
+            lexer->Lex(result);
+            // At the end of an included file the lexer has been popped (and
+            // deleted), and the token came from the includer.
+            if (m_cur_lexer.get() == lexer && lexer->m_recorded_tokens)
+                lexer->m_recorded_tokens->push_back(*result);
+        }
         else if (m_cur_token_lexer.get() != 0)
             m_cur_token_lexer->Lex(result);
         else
@@ -328,7 +349,12 @@ protected:
     enum
     {
         /// Maximum depth of includes.
-        MaxAllowedIncludeStackDepth = 200
+        MaxAllowedIncludeStackDepth = 200,
+
+        /// Largest include file whose tokens are recorded for replay.
+        /// Bigger files are rarely included twice, and their tokens take
+        /// several times the memory of the file itself.
+        MaxRecordedFileSize = 256*1024
     };
 
     // State that is set before the preprocessor begins.
@@ -373,6 +399,21 @@ protected:
     };
     std::vector<IncludeStackInfo> m_include_macro_stack;
 
+    /// Tokens of an include file recorded the first time it was lexed.
+    struct RecordedFile
+    {
+        RecordedFile() : tokens(0) {}
+
+        SourceLocation file_loc;    // start of the FileID lexed from
+        std::vector<Token>* tokens;
+    };
+
+    /// Recorded include files, for EnterIncludeFile().  These are kept
+    /// per preprocessor, and so per input file: recorded tokens point to
+    /// this preprocessor's identifiers and to buffers in its source
+    /// manager, so each job of a batch assembly records its own.
+    llvm::DenseMap<const FileEntry*, RecordedFile> m_recorded_files;
+
 #if 0
     /// These are actions invoked when some preprocessor activity is
     /// encountered (e.g. a file is #included, etc).
@@ -420,6 +461,12 @@ protected:
     /// Default implementation does nothing.
     virtual void RegisterBuiltinMacros();
 
+    /// Called when the lexer reaches the end of the top-level source buffer.
+    /// Preprocessors that produce the main source incrementally return the
+    /// FileID of the next piece to lex; an invalid FileID ends the main file.
+    /// Default implementation returns an invalid FileID.
+    virtual FileID FetchNextMainBuffer();
+
     /// Factory function to make a new lexer.
     virtual Lexer* CreateLexer(FileID fid,
                                const MemoryBuffer* input_buffer) = 0;
@@ -77,6 +77,11 @@ class YASM_LIB_EXPORT TokenLexer
     /// This is the next token that Lex will return.
     unsigned m_cur_token;
 
+    /// This is the number of passes over the Tokens array that remain,
+    /// including the current one.  Token streams may be replayed several
+    /// times in succession (e.g. for repeat directives) without copying.
+    unsigned long m_repeat;
+
     /// The source location range where this macro was expanded.
     SourceLocation m_expand_loc_start, m_expand_loc_end;
 
@@ -120,19 +125,22 @@ public:
     /// specified, this takes ownership of the tokens and delete[]'s them when
     /// the token lexer is empty.
     TokenLexer(const Token* tok_array, unsigned num_toks,
-               bool disable_expansion, bool owns_tokens, Preprocessor& pp)
+               bool disable_expansion, bool owns_tokens, Preprocessor& pp,
+               unsigned long repeat = 1)
         : /*m_macro(0), m_actual_args(0),*/ m_pp(pp), m_owns_tokens(false)
     {
-        Init(tok_array, num_toks, disable_expansion, owns_tokens);
+        Init(tok_array, num_toks, disable_expansion, owns_tokens, repeat);
     }
 
     /// Initialize this TokenLexer with the specified token stream.
     /// This does not take ownership of the specified token vector.
     ///
     /// DisableExpansion is true when macro expansion of tokens lexed from this
-    /// stream should be disabled.
+    /// stream should be disabled.  The stream is returned Repeat times in
+    /// succession (not at all if Repeat is 0).
     void Init(const Token* tok_array, unsigned num_toks,
-              bool disable_macro_expansion, bool owns_tokens);
+              bool disable_macro_expansion, bool owns_tokens,
+              unsigned long repeat = 1);
 
     ~TokenLexer() { destroy(); }
 
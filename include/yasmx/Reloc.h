@@ -33,6 +33,7 @@
 #include <string>
 
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/Arena.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
@@ -50,6 +51,12 @@ public:
     Reloc(const IntNum& addr, SymbolRef sym);
     virtual ~Reloc();
 
+    /// Relocations are allocated from the current Arena (see Arena).
+    static void* operator new(std::size_t size)
+    { return Arena::Allocate(size); }
+    static void operator delete(void* p, std::size_t size)
+    { Arena::Deallocate(p, size); }
+
     SymbolRef getSymbol() { return m_sym; }
     const SymbolRef getSymbol() const { return m_sym; }
 
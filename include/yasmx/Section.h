@@ -107,6 +107,12 @@ public:
     /// @param reloc        relocation
     void AddReloc(std::auto_ptr<Reloc> reloc);
 
+    /// Reserve space for the relocations expected from the fixups in the
+    /// section's bytecodes, so adding them doesn't repeatedly grow the
+    /// relocation list.  Object formats should call this before outputting
+    /// the section's bytecodes.
+    void ReserveRelocs();
+
     typedef stdx::ptr_vector<Reloc> Relocs;
     typedef Relocs::iterator reloc_iterator;
     typedef Relocs::const_iterator const_reloc_iterator;
@@ -0,0 +1,128 @@
+#ifndef YASM_SPANHINTS_H
+#define YASM_SPANHINTS_H
+///
+/// @file
+/// @brief Span value hints.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+class SourceManager;
+
+/// Span values remembered from a previous assembly of the same input.
+/// The optimizer normally starts every span-dependent bytecode (e.g. a
+/// jump) in its shortest form and expands it as needed; when the input is
+/// unchanged, the values that caused expansions last time can be used to
+/// expand those bytecodes up front, leaving the optimizer only to verify
+/// and fix up the result.
+///
+/// Hints are only used if the key (a digest of the options and all source
+/// buffers) matches the one they were written with: the optimizer never
+/// shrinks a bytecode, so a hint that is too large for edited code would
+/// make the output bigger than a clean build.  Hints are identified by
+/// section name, bytecode index within the section, and span ID, and each
+/// also records the span's value with every bytecode at its minimum
+/// length; a hint is only applied if that value is unchanged.
+class YASM_LIB_EXPORT SpanHints
+{
+public:
+    /// A span value that caused a bytecode to expand.
+    struct Hint
+    {
+        std::string section;    ///< section name
+        unsigned long index;    ///< bytecode index within section
+        int id;                 ///< span ID
+        long min_value;         ///< span value with minimum-length bytecodes
+        long value;             ///< span value
+
+        bool operator< (const Hint& rhs) const
+        {
+            int cmp = llvm::StringRef(section).compare(rhs.section);
+            return cmp < 0 || (cmp == 0 && (index < rhs.index ||
+                               (index == rhs.index && id < rhs.id)));
+        }
+    };
+
+    SpanHints();
+    ~SpanHints();
+
+    /// Compute the key identifying the input.  Must be called after
+    /// finalization, so that all included files are loaded.
+    /// @param options      anything else that affects assembly (e.g. the
+    ///                     command line)
+    /// @param smgr         source manager
+    void setKey(llvm::StringRef options, const SourceManager& smgr);
+
+    /// Read hints from a file.  Missing, unreadable, or corrupt files and
+    /// files written with a different key are silently ignored.
+    /// @param filename     filename
+    /// @return True if hints were loaded.
+    bool Read(llvm::StringRef filename);
+
+    /// Write the hints recorded with Add() to a file.
+    /// @param filename     filename
+    /// @return False if the file could not be written.
+    bool Write(llvm::StringRef filename) const;
+
+    /// Look up the hint for a span.
+    /// @param section      section name
+    /// @param index        bytecode index within section
+    /// @param id           span ID
+    /// @param min_value    span value with minimum-length bytecodes
+    /// @param value        span value (returned)
+    /// @return True if a hint was found and its minimum value matches.
+    bool Lookup(llvm::StringRef section,
+                unsigned long index,
+                int id,
+                long min_value,
+                /*@out@*/ long* value) const;
+
+    /// Record a hint for the next assembly.  A later hint for the same
+    /// section, bytecode index and span ID replaces an earlier one.
+    /// @param hint         hint
+    void Add(const Hint& hint) { m_new.push_back(hint); }
+
+private:
+    SpanHints(const SpanHints&);                    // not implemented
+    const SpanHints& operator=(const SpanHints&);   // not implemented
+
+    unsigned char m_key[16];
+    std::vector<Hint> m_old;    ///< hints read, sorted
+    std::vector<Hint> m_new;    ///< hints recorded, in order added
+};
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef YASM_SUPPORT_ARENA_H
+#define YASM_SUPPORT_ARENA_H
+///
+/// @file
+/// @brief Bump allocation arena interface.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+#include <cstddef>
+
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// A bump allocator for the objects of one assembly (such as bytecodes,
+/// their contents and expressions).  Allocations from an arena sit next to
+/// each other in large chunks instead of being separate heap blocks, and
+/// all of them are released at once when the arena is destroyed, so the
+/// arena must outlive everything allocated from it.  Classes opt in with
+/// operator new and delete that call Allocate() and Deallocate().
+///
+/// Allocate() draws from the arena made current for the calling thread with
+/// Scope, or from the heap if there is none.  An arena may be current on
+/// only one thread at a time.  Small blocks freed on that thread go on a
+/// free list for their size and are reused by later allocations of the
+/// same size; blocks freed on any other thread, and large blocks, stay
+/// allocated until the arena is destroyed.  Each allocation carries a
+/// pointer-sized header recording where it came from.
+///
+/// Bytecode, Bytecode::Contents, Fixup, Expr, and Reloc objects are
+/// allocated this way.  The fixed data of each bytecode, values and
+/// effective addresses are still allocated from the heap, and
+/// BytecodeContainer still keeps a vector of pointers to its bytecodes.
+class YASM_LIB_EXPORT Arena
+{
+public:
+    Arena();
+
+    /// Destructor.  Frees all memory allocated from the arena.
+    ~Arena();
+
+    /// Allocate memory from the current arena (or the heap).
+    /// @param size         size in bytes
+    /// @return Allocated memory, aligned for pointers, integers (including
+    ///         long long), and doubles.
+    static void* Allocate(std::size_t size);
+
+    /// Free memory returned by Allocate().
+    /// @param p            memory (may be NULL)
+    /// @param size         size passed to Allocate()
+    static void Deallocate(void* p, std::size_t size);
+
+    /// Makes an arena current for the calling thread for its lifetime.
+    class YASM_LIB_EXPORT Scope
+    {
+    public:
+        /// Constructor.
+        /// @param arena    arena (may be NULL to allocate from the heap)
+        explicit Scope(Arena* arena);
+        ~Scope();
+
+    private:
+        Scope(const Scope&);                    // not implemented
+        const Scope& operator=(const Scope&);   // not implemented
+
+        Arena* m_prev;
+    };
+
+private:
+    Arena(const Arena&);                    // not implemented
+    const Arena& operator=(const Arena&);   // not implemented
+
+    void* AllocateChunk(std::size_t size);
+
+    /// Number of free lists; blocks of up to this many header units
+    /// (besides the header itself) are reused.
+    enum { NUM_FREE_LISTS = 32 };
+
+    union Header;
+    struct Chunk;
+    Chunk* m_chunks;            ///< Most recently allocated chunk
+    char* m_cur;                ///< Next free byte in m_chunks
+    char* m_end;                ///< End of m_chunks
+    Header* m_free[NUM_FREE_LISTS]; ///< Freed blocks, by size
+};
+
+} // namespace yasm
+
+#endif
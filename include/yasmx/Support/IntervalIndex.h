@@ -0,0 +1,241 @@
+#ifndef YASM_SUPPORT_INTERVALINDEX_H
+#define YASM_SUPPORT_INTERVALINDEX_H
+///
+/// @file
+/// @brief Static interval index.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+
+namespace yasm
+{
+
+/// An interval index that is built once and then only queried.  This is
+/// an alternative to IntervalTree for when all intervals are known up
+/// front: intervals are kept sorted by low endpoint in a single array, and
+/// that array is treated as an implicit balanced binary tree (the node at
+/// index i on level k has i's low k bits set and bit k clear), with each
+/// node caching the maximum high endpoint of its subtree.  There is no
+/// per-interval allocation and enumeration walks contiguous memory.
+///
+/// Usage is to Insert() all intervals, call Build(), then Enumerate().
+/// Intervals are closed, as in IntervalTree.
+template <typename T>
+class IntervalIndex
+{
+public:
+    IntervalIndex() : m_max_level(-1), m_built(true) {}
+
+    /// Add an interval.  Invalidates any previous Build().
+    /// @param low          low endpoint (inclusive)
+    /// @param high         high endpoint (inclusive)
+    /// @param data         associated data
+    void Insert(long low, long high, const T& data)
+    {
+        m_nodes.push_back(Node(low, high, data));
+        m_built = false;
+    }
+
+    /// Sort the intervals and compute the subtree maximums.  Must be called
+    /// after the last Insert() and before Enumerate().
+    void Build();
+
+    /// Get the number of intervals.
+    std::size_t size() const { return m_nodes.size(); }
+
+    /// Determine if there are no intervals.
+    bool empty() const { return m_nodes.empty(); }
+
+    /// Call func(data) for each interval overlapping [low, high].
+    /// Intervals are visited in order of increasing low endpoint.
+    /// @param low          low endpoint of query (inclusive)
+    /// @param high         high endpoint of query (inclusive)
+    /// @param func         function object
+    template <typename F>
+    void Enumerate(long low, long high, F& func) const;
+
+    template <typename F>
+    void Enumerate(long low, long high, const F& func) const
+    {
+        F f(func);
+        Enumerate(low, high, f);
+    }
+
+private:
+    struct Node
+    {
+        Node(long l, long h, const T& d)
+            : low(l), high(h), max_high(h), data(d)
+        {}
+
+        bool operator< (const Node& rhs) const { return low < rhs.low; }
+
+        long low;
+        long high;
+        long max_high;      // maximum high in implicit subtree
+        T data;
+    };
+
+    struct StackEntry
+    {
+        long index;
+        int level;
+        bool left_done;
+    };
+
+    // Subtrees at or below this level are scanned linearly.
+    enum { LINEAR_LEVEL = 3 };
+
+    std::vector<Node> m_nodes;
+    int m_max_level;
+    bool m_built;
+};
+
+template <typename T>
+void
+IntervalIndex<T>::Build()
+{
+    // stable so that equal low endpoints enumerate in insertion order
+    std::stable_sort(m_nodes.begin(), m_nodes.end());
+    m_built = true;
+
+    long n = static_cast<long>(m_nodes.size());
+    if (n == 0)
+    {
+        m_max_level = -1;
+        return;
+    }
+
+    // A previous Build() may have left stale max_high values, and sorting
+    // moves nodes around, so start every node from its own high.  Level 0
+    // (even indices) nodes are leaves and keep that value.  Nodes past the
+    // end of the array are treated as having the max_high of the last real
+    // node on the rightmost path.
+    for (long i=0; i<n; ++i)
+        m_nodes[i].max_high = m_nodes[i].high;
+
+    long last_i = 0;
+    long last = 0;
+    for (long i=0; i<n; i+=2)
+    {
+        last_i = i;
+        last = m_nodes[i].high;
+    }
+
+    int k;
+    for (k=1; (1L<<k) <= n; ++k)
+    {
+        long x = 1L<<(k-1);
+        long i0 = (x<<1) - 1;
+        long step = x<<2;
+        for (long i=i0; i<n; i+=step)
+        {
+            long el = m_nodes[i-x].max_high;
+            long er = i+x < n ? m_nodes[i+x].max_high : last;
+            long e = m_nodes[i].high;
+            if (el > e)
+                e = el;
+            if (er > e)
+                e = er;
+            m_nodes[i].max_high = e;
+        }
+        last_i = ((last_i>>k) & 1) ? last_i - x : last_i + x;
+        if (last_i < n && m_nodes[last_i].max_high > last)
+            last = m_nodes[last_i].max_high;
+    }
+    m_max_level = k-1;
+}
+
+template <typename T>
+template <typename F>
+void
+IntervalIndex<T>::Enumerate(long low, long high, F& func) const
+{
+    assert(m_built && "IntervalIndex not built");
+    if (m_max_level < 0)
+        return;
+
+    long n = static_cast<long>(m_nodes.size());
+    const Node* nodes = &m_nodes[0];
+
+    // Depth is bounded by the number of levels (at most the bits in long).
+    StackEntry stack[sizeof(long)*8 + 1];
+    int top = 0;
+    stack[0].index = (1L<<m_max_level) - 1;
+    stack[0].level = m_max_level;
+    stack[0].left_done = false;
+    ++top;
+
+    while (top > 0)
+    {
+        StackEntry z = stack[--top];
+        if (z.level <= LINEAR_LEVEL)
+        {
+            // small subtree: scan the covered range directly
+            long i0 = z.index >> z.level << z.level;
+            long i1 = i0 + (1L<<(z.level+1)) - 1;
+            if (i1 > n)
+                i1 = n;
+            for (long i=i0; i<i1 && nodes[i].low <= high; ++i)
+            {
+                if (low <= nodes[i].high)
+                    func(nodes[i].data);
+            }
+        }
+        else if (!z.left_done)
+        {
+            // revisit this node after the left subtree
+            long y = z.index - (1L<<(z.level-1));
+            stack[top] = z;
+            stack[top].left_done = true;
+            ++top;
+            if (y >= n || nodes[y].max_high >= low)
+            {
+                stack[top].index = y;
+                stack[top].level = z.level-1;
+                stack[top].left_done = false;
+                ++top;
+            }
+        }
+        else if (z.index < n && nodes[z.index].low <= high)
+        {
+            // this node, then the right subtree
+            if (low <= nodes[z.index].high)
+                func(nodes[z.index].data);
+            stack[top].index = z.index + (1L<<(z.level-1));
+            stack[top].level = z.level-1;
+            stack[top].left_done = false;
+            ++top;
+        }
+    }
+}
+
+} // namespace yasm
+
+#endif
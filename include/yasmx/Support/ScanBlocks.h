@@ -0,0 +1,148 @@
+#ifndef YASM_SUPPORT_SCANBLOCKS_H
+#define YASM_SUPPORT_SCANBLOCKS_H
+///
+/// @file
+/// @brief Block scanners for lexing character runs.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+#include "llvm/Support/MathExtras.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace yasm
+{
+
+// Each scanner examines 16 bytes at a time and only reads whole blocks
+// before end, so the returned pointer may stop short of the end of the run.
+// Callers finish the run with their own scalar loop.  Without SSE2 the
+// scanners return cur_ptr unchanged.
+
+/// Skip horizontal whitespace (space, tab, form feed, vertical tab).
+/// @param cur_ptr      start of run
+/// @param end          end of buffer
+/// @return Pointer to first unskipped character.
+inline const char*
+SkipHorizontalWhitespaceBlocks(const char* cur_ptr, const char* end)
+{
+#ifdef __SSE2__
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i ffs = _mm_set1_epi8('\f');
+    const __m128i vts = _mm_set1_epi8('\v');
+    while (cur_ptr+16 <= end)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)cur_ptr);
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, spaces),
+                         _mm_cmpeq_epi8(chunk, tabs)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, ffs),
+                         _mm_cmpeq_epi8(chunk, vts)));
+        unsigned int mask = _mm_movemask_epi8(ws) ^ 0xFFFF;
+        if (mask != 0)
+            return cur_ptr + llvm::CountTrailingZeros_32(mask);
+        cur_ptr += 16;
+    }
+#endif
+    return cur_ptr;
+}
+
+/// Skip line comment characters, stopping at anything a line comment
+/// lexer needs to look at (NUL, backslash, or newline).
+/// @param cur_ptr      start of comment body
+/// @param end          end of buffer
+/// @return Pointer to first unskipped character.
+inline const char*
+SkipLineCommentBlocks(const char* cur_ptr, const char* end)
+{
+#ifdef __SSE2__
+    const __m128i nuls = _mm_setzero_si128();
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    const __m128i lfs = _mm_set1_epi8('\n');
+    const __m128i crs = _mm_set1_epi8('\r');
+    while (cur_ptr+16 <= end)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)cur_ptr);
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, nuls),
+                         _mm_cmpeq_epi8(chunk, backslashes)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, lfs),
+                         _mm_cmpeq_epi8(chunk, crs)));
+        unsigned int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+            return cur_ptr + llvm::CountTrailingZeros_32(mask);
+        cur_ptr += 16;
+    }
+#endif
+    return cur_ptr;
+}
+
+/// Skip identifier body characters: [A-Za-z0-9] plus the punctuation
+/// characters in extra.  The vector character set only needs to be a
+/// subset of what the lexer accepts in identifiers, as the lexer finishes
+/// the identifier with its character table.
+/// @param cur_ptr      start of run
+/// @param end          end of buffer
+/// @param extra        additional identifier characters (at most 8)
+/// @return Pointer to first unskipped character.
+inline const char*
+SkipIdentifierBlocks(const char* cur_ptr, const char* end, const char* extra)
+{
+#ifdef __SSE2__
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i before_a = _mm_set1_epi8('a'-1);
+    const __m128i after_z = _mm_set1_epi8('z'+1);
+    const __m128i before_0 = _mm_set1_epi8('0'-1);
+    const __m128i after_9 = _mm_set1_epi8('9'+1);
+    __m128i extras[8];
+    int num_extra = 0;
+    for (; num_extra < 8 && extra[num_extra] != '\0'; ++num_extra)
+        extras[num_extra] = _mm_set1_epi8(extra[num_extra]);
+    while (cur_ptr+16 <= end)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)cur_ptr);
+        // Bytes >= 0x80 are negative and fail both range checks.
+        __m128i lower = _mm_or_si128(chunk, case_bit);
+        __m128i ids = _mm_or_si128(
+            _mm_and_si128(_mm_cmpgt_epi8(lower, before_a),
+                          _mm_cmplt_epi8(lower, after_z)),
+            _mm_and_si128(_mm_cmpgt_epi8(chunk, before_0),
+                          _mm_cmplt_epi8(chunk, after_9)));
+        for (int i=0; i<num_extra; ++i)
+            ids = _mm_or_si128(ids, _mm_cmpeq_epi8(chunk, extras[i]));
+        unsigned int mask = _mm_movemask_epi8(ids) ^ 0xFFFF;
+        if (mask != 0)
+            return cur_ptr + llvm::CountTrailingZeros_32(mask);
+        cur_ptr += 16;
+    }
+#endif
+    return cur_ptr;
+}
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef YASM_SUPPORT_THREADLOCAL_H
+#define YASM_SUPPORT_THREADLOCAL_H
+///
+/// @file
+/// @brief Per-thread object storage.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// Untyped base for ThreadLocal.
+class YASM_LIB_EXPORT ThreadLocalBase
+{
+protected:
+    typedef void (*Destructor)(void*);
+
+    explicit ThreadLocalBase(Destructor dtor);
+    ~ThreadLocalBase();
+
+    void* getInstance() const;
+    void setInstance(void* p);
+
+private:
+    ThreadLocalBase(const ThreadLocalBase&);                  // not implemented
+    const ThreadLocalBase& operator=(const ThreadLocalBase&); // not implemented
+
+    Destructor m_dtor;
+    void* m_data;   ///< key, or the instance itself without threads
+};
+
+/// A separate instance of T for each thread.  Each thread's instance is
+/// copy-constructed from an initial value on first use and destroyed when
+/// that thread exits (or, for the thread destroying the ThreadLocal, on
+/// destruction).
+/// Intended for file-scope scratch storage in code that may run in several
+/// assemblies at once.
+template <typename T>
+class ThreadLocal : private ThreadLocalBase
+{
+public:
+    ThreadLocal() : ThreadLocalBase(&Delete), m_init() {}
+
+    /// Constructor.
+    /// @param init         initial value of each thread's instance
+    explicit ThreadLocal(const T& init)
+        : ThreadLocalBase(&Delete), m_init(init)
+    {}
+
+    /// Get the calling thread's instance.
+    T& get()
+    {
+        void* p = getInstance();
+        if (!p)
+        {
+            p = new T(m_init);
+            setInstance(p);
+        }
+        return *static_cast<T*>(p);
+    }
+
+private:
+    static void Delete(void* p) { delete static_cast<T*>(p); }
+
+    T m_init;
+};
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef YASM_SUPPORT_THREADPOOL_H
+#define YASM_SUPPORT_THREADPOOL_H
+///
+/// @file
+/// @brief Thread pool interface.
+///
+/// @license
+///  Copyright (C) 2012  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+#include "yasmx/Config/export.h"
+#include "yasmx/Config/functional.h"
+
+
+namespace yasm
+{
+
+/// A fixed-size pool of worker threads executing queued tasks in FIFO
+/// order.  If threads are not enabled in this build, or the pool is created
+/// with zero threads, tasks are instead run on the calling thread by Wait().
+class YASM_LIB_EXPORT ThreadPool
+{
+public:
+    typedef TR1::function<void ()> Task;
+
+    /// Constructor.
+    /// @param nthreads     number of worker threads
+    explicit ThreadPool(unsigned int nthreads);
+
+    /// Destructor.  Waits for all queued tasks to complete.
+    ~ThreadPool();
+
+    /// Queue a task for execution.
+    /// @param task         task
+    void Async(const Task& task);
+
+    /// Wait for all queued tasks to complete.
+    void Wait();
+
+    /// Get the number of worker threads.
+    /// @return Number of worker threads (0 if tasks run on the caller).
+    unsigned int getNumThreads() const;
+
+    /// Get the number of hardware threads available.
+    /// @return Number of hardware threads, or 1 if unknown.
+    static unsigned int getHardwareConcurrency();
+
+private:
+    ThreadPool(const ThreadPool&);                  // not implemented
+    const ThreadPool& operator=(const ThreadPool&); // not implemented
+
+    struct Impl;
+    Impl* m_impl;
+};
+
+} // namespace yasm
+
+#endif
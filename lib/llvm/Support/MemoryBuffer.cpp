@@ -179,15 +179,20 @@ namespace {
 /// sys::Path::MapInFilePages method.  When destroyed, it calls the
 /// sys::Path::UnMapFilePages method.
 class MemoryBufferMMapFile : public MemoryBufferMem {
+  /// Whether the null terminator is part of the mapping (possibly on a zero
+  /// page mapped after the file).
+  bool NullTerminated;
+
 public:
   MemoryBufferMMapFile(StringRef Buffer, bool RequiresNullTerminator)
-    : MemoryBufferMem(Buffer, RequiresNullTerminator) { }
+    : MemoryBufferMem(Buffer, RequiresNullTerminator),
+      NullTerminated(RequiresNullTerminator) { }
 
   ~MemoryBufferMMapFile() {
     static int PageSize = sys::Process::GetPageSize();
 
     uintptr_t Start = reinterpret_cast<uintptr_t>(getBufferStart());
-    size_t Size = getBufferSize();
+    size_t Size = getBufferSize() + (NullTerminated ? 1 : 0);
     uintptr_t RealStart = Start & ~(PageSize - 1);
     size_t RealSize = Size + (Start - RealStart);
 
@@ -195,6 +200,11 @@ public:
                               RealSize);
   }
   
+  virtual const char *getBufferIdentifier() const {
+     // The name is stored after the class itself.
+    return reinterpret_cast<const char*>(this + 1);
+  }
+
   virtual BufferKind getBufferKind() const {
     return MemoryBuffer_MMap;
   }
@@ -272,11 +282,6 @@ static bool shouldUseMmap(int FD,
   if (End != FileSize)
     return false;
 
-  // Don't try to map files that are exactly a multiple of the system page size
-  // if we need a null terminator.
-  if ((FileSize & (PageSize -1)) == 0)
-    return false;
-
   return true;
 }
 
@@ -308,9 +313,16 @@ error_code MemoryBuffer::getOpenFile(int FD, const char *Filename,
     off_t Delta = Offset - RealMapOffset;
     size_t RealMapSize = MapSize + Delta;
 
-    if (const char *Pages = sys::Path::MapInFilePages(FD,
-                                                      RealMapSize,
-                                                      RealMapOffset)) {
+    // A null terminated map ends at the end of the file; if that is on a page
+    // boundary there is no padding to hold the terminator, so map a zero page
+    // after the file.
+    const char *Pages;
+    if (RequiresNullTerminator && ((Offset + MapSize) & (PageSize - 1)) == 0)
+      Pages = sys::Path::MapInFilePagesWithZeroPage(FD, RealMapSize,
+                                                    RealMapOffset);
+    else
+      Pages = sys::Path::MapInFilePages(FD, RealMapSize, RealMapOffset);
+    if (Pages) {
       result.reset(GetNamedBuffer<MemoryBufferMMapFile>(
           StringRef(Pages + Delta, MapSize), Filename, RequiresNullTerminator));
       return error_code::success();
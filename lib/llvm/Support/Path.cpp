@@ -16,6 +16,7 @@
 #include "llvm/Config/config.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Endian.h"
+#include "llvm/Support/Process.h"
 #include <cassert>
 #include <cstring>
 #include <ostream>
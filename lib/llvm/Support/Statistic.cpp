@@ -39,8 +39,11 @@ namespace llvm { extern raw_ostream *CreateInfoOutputFile(); }
 /// -stats - Command line option to cause transformations to emit stats about
 /// what they did.
 ///
-static cl::opt<bool>
-Enabled("stats", cl::desc("Enable statistics output from program"));
+bool llvm::StatisticsEnabled = false;
+
+static cl::opt<bool, true>
+Enabled("stats", cl::desc("Enable statistics output from program"),
+        cl::location(StatisticsEnabled));
 
 
 namespace {
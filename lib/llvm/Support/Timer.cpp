@@ -148,13 +148,18 @@ static ManagedStatic<std::vector<Timer*> > ActiveTimers;
 
 void Timer::startTimer() {
   Started = true;
-  ActiveTimers->push_back(this);
+  {
+    sys::SmartScopedLock<true> L(*TimerLock);
+    ActiveTimers->push_back(this);
+  }
   Time -= TimeRecord::getCurrentTime(true);
 }
 
 void Timer::stopTimer() {
   Time += TimeRecord::getCurrentTime(false);
 
+  // Timers may be running on several threads at once.
+  sys::SmartScopedLock<true> L(*TimerLock);
   if (ActiveTimers->back() == this) {
     ActiveTimers->pop_back();
   } else {
@@ -24,25 +24,62 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#define DEBUG_TYPE "Assembler"
+
 #include "yasmx/Assembler.h"
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/Parser.h"
+#include "yasmx/Support/Arena.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/Support/ThreadPool.h"
 #include "yasmx/Arch.h"
 #include "yasmx/DebugFormat.h"
 #include "yasmx/ListFormat.h"
 #include "yasmx/Object.h"
 #include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
+#include "yasmx/SpanHints.h"
+
 
+STATISTIC(peak_bytecodes, "Peak number of bytecodes in an object");
+STATISTIC(peak_symbols, "Peak number of symbols in an object");
 
 using namespace yasm;
 
+namespace yasm {
+/// Timers for each phase of assembly.
+struct PhaseTimers
+{
+    PhaseTimers();
+
+    llvm::TimerGroup group;
+    llvm::Timer parse;
+    llvm::Timer finalize;
+    llvm::Timer optimize;
+    llvm::Timer generate;
+    llvm::Timer output;
+};
+} // namespace yasm
+
+PhaseTimers::PhaseTimers()
+    : group("Assembly Time Report")
+    , parse("Parse", group)
+    , finalize("Finalize", group)
+    , optimize("Optimize", group)
+    , generate("Debug information generation", group)
+    , output("Output", group)
+{
+}
+
 namespace {
 class NocaseEquals
 {
@@ -65,13 +102,16 @@ Assembler::Assembler(StringRef arch_keyword,
       m_objfmt_module(LoadModule<ObjectFormatModule>(objfmt_keyword).release()),
       m_dbgfmt_module(0),
       m_listfmt_module(0),
+      m_arena(new Arena),
       m_arch(0),
       m_parser(0),
       m_objfmt(0),
       m_dbgfmt(0),
       m_listfmt(0),
       m_object(0),
-      m_dump_time(dump_time)
+      m_timers(0),
+      m_dump_time(dump_time),
+      m_optimize_threads(0)
 {
     if (m_arch_module.get() == 0)
     {
@@ -101,6 +141,25 @@ Assembler::~Assembler()
 {
 }
 
+void
+Assembler::setTimeReport(bool enable)
+{
+    m_timers.reset(enable ? new PhaseTimers : 0);
+}
+
+void
+Assembler::setOptimizeThreads(unsigned int nthreads)
+{
+    m_optimize_threads = nthreads;
+}
+
+void
+Assembler::setSpanHints(StringRef filename, StringRef options)
+{
+    m_hints_filename = filename;
+    m_hints_options = options;
+}
+
 void
 Assembler::setObjectFilename(StringRef obj_filename)
 {
@@ -196,6 +255,23 @@ Assembler::setListFormat(StringRef listfmt_keyword, DiagnosticsEngine& diags)
     return true;
 }
 
+std::string
+Assembler::getDefaultObjectFilename(StringRef in_filename, StringRef extension)
+{
+    // Default to yasm.out if no obj filename specified
+    if (in_filename.empty() || in_filename == "<stdin>")
+        return "yasm.out";
+
+    // replace (or add) extension to base filename
+    if (!llvm::sys::path::has_stem(in_filename))
+        return "yasm.out";
+    std::string obj_filename = llvm::sys::path::stem(in_filename);
+    obj_filename += extension;
+    if (obj_filename == in_filename)
+        return "yasm.out";
+    return obj_filename;
+}
+
 bool
 Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
 {
@@ -203,26 +279,13 @@ Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
         source_mgr.getBuffer(source_mgr.getMainFileID())->getBufferIdentifier();
     StringRef parser_keyword = m_parser_module->getKeyword();
 
+    if (m_timers.get() != 0)
+        m_timers->group.setName("Assembly Time Report: " + in_filename.str());
+
     // determine the object filename if not specified
     if (m_obj_filename.empty())
-    {
-        if (in_filename[0] == '\0' || in_filename == "<stdin>")
-            // Default to yasm.out if no obj filename specified
-            m_obj_filename = "yasm.out";
-        else
-        {
-            // replace (or add) extension to base filename
-            if (!llvm::sys::path::has_stem(in_filename))
-                m_obj_filename = "yasm.out";
-            else
-            {
-                m_obj_filename = llvm::sys::path::stem(in_filename);
-                m_obj_filename += m_objfmt_module->getExtension();
-                if (m_obj_filename == in_filename)
-                    m_obj_filename = "yasm.out";
-            }
-        }
-    }
+        m_obj_filename = getDefaultObjectFilename(in_filename,
+            m_objfmt_module->getExtension());
 
     if (m_machine.empty())
     {
@@ -239,6 +302,7 @@ Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
 
     // Create object
     m_object.reset(new Object(in_filename, m_obj_filename, m_arch.get()));
+    Arena::Scope arena_scope(m_arena.get());
 
     // See if the object format supports such an object
     if (!m_objfmt_module->isOkObject(*m_object))
@@ -295,6 +359,7 @@ bool
 Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
 {
     StringRef parser_keyword = m_parser_module->getKeyword();
+    Arena::Scope arena_scope(m_arena.get());
 
     // Set up directive handlers
     Directives dirs;
@@ -312,7 +377,10 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     diags.getClient()->BeginSourceFile();
 
     // Parse!
-    m_parser->Parse(*m_object, dirs, diags);
+    {
+        llvm::TimeRegion timer(m_timers.get() ? &m_timers->parse : 0);
+        m_parser->Parse(*m_object, dirs, diags);
+    }
 
     if (m_dump_time == Assembler::DUMP_AFTER_PARSE)
         DumpXml(*m_object);
@@ -320,14 +388,38 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
         return false;
 
     // Finalize parse
-    m_object->Finalize(diags);
+    {
+        llvm::TimeRegion timer(m_timers.get() ? &m_timers->finalize : 0);
+        m_object->Finalize(diags);
+    }
     if (m_dump_time == Assembler::DUMP_AFTER_FINALIZE)
         DumpXml(*m_object);
     if (diags.hasErrorOccurred())
         return false;
 
     // Optimize
-    m_object->Optimize(diags);
+    {
+        llvm::TimeRegion timer(m_timers.get() ? &m_timers->optimize : 0);
+        util::scoped_ptr<SpanHints> hints;
+        if (!m_hints_filename.empty())
+        {
+            hints.reset(new SpanHints);
+            hints->setKey(m_hints_options, source_mgr);
+            hints->Read(m_hints_filename);
+        }
+
+        if (m_optimize_threads > 1)
+        {
+            ThreadPool pool(m_optimize_threads);
+            m_object->Optimize(diags, &pool, hints.get());
+        }
+        else
+            m_object->Optimize(diags, 0, hints.get());
+
+        // The hints are only a cache; failing to write them is harmless.
+        if (hints.get() && !diags.hasErrorOccurred())
+            hints->Write(m_hints_filename);
+    }
 
     if (m_dump_time == Assembler::DUMP_AFTER_OPTIMIZE)
         DumpXml(*m_object);
@@ -336,7 +428,21 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
         return false;
 
     // generate any debugging information
-    m_dbgfmt->Generate(*m_objfmt, source_mgr, diags);
+    {
+        llvm::TimeRegion timer(m_timers.get() ? &m_timers->generate : 0);
+        m_dbgfmt->Generate(*m_objfmt, source_mgr, diags);
+    }
+
+    if (llvm::AreStatisticsEnabled())
+    {
+        unsigned int num_bytecodes = 0;
+        for (Object::section_iterator sect = m_object->sections_begin(),
+             end = m_object->sections_end(); sect != end; ++sect)
+            num_bytecodes += sect->size();
+        peak_bytecodes.updateMax(num_bytecodes);
+        peak_symbols.updateMax(m_object->symbols_end() -
+                               m_object->symbols_begin());
+    }
 
     // Inform the diagnostic consumer we are done processing source.
     diags.getClient()->EndSourceFile();
@@ -347,14 +453,26 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
 bool
 Assembler::Output(raw_fd_ostream& os, DiagnosticsEngine& diags)
 {
+    Arena::Scope arena_scope(m_arena.get());
+
+    // Object formats write a piece at a time (often several per bytecode),
+    // so use a much larger buffer than the file's block size to keep the
+    // number of writes down.  Leave unbuffered (terminal) streams alone.
+    static const size_t OUTPUT_BUFFER_SIZE = 1024*1024;
+    if (os.GetBufferSize() != 0)
+        os.SetBufferSize(OUTPUT_BUFFER_SIZE);
+
     // Inform the diagnostic consumer we are processing a source file
     diags.getClient()->BeginSourceFile();
 
     // Write the object file
-    m_objfmt->Output(os,
-                     !m_dbgfmt_module->getKeyword().equals_lower("null"),
-                     *m_dbgfmt,
-                     diags);
+    {
+        llvm::TimeRegion timer(m_timers.get() ? &m_timers->output : 0);
+        m_objfmt->Output(os,
+                         !m_dbgfmt_module->getKeyword().equals_lower("null"),
+                         *m_dbgfmt,
+                         diags);
+    }
 
     // Inform the diagnostic consumer we are done processing source.
     diags.getClient()->EndSourceFile();
@@ -867,6 +867,71 @@ bool DiagnosticConsumer::IncludeInDiagnosticCounts() const { return true; }
 
 void IgnoringDiagConsumer::anchor() { }
 
+DeferredDiagConsumer::DeferredDiagConsumer() {}
+
+DeferredDiagConsumer::~DeferredDiagConsumer() {}
+
+void DeferredDiagConsumer::HandleDiagnostic(DiagnosticsEngine::Level DiagLevel,
+                                            const Diagnostic &Info) {
+  DiagnosticConsumer::HandleDiagnostic(DiagLevel, Info);
+
+  Recorded.push_back(Record());
+  Record &R = Recorded.back();
+  R.ID = Info.getID();
+  R.Loc = Info.getLocation();
+
+  for (unsigned I = 0, N = Info.getNumArgs(); I != N; ++I) {
+    Arg A;
+    A.Kind = Info.getArgKind(I);
+    A.Val = 0;
+    // Strings are copied, as C string arguments need not outlive the
+    // diagnostic.
+    if (A.Kind == DiagnosticsEngine::ak_std_string)
+      A.Str = Info.getArgStdStr(I);
+    else if (A.Kind == DiagnosticsEngine::ak_c_string) {
+      A.Kind = DiagnosticsEngine::ak_std_string;
+      A.Str = Info.getArgCStr(I);
+    } else
+      A.Val = Info.getRawArg(I);
+    R.Args.push_back(A);
+  }
+
+  ArrayRef<CharSourceRange> Ranges = Info.getRanges();
+  R.Ranges.assign(Ranges.begin(), Ranges.end());
+  for (unsigned I = 0, N = Info.getNumFixItHints(); I != N; ++I)
+    R.FixIts.push_back(Info.getFixItHint(I));
+}
+
+DiagnosticConsumer *
+DeferredDiagConsumer::clone(DiagnosticsEngine &Diags) const {
+  return new DeferredDiagConsumer();
+}
+
+void DeferredDiagConsumer::clear() {
+  DiagnosticConsumer::clear();
+  Recorded.clear();
+}
+
+void DeferredDiagConsumer::Replay(DiagnosticsEngine &Diags) const {
+  for (std::vector<Record>::const_iterator R = Recorded.begin(),
+       RE = Recorded.end(); R != RE; ++R) {
+    DiagnosticBuilder DB = Diags.Report(R->Loc, R->ID);
+    for (std::vector<Arg>::const_iterator A = R->Args.begin(),
+         AE = R->Args.end(); A != AE; ++A) {
+      if (A->Kind == DiagnosticsEngine::ak_std_string)
+        DB.AddString(A->Str);
+      else
+        DB.AddTaggedVal(A->Val, A->Kind);
+    }
+    for (std::vector<CharSourceRange>::const_iterator I = R->Ranges.begin(),
+         IE = R->Ranges.end(); I != IE; ++I)
+      DB.AddSourceRange(*I);
+    for (std::vector<FixItHint>::const_iterator I = R->FixIts.begin(),
+         IE = R->FixIts.end(); I != IE; ++I)
+      DB.AddFixItHint(*I);
+  }
+}
+
 PartialDiagnostic::StorageAllocator::StorageAllocator() {
   for (unsigned I = 0; I != NumCached; ++I)
     FreeList[I] = Cached + I;
@@ -120,3 +120,22 @@ MemorizeStatCalls::getStat(const char *Path, struct stat &StatBuf,
   
   return Result;
 }
+
+
+void SharedStatCache::Add(StatMap &StatCalls, const char *Path) {
+  struct stat StatBuf;
+  if (::stat(Path, &StatBuf) == 0)
+    StatCalls[Path] = StatBuf;
+}
+
+SharedStatCache::LookupResult
+SharedStatCache::getStat(const char *Path, struct stat &StatBuf,
+                         int *FileDescriptor) {
+  StatMap::const_iterator I = StatCalls.find(Path);
+  if (I == StatCalls.end())
+    return statChained(Path, StatBuf, FileDescriptor);
+
+  // The file is not opened here; FileManager opens it when it is read.
+  StatBuf = I->second;
+  return CacheExists;
+}
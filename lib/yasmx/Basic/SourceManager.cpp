@@ -1413,6 +1413,103 @@ PresumedLoc SourceManager::getPresumedLoc(SourceLocation Loc) const {
   return PresumedLoc(Filename, LineNo, ColNo, IncludeLoc);
 }
 
+//===----------------------------------------------------------------------===//
+// SourceLineCursor
+//===----------------------------------------------------------------------===//
+
+/// AdvanceUpperBound - Given that the first \p I of the \p N sorted elements
+/// of \p A are at or before \p Offset, return how many of them are.  Looks a
+/// few elements ahead before falling back to a binary search.
+template <typename T>
+static unsigned AdvanceUpperBound(const T *A, unsigned N, unsigned I,
+                                  unsigned Offset) {
+  for (unsigned Limit = std::min(N, I+8); I != Limit; ++I)
+    if (Offset < A[I])
+      return I;
+  return std::upper_bound(A+I, A+N, Offset) - A;
+}
+
+SourceLineCursor::SourceLineCursor(const SourceManager &SM)
+  : SM(SM), FileName(0), LineStarts(0), NumLines(0), Entries(0), Pos(0),
+    LineNo(0), NumEntries(0), MarkerLineNo(0) {
+}
+
+bool SourceLineCursor::EnterFile(FileID NewFID) {
+  bool Invalid = false;
+  const SLocEntry &Entry = SM.getSLocEntry(NewFID, &Invalid);
+  if (Invalid || !Entry.isFile())
+    return false;
+
+  const SrcMgr::FileInfo &FI = Entry.getFile();
+  ContentCache *C = const_cast<ContentCache*>(FI.getContentCache());
+  if (C->SourceLineCache == 0) {
+    ComputeLineNumbers(SM.Diag, C, SM.ContentCacheAlloc, SM, Invalid);
+    if (Invalid)
+      return false;
+  }
+
+  if (C->OrigEntry)
+    FileName = C->OrigEntry->getName();
+  else
+    FileName = C->getBuffer(SM.Diag, SM)->getBufferIdentifier();
+  LineStarts = C->SourceLineCache;
+  NumLines = C->NumLines;
+  Entries = 0;
+  if (FI.hasLineDirectives()) {
+    assert(SM.LineTable && "Can't have linetable entries without a LineTable!");
+    Entries = SM.LineTable->getLineEntries(NewFID);
+  }
+
+  FID = NewFID;
+  Pos = 0;
+  LineNo = 0;
+  NumEntries = 0;
+  MarkerLineNo = 0;
+  return true;
+}
+
+bool SourceLineCursor::Lookup(SourceLocation Loc, const char **Filename,
+                              unsigned *Line) {
+  if (Loc.isInvalid())
+    return false;
+
+  // Presumed locations are always for expansion points.
+  std::pair<FileID, unsigned> LocInfo = SM.getDecomposedExpansionLoc(Loc);
+  if (LocInfo.first != FID && !EnterFile(LocInfo.first))
+    return false;
+
+  unsigned Offset = LocInfo.second;
+  if (Offset < Pos) {
+    // Going backwards; search again from the start of the file.
+    LineNo = 0;
+    NumEntries = 0;
+    MarkerLineNo = 0;
+  }
+  Pos = Offset;
+
+  LineNo = AdvanceUpperBound(LineStarts, NumLines, LineNo, Offset);
+  *Filename = FileName;
+  *Line = LineNo;
+  if (!Entries)
+    return true;
+
+  // Apply the last line directive before this, as getPresumedLoc() does.
+  unsigned OldNumEntries = NumEntries;
+  NumEntries = AdvanceUpperBound(&Entries->front(), Entries->size(),
+                                 NumEntries, Offset);
+  if (NumEntries == 0)
+    return true;
+
+  const LineEntry &Entry = (*Entries)[NumEntries-1];
+  if (NumEntries != OldNumEntries)
+    MarkerLineNo = AdvanceUpperBound(LineStarts, NumLines, MarkerLineNo,
+                                     Entry.FileOffset);
+  if (Entry.FilenameID != -1)
+    *Filename = SM.LineTable->getFilename(Entry.FilenameID);
+  *Line = Entry.LineNo + (LineNo-MarkerLineNo-1);
+  return true;
+}
+
 /// \brief The size of the SLocEnty that \arg FID represents.
 unsigned SourceManager::getFileIDSize(FileID FID) const {
   bool Invalid = false;
@@ -91,7 +91,8 @@ Bytecode::Transform(std::auto_ptr<Contents> contents)
 }
 
 Bytecode::Bytecode(std::auto_ptr<Contents> contents, SourceLocation source)
-    : m_contents(contents),
+    : m_fixed_fixups_owner(m_fixed_fixups),
+      m_contents(contents),
       m_container(0),
       m_len(0),
       m_source(source),
@@ -101,7 +102,8 @@ Bytecode::Bytecode(std::auto_ptr<Contents> contents, SourceLocation source)
 }
 
 Bytecode::Bytecode()
-    : m_contents(0),
+    : m_fixed_fixups_owner(m_fixed_fixups),
+      m_contents(0),
       m_container(0),
       m_len(0),
       m_offset(0),
@@ -110,7 +112,8 @@ Bytecode::Bytecode()
 }
 
 Bytecode::Bytecode(const Bytecode& oth)
-    : m_contents(oth.m_contents->clone()),
+    : m_fixed_fixups_owner(m_fixed_fixups),
+      m_contents(oth.m_contents->clone()),
       m_container(oth.m_container),
       m_len(oth.m_len),
       m_source(oth.m_source),
@@ -138,7 +141,7 @@ Bytecode::swap(Bytecode& oth)
 bool
 Bytecode::Finalize(DiagnosticsEngine& diags)
 {
-    for (std::vector<Fixup>::iterator i=m_fixed_fixups.begin(),
+    for (stdx::ptr_vector<Fixup>::iterator i=m_fixed_fixups.begin(),
          end=m_fixed_fixups.end(); i != end; ++i)
     {
         if (!i->Finalize(diags, i->isJumpTarget() ? diag::err_too_complex_jump :
@@ -213,7 +216,7 @@ Bytecode::Output(BytecodeOutput& bc_out)
     fixed.insert(fixed.end(), m_fixed.begin(), m_fixed.end());
 
     // apply fixups
-    for (std::vector<Fixup>::iterator i=m_fixed_fixups.begin(),
+    for (stdx::ptr_vector<Fixup>::iterator i=m_fixed_fixups.begin(),
          end=m_fixed_fixups.end(); i != end; ++i)
     {
         unsigned int off = i->getOffset();
@@ -227,8 +230,10 @@ Bytecode::Output(BytecodeOutput& bc_out)
                      fixed.begin() + off + size);
 
         // Make a copy of the value to ensure things like
-        // "TIMES x JMP label" work.
-        Value vcopy = *i;
+        // "TIMES x JMP label" work.  The scratch value is reused so its
+        // expression storage is too.
+        Value& vcopy = bc_out.m_value_scratch;
+        vcopy = *i;
 
         // Convert the value to bytes.
         NumericOutput num_out(bytes);
@@ -285,7 +290,7 @@ void
 Bytecode::AppendFixed(const Value& val)
 {
     unsigned int valsize = val.getSize()/8;
-    m_fixed_fixups.push_back(Fixup(m_fixed.size(), val));
+    m_fixed_fixups.push_back(new Fixup(m_fixed.size(), val));
     m_fixed.Write(valsize, 0);
     ++num_fixed_value;
 }
@@ -294,7 +299,7 @@ void
 Bytecode::AppendFixed(std::auto_ptr<Value> val)
 {
     unsigned int valsize = val->getSize()/8;
-    m_fixed_fixups.push_back(Fixup(m_fixed.size(), val));
+    m_fixed_fixups.push_back(new Fixup(m_fixed.size(), val));
     m_fixed.Write(valsize, 0);
     ++num_fixed_value;
 }
@@ -304,10 +309,11 @@ Bytecode::AppendFixed(unsigned int size,
                       std::auto_ptr<Expr> e,
                       SourceLocation source)
 {
-    m_fixed_fixups.push_back(Fixup(m_fixed.size(), size*8, e, source));
+    Fixup* fixup = new Fixup(m_fixed.size(), size*8, e, source);
+    m_fixed_fixups.push_back(fixup);
     m_fixed.Write(size, 0);
     ++num_fixed_value;
-    return m_fixed_fixups.back();
+    return *fixup;
 }
 
 #ifdef WITH_XML
@@ -326,7 +332,7 @@ Bytecode::Write(pugi::xml_node out) const
         append_child(root, "Fixed", m_fixed);
 
     // fixups
-    for (std::vector<Fixup>::const_iterator i=m_fixed_fixups.begin(),
+    for (stdx::ptr_vector<Fixup>::const_iterator i=m_fixed_fixups.begin(),
          end=m_fixed_fixups.end(); i != end; ++i)
         append_data(root, *i);
 
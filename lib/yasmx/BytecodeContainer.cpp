@@ -30,7 +30,9 @@
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Expr.h"
+#include "yasmx/Object.h"
 #include "yasmx/Optimizer.h"
+#include "yasmx/Section.h"
 
 
 using namespace yasm;
@@ -135,7 +137,8 @@ GapBytecode::Write(pugi::xml_node out) const
 BytecodeContainer::BytecodeContainer(Section* sect)
     : m_sect(sect),
       m_bcs_owner(m_bcs),
-      m_last_gap(false)
+      m_last_gap(false),
+      m_stale_offsets(0)
 {
     // A container always has at least one bytecode.
     StartBytecode();
@@ -152,6 +155,8 @@ BytecodeContainer::AppendBytecode(std::auto_ptr<Bytecode> bc)
     {
         bc->m_container = this; // record parent
         m_bcs.push_back(bc.release());
+        if (m_stale_offsets > m_bcs.size()-1)
+            m_stale_offsets = m_bcs.size()-1;
     }
     m_last_gap = false;
 }
@@ -177,6 +182,8 @@ BytecodeContainer::StartBytecode()
     Bytecode* bc = new Bytecode;
     bc->m_container = this; // record parent
     m_bcs.push_back(bc);
+    if (m_stale_offsets > m_bcs.size()-1)
+        m_stale_offsets = m_bcs.size()-1;
     m_last_gap = false;
     return *bc;
 }
@@ -190,6 +197,13 @@ BytecodeContainer::FreshBytecode()
     return bc;
 }
 
+bool
+BytecodeContainer::isTrackingInsnSources() const
+{
+    return m_sect && m_sect->getObject() &&
+        m_sect->getObject()->getOptions().TrackInsnSources;
+}
+
 Location
 BytecodeContainer::getEndLoc()
 {
@@ -208,16 +222,38 @@ BytecodeContainer::Finalize(DiagnosticsEngine& diags)
 void
 BytecodeContainer::UpdateOffsets(DiagnosticsEngine& diags)
 {
+    if (m_stale_offsets >= m_bcs.size())
+        return;     // all up to date
+
+    // Offsets before the first stale one are unchanged.
     unsigned long offset = 0;
-    m_bcs.front().setOffset(0);
-    for (bc_iterator bc=m_bcs.begin(), end=m_bcs.end(); bc != end; ++bc)
+    bc_iterator bc = m_bcs.begin() + m_stale_offsets;
+    if (m_stale_offsets == 0)
+        m_bcs.front().setOffset(0);
+    else
+        offset = (bc-1)->getNextOffset();
+
+    for (bc_iterator end=m_bcs.end(); bc != end; ++bc)
         offset = bc->UpdateOffset(offset, diags);
+    m_stale_offsets = m_bcs.size();
+}
+
+void
+BytecodeContainer::InvalidateOffsets(const Bytecode& bc)
+{
+    assert(bc.getContainer() == this && "bytecode not in this container");
+    assert(bc.getIndex() >= m_bcs.front().getIndex() && "bad bytecode index");
+    stdx::ptr_vector<Bytecode>::size_type pos =
+        bc.getIndex() - m_bcs.front().getIndex() + 1;
+    if (pos < m_stale_offsets)
+        m_stale_offsets = pos;
 }
 
 void
 BytecodeContainer::Optimize(DiagnosticsEngine& diags)
 {
     Optimizer opt(diags);
+    InvalidateOffsets();
 
     // Step 1a
     unsigned long bc_index = 0;
@@ -33,7 +33,7 @@
 using namespace yasm;
 
 BytecodeOutput::BytecodeOutput(DiagnosticsEngine& diags)
-    : m_diags(diags), m_num_output(0)
+    : m_diags(diags), m_value_scratch(0), m_num_output(0)
 {
 }
 
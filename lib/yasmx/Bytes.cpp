@@ -47,8 +47,8 @@ yasm::operator<< (raw_ostream& os, const Bytes& bytes)
 void
 Bytes::swap(Bytes& oth)
 {
-    base_vector::swap(*this);
-    EndianState::swap(*this);
+    base_vector::swap(oth);
+    EndianState::swap(oth);
 }
 
 void
@@ -30,12 +30,13 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/InputBuffer.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Support/ThreadLocal.h"
 
 
 using namespace yasm;
 using llvm::APInt;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+static ThreadLocal<APInt> staticbv(APInt(IntNum::BITVECT_NATIVE_SIZE, 0));
 
 static inline uint64_t
 Extract(const APInt& bv, unsigned int width, unsigned int lsb)
@@ -55,7 +56,7 @@ yasm::WriteLEB128(Bytes& bytes, const IntNum& intn, bool sign)
         return 1;
     }
 
-    const APInt* bv = intn.getBV(&staticbv);
+    const APInt* bv = intn.getBV(&staticbv.get());
     int size;
     if (sign)
         size = bv->getMinSignedBits();
@@ -78,7 +79,7 @@ yasm::SizeLEB128(const IntNum& intn, bool sign)
     if (intn.isZero())
         return 1;
 
-    const APInt* bv = intn.getBV(&staticbv);
+    const APInt* bv = intn.getBV(&staticbv.get());
     if (sign)
         return (bv->getMinSignedBits()+6)/7;
     else
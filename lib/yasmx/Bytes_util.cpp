@@ -33,12 +33,13 @@
 
 #include "llvm/ADT/APInt.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Support/ThreadLocal.h"
 
 
 using namespace yasm;
 using llvm::APInt;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+static ThreadLocal<APInt> staticbv(APInt(IntNum::BITVECT_NATIVE_SIZE, 0));
 
 void
 yasm::Write8(Bytes& bytes, const IntNum& intn)
@@ -108,7 +109,7 @@ yasm::WriteN(Bytes& bytes, const IntNum& intn, int n)
     }
 
     // harder cases
-    const APInt* bv = intn.getBV(&staticbv);
+    const APInt* bv = intn.getBV(&staticbv.get());
     const uint64_t* words = bv->getRawData();
     unsigned int nwords = bv->getNumWords();
     APInt tmp;    // must be here so it stays in scope
@@ -24,16 +24,21 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#define DEBUG_TYPE "Expr"
+
 #include "yasmx/Expr.h"
 
 #include <algorithm>
 #include <iterator>
+#include <vector>
 
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/Support/ThreadLocal.h"
 #include "yasmx/Arch.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Symbol.h"
@@ -42,6 +47,9 @@
 using namespace yasm;
 using llvm::APFloat;
 
+STATISTIC(num_memo_hits, "Number of simplifications found in the memo");
+STATISTIC(num_memo_misses, "Number of simplifications not in the memo");
+
 /// Look for simple identities that make the entire result constant:
 /// 0*&x, -1|x, etc.
 static inline bool
@@ -772,9 +780,267 @@ again:
         root.Zero();    // If operator has no children, replace it with a zero.
 }
 
+namespace {
+/// Memo of Simplify() results.  Simplify() only looks at the structure of
+/// an expression and the values of its leaves, never at term source
+/// locations, so expressions that match in those (as from repeated macro
+/// expansions) simplify identically.  Each result term's source is stored
+/// as the index of the input term it came from.
+class SimplifyMemo
+{
+public:
+    enum
+    {
+        NUM_ENTRIES = 512,      ///< Number of (direct-mapped) entries
+        MIN_TERMS = 5,          ///< Smallest expression memoized
+        MAX_TERMS = 32          ///< Largest expression memoized
+    };
+
+    /// Look up an expression, replacing it with its simplified form if
+    /// found.
+    /// @param terms            expression terms
+    /// @param simplify_reg_mul simplify REG*1 identities
+    /// @param hash             hash of terms from HashTerms()
+    /// @return True if found.
+    bool Lookup(ExprTerms& terms, bool simplify_reg_mul, unsigned long hash);
+
+    /// Add a simplification.  Nothing is added unless each result term's
+    /// source identifies a single input term.
+    /// @param orig             original expression terms
+    /// @param simplify_reg_mul simplify REG*1 identities
+    /// @param hash             hash of orig from HashTerms()
+    /// @param result           simplified expression terms
+    void Insert(const ExprTerms& orig,
+                bool simplify_reg_mul,
+                unsigned long hash,
+                const ExprTerms& result);
+
+private:
+    struct Entry
+    {
+        Entry() : valid(false), simplify_reg_mul(false), hash(0) {}
+
+        bool valid;
+        bool simplify_reg_mul;
+        unsigned long hash;
+        ExprTerms key;
+        ExprTerms result;
+        SmallVector<unsigned char, 4> sources;
+    };
+
+    std::vector<Entry> m_entries;   // allocated on first insert
+};
+} // anonymous namespace
+
+static ThreadLocal<SimplifyMemo> simplify_memo;
+
+/// Determine if simplifying an expression depends only on the structure
+/// and leaf values of its terms and cannot report diagnostics.
+/// @param terms    expression terms
+/// @return True if the simplification may be memoized.
+static bool
+isMemoizable(const ExprTerms& terms)
+{
+    // Small expressions are faster to simplify than to look up.
+    if (terms.size() < SimplifyMemo::MIN_TERMS ||
+        terms.size() > SimplifyMemo::MAX_TERMS)
+        return false;
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end(); i != end;
+         ++i)
+    {
+        switch (i->getType())
+        {
+            case ExprTerm::REG:
+            case ExprTerm::INT:
+            case ExprTerm::SUBST:
+            case ExprTerm::SYM:
+                break;
+            case ExprTerm::OP:
+            {
+                // Division can report divide by zero, and non-numeric
+                // operators are simplified with their operands.
+                Op::Op op = i->getOp();
+                if (op >= Op::NONNUM || (op >= Op::DIV && op <= Op::SIGNMOD))
+                    return false;
+                break;
+            }
+            default:
+                // Floats can report diagnostics; locations are left alone.
+                return false;
+        }
+    }
+    return true;
+}
+
+/// Get a hash of the structure and leaf values of memoizable terms.
+/// @param terms    expression terms
+/// @return Hash value.
+static unsigned long
+HashTerms(const ExprTerms& terms)
+{
+    unsigned long hash = 2166136261UL;
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end(); i != end;
+         ++i)
+    {
+        unsigned long value = 0;
+        switch (i->getType())
+        {
+            case ExprTerm::REG:
+                value = reinterpret_cast<std::size_t>(i->getRegister());
+                break;
+            case ExprTerm::INT:
+            {
+                const IntNum* intn = i->getIntNum();
+                if (intn->isInt())
+                    value = static_cast<unsigned long>(intn->getInt());
+                break;
+            }
+            case ExprTerm::SUBST:
+                value = *i->getSubst();
+                break;
+            case ExprTerm::SYM:
+            {
+                Symbol* sym = i->getSymbol();
+                value = reinterpret_cast<std::size_t>(sym);
+                break;
+            }
+            case ExprTerm::OP:
+                value = (i->getOp() << 16) ^ i->getNumChild();
+                break;
+            default:
+                break;
+        }
+        hash = (hash ^ i->getType()) * 16777619UL;
+        hash = (hash ^ i->m_depth) * 16777619UL;
+        hash = (hash ^ value) * 16777619UL;
+    }
+    return hash;
+}
+
+/// Determine if memoizable terms match in structure and leaf values.
+/// @param lhs      expression terms
+/// @param rhs      expression terms
+/// @return True if terms match.
+static bool
+EqualTerms(const ExprTerms& lhs, const ExprTerms& rhs)
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    for (ExprTerms::const_iterator i=lhs.begin(), j=rhs.begin(),
+         end=lhs.end(); i != end; ++i, ++j)
+    {
+        if (i->getType() != j->getType() || i->m_depth != j->m_depth)
+            return false;
+        switch (i->getType())
+        {
+            case ExprTerm::REG:
+                if (i->getRegister() != j->getRegister())
+                    return false;
+                break;
+            case ExprTerm::INT:
+                if (*i->getIntNum() != *j->getIntNum())
+                    return false;
+                break;
+            case ExprTerm::SUBST:
+                if (*i->getSubst() != *j->getSubst())
+                    return false;
+                break;
+            case ExprTerm::SYM:
+                if (i->getSymbol() != j->getSymbol())
+                    return false;
+                break;
+            case ExprTerm::OP:
+                if (i->getOp() != j->getOp() ||
+                    i->getNumChild() != j->getNumChild())
+                    return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+SimplifyMemo::Lookup(ExprTerms& terms,
+                     bool simplify_reg_mul,
+                     unsigned long hash)
+{
+    if (m_entries.empty())
+        return false;
+    const Entry& entry = m_entries[hash % NUM_ENTRIES];
+    if (!entry.valid || entry.hash != hash ||
+        entry.simplify_reg_mul != simplify_reg_mul ||
+        !EqualTerms(entry.key, terms))
+        return false;
+
+    SourceLocation sources[MAX_TERMS];
+    for (unsigned int i=0, size=terms.size(); i<size; ++i)
+        sources[i] = terms[i].getSource();
+    terms.clear();
+    terms.append(entry.result.begin(), entry.result.end());
+    for (unsigned int i=0, size=terms.size(); i<size; ++i)
+        terms[i].setSource(sources[entry.sources[i]]);
+    return true;
+}
+
+void
+SimplifyMemo::Insert(const ExprTerms& orig,
+                     bool simplify_reg_mul,
+                     unsigned long hash,
+                     const ExprTerms& result)
+{
+    SmallVector<unsigned char, 4> sources;
+    for (ExprTerms::const_iterator i=result.begin(), end=result.end();
+         i != end; ++i)
+    {
+        int source = -1;
+        for (int j=0, size=orig.size(); j<size; ++j)
+        {
+            if (orig[j].getSource() != i->getSource())
+                continue;
+            if (source >= 0)
+                return;     // ambiguous
+            source = j;
+        }
+        if (source < 0)
+            return;
+        sources.push_back(static_cast<unsigned char>(source));
+    }
+
+    if (m_entries.empty())
+        m_entries.resize(NUM_ENTRIES);
+    Entry& entry = m_entries[hash % NUM_ENTRIES];
+    entry.valid = true;
+    entry.simplify_reg_mul = simplify_reg_mul;
+    entry.hash = hash;
+    entry.key = orig;
+    entry.result = result;
+    entry.sources.swap(sources);
+}
+
 void
 Expr::Simplify(DiagnosticsEngine& diags, bool simplify_reg_mul)
 {
+    // A single value is already as simple as it gets.
+    if (m_terms.size() == 1 && !m_terms[0].isOp() && !m_terms[0].isEmpty())
+        return;
+
+    bool memoize = isMemoizable(m_terms);
+    unsigned long hash = 0;
+    ExprTerms orig;
+    if (memoize)
+    {
+        hash = HashTerms(m_terms);
+        if (simplify_memo.get().Lookup(m_terms, simplify_reg_mul, hash))
+        {
+            ++num_memo_hits;
+            return;
+        }
+        ++num_memo_misses;
+        orig = m_terms;
+    }
+
     TransformNeg();
 
     for (int pos=0, size=m_terms.size(); pos<size; ++pos)
@@ -785,6 +1051,9 @@ Expr::Simplify(DiagnosticsEngine& diags, bool simplify_reg_mul)
     }
 
     Cleanup();
+
+    if (memoize)
+        simplify_memo.get().Insert(orig, simplify_reg_mul, hash, m_terms);
 }
 
 bool
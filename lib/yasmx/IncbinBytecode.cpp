@@ -29,6 +29,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/system_error.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
@@ -73,7 +74,8 @@ public:
 private:
     std::string m_filename;     ///< file to include data from
 
-    OwningPtr<MemoryBuffer> m_buf;  ///< Buffer for file data
+    /// Buffer for file data (owned by the source manager)
+    const MemoryBuffer* m_buf;
 
     /// starting offset to read from (NULL=0)
     /*@null@*/ util::scoped_ptr<Expr> m_start;
@@ -87,6 +89,7 @@ IncbinBytecode::IncbinBytecode(StringRef filename,
                                std::auto_ptr<Expr> start,
                                std::auto_ptr<Expr> maxlen)
     : m_filename(filename),
+      m_buf(0),
       m_start(start.release()),
       m_maxlen(maxlen.release())
 {
@@ -99,12 +102,18 @@ IncbinBytecode::~IncbinBytecode()
 bool
 IncbinBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 {
-    if (llvm::error_code err = MemoryBuffer::getFile(m_filename, m_buf))
+    OwningPtr<MemoryBuffer> buf;
+    if (llvm::error_code err = MemoryBuffer::getFile(m_filename, buf))
     {
         diags.Report(bc.getSource(), diag::err_file_read) << m_filename
             << err.message();
         return false;
     }
+    // Hand the data to the source manager like any other input file, so
+    // it's part of what identifies the input (e.g. for span hints).
+    m_buf = buf.take();
+    diags.getSourceManager().createFileIDForMemBuffer(m_buf, 0, 0,
+                                                      bc.getSource());
 
     if (m_start)
     {
@@ -31,6 +31,7 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
 #include "yasmx/Arch.h"
+#include "yasmx/BytecodeContainer.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Expr_util.h"
@@ -293,7 +294,18 @@ Insn::Append(BytecodeContainer& container,
     }
     if (!ok)
         return false;
-    return DoAppend(container, source, diags);
+
+    // The instruction may only add fixed bytes to an earlier bytecode, so
+    // note where it starts separately, once it has been appended.
+    bool track = container.isTrackingInsnSources();
+    Location start = {0, 0};
+    if (track)
+        start = container.getEndLoc();
+    if (!DoAppend(container, source, diags))
+        return false;
+    if (track)
+        container.AddInsnSource(start, source);
+    return true;
 }
 
 #ifdef WITH_XML
@@ -36,22 +36,41 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/ThreadLocal.h"
 
 
 using namespace yasm;
 using llvm::APInt;
 
-/// Static bitvect used for conversions.
-static APInt conv_bv(IntNum::BITVECT_NATIVE_SIZE, 0);
-
-/// Static bitvects used for computation.
-static APInt result(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt spare(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt op1static(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt op2static(IntNum::BITVECT_NATIVE_SIZE, 0);
+namespace {
+/// Scratch bitvects.  Kept per thread so that IntNum computations in
+/// independent assemblies may run concurrently.
+struct Scratch
+{
+    Scratch()
+        : conv_bv(IntNum::BITVECT_NATIVE_SIZE, 0)
+        , result(IntNum::BITVECT_NATIVE_SIZE, 0)
+        , spare(IntNum::BITVECT_NATIVE_SIZE, 0)
+        , op1static(IntNum::BITVECT_NATIVE_SIZE, 0)
+        , op2static(IntNum::BITVECT_NATIVE_SIZE, 0)
+        , signext_bv(IntNum::BITVECT_NATIVE_SIZE, 0)
+    {}
+
+    /// Bitvect used for conversions.
+    APInt conv_bv;
+
+    /// Bitvects used for computation.
+    APInt result;
+    APInt spare;
+    APInt op1static;
+    APInt op2static;
+
+    /// Bitvect used for sign extension.
+    APInt signext_bv;
+};
+} // anonymous namespace
 
-/// Static bitvect used for sign extension.
-static APInt signext_bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+static ThreadLocal<Scratch> scratch;
 
 enum
 {
@@ -203,15 +222,17 @@ IntNum::setStr(StringRef str, unsigned int radix)
     }
 
     // long case
+    Scratch& s = scratch.get();
+    APInt& conv_bv = s.conv_bv;
     conv_bv = 0;
 
     // Figure out if we can shift instead of multiply
     unsigned int shift =
         (radix == 16 ? 4 : radix == 8 ? 3 : radix == 2 ? 1 : 0);
 
-    APInt& radixval = op1static;
-    APInt& charval = op2static;
-    APInt& oldval = spare;
+    APInt& radixval = s.op1static;
+    APInt& charval = s.op2static;
+    APInt& oldval = s.spare;
 
     radixval = radix;
     oldval = 0;
@@ -263,6 +284,37 @@ IntNum::IntNum(const IntNum& rhs)
         m_val.sv = rhs.m_val.sv;
 }
 
+/// Shift a small value left, if the result fits.
+/// @param lhs      value (updated with result)
+/// @param rhs      shift amount (nonnegative)
+/// @return False if the result does not fit.
+static inline bool
+ShiftLeftSmallValue(IntNumData::SmallValue* lhs, IntNumData::SmallValue rhs)
+{
+    if (*lhs == 0)
+        return true;
+    if (rhs >= SV_BITS)
+        return false;
+    IntNumData::SmallValue result = static_cast<IntNumData::SmallValue>(
+        static_cast<IntNumData::USmallValue>(*lhs) << rhs);
+    if ((result >> rhs) != *lhs)
+        return false;
+    *lhs = result;
+    return true;
+}
+
+/// Arithmetic shift a small value right.
+/// @param lhs      value (updated with result)
+/// @param rhs      shift amount (nonnegative)
+static inline void
+ShiftRightSmallValue(IntNumData::SmallValue* lhs, IntNumData::SmallValue rhs)
+{
+    // shifting by the width or more just leaves the sign
+    if (rhs > SV_BITS)
+        rhs = SV_BITS;
+    *lhs >>= rhs;
+}
+
 // Speedup function for non-bitvect calculations.
 // Always makes conservative assumptions; we fall back to bitvect if this
 // function does not set handled to true.
@@ -279,35 +331,52 @@ CalcSmallValue(bool* handled,
     static const IntNumData::SmallValue SV_MIN =
         std::numeric_limits<IntNumData::SmallValue>::min();
 
+    // Each operation checks for overflow before computing, and leaves
+    // *lhs unchanged (and *handled false) if the result doesn't fit.
     *handled = false;
     switch (op)
     {
         case Op::ADD:
-            if (*lhs >= SV_MAX/2 || *lhs <= SV_MIN/2 ||
-                rhs >= SV_MAX/2 || rhs <= SV_MIN/2)
+            if (rhs > 0 ? *lhs > SV_MAX - rhs : *lhs < SV_MIN - rhs)
                 return true;
             *lhs += rhs;
             break;
         case Op::SUB:
-            if (*lhs >= SV_MAX/2 || *lhs <= SV_MIN/2 ||
-                rhs >= SV_MAX/2 || rhs <= SV_MIN/2)
+            if (rhs < 0 ? *lhs > SV_MAX + rhs : *lhs < SV_MIN + rhs)
                 return true;
             *lhs -= rhs;
             break;
         case Op::MUL:
         {
-            // half range
+            // half range needs no further checking
             IntNumData::SmallValue minmax = 1;
             minmax <<= SV_BITS/2;
-            if (*lhs > -minmax && *lhs < minmax)
+            if (*lhs <= -minmax || *lhs >= minmax ||
+                rhs <= -minmax || rhs >= minmax)
             {
-                if (rhs <= -minmax || rhs >= minmax)
+                if (*lhs == 0 || rhs == 0)
+                {
+                    *lhs = 0;
+                    break;
+                }
+                if (rhs == -1 || *lhs == -1)
+                {
+                    // negation; only the minimum overflows
+                    if (*lhs == SV_MIN || rhs == SV_MIN)
+                        return true;
+                    *lhs = (rhs == -1) ? -(*lhs) : -rhs;
+                    break;
+                }
+                // the limit on the product's magnitude depends on its sign;
+                // division truncates toward zero, so comparing against the
+                // quotient is exact
+                IntNumData::SmallValue limit =
+                    ((*lhs < 0) == (rhs < 0)) ? SV_MAX : SV_MIN;
+                if (*lhs > 0 ? *lhs > limit / rhs : *lhs < limit / rhs)
                     return true;
-                *lhs *= rhs;
-                break;
             }
-            // maybe someday?
-            return true;
+            *lhs *= rhs;
+            break;
         }
         case Op::DIV:
             // TODO: make sure lhs and rhs are unsigned
@@ -318,6 +387,8 @@ CalcSmallValue(bool* handled,
                 diags->Report(source, diag::err_divide_by_zero);
                 return false;
             }
+            if (*lhs == SV_MIN && rhs == -1)
+                return true;
             *lhs /= rhs;
             break;
         case Op::MOD:
@@ -329,9 +400,14 @@ CalcSmallValue(bool* handled,
                 diags->Report(source, diag::err_divide_by_zero);
                 return false;
             }
-            *lhs %= rhs;
+            if (rhs == -1)
+                *lhs = 0;   // SV_MIN % -1 would trap
+            else
+                *lhs %= rhs;
             break;
         case Op::NEG:
+            if (*lhs == SV_MIN)
+                return true;
             *lhs = -(*lhs);
             break;
         case Op::NOT:
@@ -353,10 +429,21 @@ CalcSmallValue(bool* handled,
             *lhs = ~(*lhs | rhs);
             break;
         case Op::SHL:
-            // maybe someday?
-            return true;
+            if (rhs >= 0)
+            {
+                if (!ShiftLeftSmallValue(lhs, rhs))
+                    return true;
+            }
+            else if (rhs != SV_MIN)
+                ShiftRightSmallValue(lhs, -rhs);
+            else
+                return true;
+            break;
         case Op::SHR:
-            *lhs >>= rhs;
+            if (rhs >= 0)
+                ShiftRightSmallValue(lhs, rhs);
+            else if (rhs == SV_MIN || !ShiftLeftSmallValue(lhs, -rhs))
+                return true;
             break;
         case Op::LOR:
             *lhs = (*lhs || rhs);
@@ -403,6 +490,64 @@ CalcSmallValue(bool* handled,
     return true;
 }
 
+#ifdef YASM_HAVE_INT128
+__extension__ typedef __int128 WideValue;
+__extension__ typedef unsigned __int128 UWideValue;
+
+/// Calculate an operation on small values whose result overflowed a small
+/// value, at double width.
+/// @param op       operation
+/// @param lhs      left hand side
+/// @param rhs      right hand side
+/// @param result   result
+/// @return False if the result is not exact at double width.
+static bool
+CalcWideValue(Op::Op op,
+              IntNumData::SmallValue lhs,
+              IntNumData::SmallValue rhs,
+              WideValue* result)
+{
+    switch (op)
+    {
+        case Op::ADD:
+            *result = static_cast<WideValue>(lhs) + rhs;
+            return true;
+        case Op::SUB:
+            *result = static_cast<WideValue>(lhs) - rhs;
+            return true;
+        case Op::MUL:
+            *result = static_cast<WideValue>(lhs) * rhs;
+            return true;
+        case Op::DIV:
+        case Op::SIGNDIV:
+            *result = static_cast<WideValue>(lhs) / rhs;
+            return true;
+        case Op::NEG:
+            *result = -static_cast<WideValue>(lhs);
+            return true;
+        case Op::SHL:
+        case Op::SHR:
+        {
+            // only left shifts overflow
+            IntNumData::SmallValue shift = rhs;
+            if (op == Op::SHR)
+            {
+                if (rhs < -SV_BITS)
+                    return false;
+                shift = -rhs;
+            }
+            if (shift < 0 || shift > SV_BITS)
+                return false;
+            *result = static_cast<WideValue>(static_cast<UWideValue>(lhs)
+                                             << shift);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+#endif
+
 /*@-nullderef -nullpass -branchstate@*/
 bool
 IntNum::CalcImpl(Op::Op op,
@@ -416,19 +561,36 @@ IntNum::CalcImpl(Op::Op op,
     if (m_type == INTNUM_SV && (!operand || operand->m_type == INTNUM_SV))
     {
         bool handled = false;
-        if (!CalcSmallValue(&handled, op, &m_val.sv,
-                            operand ? operand->m_val.sv : 0, source, diags))
+        SmallValue rhs = operand ? operand->m_val.sv : 0;
+        if (!CalcSmallValue(&handled, op, &m_val.sv, rhs, source, diags))
             return false;
         if (handled)
             return true;
+#ifdef YASM_HAVE_INT128
+        // The result overflowed; it's still exact at double width.
+        WideValue wide;
+        if (CalcWideValue(op, m_val.sv, rhs, &wide))
+        {
+            uint64_t words[BITVECT_NATIVE_SIZE/64];
+            words[0] = static_cast<uint64_t>(wide);
+            words[1] = static_cast<uint64_t>(
+                static_cast<UWideValue>(wide) >> 64);
+            for (unsigned int i=2; i<BITVECT_NATIVE_SIZE/64; ++i)
+                words[i] = wide < 0 ? ~static_cast<uint64_t>(0) : 0;
+            setBV(APInt(BITVECT_NATIVE_SIZE, BITVECT_NATIVE_SIZE/64, words));
+            return true;
+        }
+#endif
     }
 
     // Always do computations with in full bit vector.
     // Bit vector results must be calculated through intermediate storage.
-    const APInt* op1 = getBV(&op1static);
+    Scratch& s = scratch.get();
+    APInt& result = s.result;
+    const APInt* op1 = getBV(&s.op1static);
     const APInt* op2 = 0;
     if (operand)
-        op2 = operand->getBV(&op2static);
+        op2 = operand->getBV(&s.op2static);
 
     // A operation does a bitvector computation if result is allocated.
     switch (op)
@@ -605,7 +767,7 @@ void
 IntNum::SignExtend(unsigned int size)
 {
     // For now, always implement with full bit vector.
-    APInt* bv = getBV(&signext_bv);
+    APInt* bv = getBV(&scratch.get().signext_bv);
     *bv = bv->trunc(size).sext(BITVECT_NATIVE_SIZE);
     setBV(*bv);
 }
@@ -748,7 +910,8 @@ IntNum::isOkSize(unsigned int size, unsigned int rshift, int rangetype) const
                 return false;
         }
     }
-    return yasm::isOkSize(*getBV(&conv_bv), size, rshift, rangetype);
+    return yasm::isOkSize(*getBV(&scratch.get().conv_bv), size, rshift,
+                          rangetype);
 }
 
 bool
@@ -808,8 +971,9 @@ yasm::Compare(const IntNum& lhs, const IntNum& rhs)
         return 0;
     }
 
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+    Scratch& s = scratch.get();
+    const APInt* op1 = lhs.getBV(&s.op1static);
+    const APInt* op2 = rhs.getBV(&s.op2static);
     if (op1->slt(*op2))
         return -1;
     if (op1->sgt(*op2))
@@ -823,8 +987,9 @@ yasm::operator==(const IntNum& lhs, const IntNum& rhs)
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv == rhs.m_val.sv;
 
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+    Scratch& s = scratch.get();
+    const APInt* op1 = lhs.getBV(&s.op1static);
+    const APInt* op2 = rhs.getBV(&s.op2static);
     return op1->eq(*op2);
 }
 
@@ -834,8 +999,9 @@ yasm::operator<(const IntNum& lhs, const IntNum& rhs)
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv < rhs.m_val.sv;
 
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+    Scratch& s = scratch.get();
+    const APInt* op1 = lhs.getBV(&s.op1static);
+    const APInt* op2 = rhs.getBV(&s.op2static);
     return op1->slt(*op2);
 }
 
@@ -845,8 +1011,9 @@ yasm::operator>(const IntNum& lhs, const IntNum& rhs)
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv > rhs.m_val.sv;
 
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+    Scratch& s = scratch.get();
+    const APInt* op1 = lhs.getBV(&s.op1static);
+    const APInt* op2 = rhs.getBV(&s.op2static);
     return op1->sgt(*op2);
 }
 
@@ -860,18 +1027,18 @@ IntNum::getStr(SmallVectorImpl<char>& str, int base, bool lowercase) const
         return;
     }
 
-    long v = m_val.sv;
-    if (v < 0)
+    unsigned long v = static_cast<unsigned long>(m_val.sv);
+    if (m_val.sv < 0)
     {
         v = -v;
         str.push_back('-');
     }
 
-    const char* fmt = "%ld";
+    const char* fmt = "%lu";
     switch (base)
     {
         case 8:     fmt = "%lo"; break;
-        case 10:    fmt = "%ld"; break;
+        case 10:    fmt = "%lu"; break;
         case 16:
             if (lowercase)
                 fmt = "%lx";
@@ -880,13 +1047,13 @@ IntNum::getStr(SmallVectorImpl<char>& str, int base, bool lowercase) const
             break;
         default:
             // fall back to bigval
-            getBV(&conv_bv)->toString(str, static_cast<unsigned>(base), true,
-                                      false, lowercase);
+            getBV(&scratch.get().conv_bv)->toString(
+                str, static_cast<unsigned>(base), true, false, lowercase);
             return;
     }
 
     char s[40];
-    std::sprintf(s, fmt, m_val.sv);
+    std::sprintf(s, fmt, v);
     str.append(s, s+std::strlen(s));
 }
 
@@ -936,6 +1103,7 @@ IntNum::Print(raw_ostream& os,
               bool showbase,
               int bits) const
 {
+    APInt& conv_bv = scratch.get().conv_bv;
     const APInt* bv = getBV(&conv_bv);
 
     if (bv->isNegative())
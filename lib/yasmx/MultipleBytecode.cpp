@@ -38,6 +38,7 @@
 
 
 STATISTIC(num_multiple, "Number of multiple bytecodes");
+STATISTIC(num_multiple_merged, "Number of multiples merged into data");
 STATISTIC(num_skip, "Number of skip bytecodes");
 STATISTIC(num_fill, "Number of fill bytecodes");
 
@@ -595,6 +596,29 @@ yasm::AppendMultiple(BytecodeContainer& container,
                      std::auto_ptr<Expr> multiple,
                      SourceLocation source)
 {
+    // optimize common case: constant count of fixed-only data; just
+    // append the repeated bytes onto the end of the container
+    if (multiple->isIntNum() && contents->size() == 1)
+    {
+        const Bytecode& inner = contents->bytecodes_front();
+        long num = multiple->getIntNum().getInt();
+        unsigned long len = inner.getFixedLen();
+        // heuristic upper bound on merged size
+        if (!inner.hasContents() && !inner.hasFixups() && num >= 0 &&
+            (len == 0 || static_cast<unsigned long>(num) <= 4096/len))
+        {
+            ++num_multiple_merged;
+            if (len == 0)
+                return;     // nothing to repeat, however many times
+            Bytes& fixed = container.FreshBytecode().getFixed();
+            const Bytes& data = inner.getFixed();
+            for (long i=0; i<num; ++i)
+                fixed.insert(fixed.end(), data.begin(), data.end());
+            return;
+        }
+    }
+
+    // general case
     ++num_multiple;
     Bytecode& bc = container.FreshBytecode();
     MultipleBytecode* multbc(new MultipleBytecode(contents, multiple));
@@ -36,13 +36,14 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Support/ThreadLocal.h"
 
 
 using namespace yasm;
 using llvm::APInt;
 using llvm::APFloat;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+static ThreadLocal<APInt> staticbv(APInt(IntNum::BITVECT_NATIVE_SIZE, 0));
 
 NumericOutput::NumericOutput(Bytes& bytes)
     : m_bytes(bytes)
@@ -178,7 +179,7 @@ NumericOutput::OutputInteger(const IntNum& intn)
 {
     // Handle bigval specially
     if (!intn.isInt())
-        return OutputInteger(*intn.getBV(&staticbv));
+        return OutputInteger(*intn.getBV(&staticbv.get()));
 
     int destsize = m_bytes.size();
 
@@ -37,6 +37,7 @@
 #include "llvm/ADT/Twine.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/Support/ThreadPool.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Optimizer.h"
@@ -48,6 +49,9 @@
 
 STATISTIC(num_exist_symbol, "Number of existing symbols found by name");
 STATISTIC(num_new_symbol, "Number of symbols created by name");
+STATISTIC(num_section_optimizers, "Number of sections optimized separately");
+STATISTIC(num_combined_optimizers,
+          "Number of separate optimizations combined due to external spans");
 
 using namespace yasm;
 
@@ -59,6 +63,72 @@ public:
     StringRef operator() (const Symbol* sym) const
     { return sym->getName(); }
 };
+
+/// Optimizer state for one section when optimizing sections in parallel.
+/// Diagnostics are deferred so they can be reported in section order.
+/// The section's engine has no source manager, as its lookup caches are not
+/// thread-safe; locations are only resolved when replayed on the main thread.
+class SectionOptimizer
+{
+public:
+    SectionOptimizer(Section& sect, DiagnosticsEngine& diags)
+        : m_sect(sect)
+        , m_diags(diags.getDiagnosticIDs(), &m_deferred, false)
+        , m_opt(m_diags)
+        , m_done(false)
+    {}
+
+    void Step1b() { m_opt.Step1b(); }
+    void UpdateOffsets() { m_sect.UpdateOffsets(m_diags); }
+    void Step1d() { m_done = m_opt.Step1d(); }
+    void Step1e() { m_opt.Step1e(); }
+    void Step2() { m_opt.Step2(); }
+
+    Section& m_sect;
+    DeferredDiagConsumer m_deferred;
+    DiagnosticsEngine m_diags;
+    Optimizer m_opt;
+    bool m_done;    ///< Step1d() result
+};
+
+typedef stdx::ptr_vector<SectionOptimizer> SectionOptimizers;
+
+/// Saves the hints of all section optimizers, in section order, however
+/// optimization finishes.
+class SaveSectionHints
+{
+public:
+    SaveSectionHints(SectionOptimizers& sects) : m_sects(sects) {}
+    ~SaveSectionHints()
+    {
+        for (SectionOptimizers::iterator i=m_sects.begin(), end=m_sects.end();
+             i != end; ++i)
+            i->m_opt.SaveHints();
+    }
+private:
+    SectionOptimizers& m_sects;
+};
+
+/// Run an optimization step on every section, then report the deferred
+/// diagnostics in section order.
+void
+RunSectionStep(ThreadPool& pool,
+               SectionOptimizers& sects,
+               void (SectionOptimizer::*step)(),
+               DiagnosticsEngine& diags)
+{
+    for (SectionOptimizers::iterator i=sects.begin(), end=sects.end();
+         i != end; ++i)
+        pool.Async(TR1::bind(step, &(*i)));
+    pool.Wait();
+
+    for (SectionOptimizers::iterator i=sects.begin(), end=sects.end();
+         i != end; ++i)
+    {
+        i->m_deferred.Replay(diags);
+        i->m_deferred.clear();
+    }
+}
 } // anonymous namespace
 
 namespace yasm {
@@ -108,6 +178,7 @@ Object::Object(StringRef src_filename, StringRef obj_filename, Arch* arch)
 {
     m_options.DisableGlobalSubRelative = false;
     m_options.PowerOfTwoAlignment = false;
+    m_options.TrackInsnSources = false;
     m_config.ExecStack = false;
     m_config.NoExecStack = false;
 }
@@ -309,9 +380,16 @@ Object::UpdateBytecodeOffsets(DiagnosticsEngine& diags)
 }
 
 void
-Object::Optimize(DiagnosticsEngine& diags)
+Object::Optimize(DiagnosticsEngine& diags, ThreadPool* pool, SpanHints* hints)
 {
+    if (pool && m_sections.size() > 1)
+    {
+        OptimizeSections(diags, *pool, hints);
+        return;
+    }
+
     Optimizer opt(diags);
+    opt.setHints(hints);
     unsigned long bc_index = 0;
 
     // Step 1a
@@ -320,6 +398,9 @@ Object::Optimize(DiagnosticsEngine& diags)
     {
         unsigned long offset = 0;
 
+        // Lengths are recalculated, so all offsets are recalculated too.
+        sect->InvalidateOffsets();
+
         // Set the offset of the first (empty) bytecode.
         sect->bytecodes_front().setIndex(bc_index++);
         sect->bytecodes_front().setOffset(0);
@@ -351,6 +432,13 @@ Object::Optimize(DiagnosticsEngine& diags)
     if (diags.hasErrorOccurred())
         return;
 
+    OptimizeFinish(opt, diags);
+    opt.SaveHints();
+}
+
+void
+Object::OptimizeFinish(Optimizer& opt, DiagnosticsEngine& diags)
+{
     // Step 1c
     UpdateBytecodeOffsets(diags);
     if (diags.hasErrorOccurred())
@@ -373,3 +461,113 @@ Object::Optimize(DiagnosticsEngine& diags)
     // Step 3
     UpdateBytecodeOffsets(diags);
 }
+
+void
+Object::OptimizeSections(DiagnosticsEngine& diags,
+                         ThreadPool& pool,
+                         SpanHints* hints)
+{
+    // Spans can only measure distances within a section, so each section
+    // normally gets its own optimizer and the steps after 1a run on all
+    // sections at once.  Bytecode indexes remain global.
+    SectionOptimizers sects;
+    stdx::ptr_vector_owner<SectionOptimizer> sects_owner(sects);
+    SaveSectionHints save_hints(sects);
+    unsigned long bc_index = 0;
+
+    // Step 1a (serial, as length calculation may look at other sections)
+    for (section_iterator sect=m_sections.begin(), sectend=m_sections.end();
+         sect != sectend; ++sect)
+    {
+        sects.push_back(new SectionOptimizer(*sect, diags));
+        ++num_section_optimizers;
+        Optimizer& opt = sects.back().m_opt;
+        opt.setHints(hints);
+        unsigned long offset = 0;
+
+        // Lengths are recalculated, so all offsets are recalculated too.
+        sect->InvalidateOffsets();
+
+        // Set the offset of the first (empty) bytecode.
+        sect->bytecodes_front().setIndex(bc_index++);
+        sect->bytecodes_front().setOffset(0);
+
+        // Iterate through the remainder, if any.
+        for (Section::bc_iterator bc=sect->bytecodes_begin(),
+             bcend=sect->bytecodes_end(); bc != bcend; ++bc)
+        {
+            bc->setIndex(bc_index++);
+            bc->setOffset(offset);
+
+            if (bc->CalcLen(TR1::bind(&Optimizer::AddSpan, &opt,
+                                      _1, _2, _3, _4, _5),
+                            diags))
+            {
+                if (bc->getSpecial() == Bytecode::Contents::SPECIAL_OFFSET)
+                    opt.AddOffsetSetter(*bc);
+
+                offset = bc->getNextOffset();
+            }
+        }
+    }
+
+    if (diags.hasErrorOccurred())
+        return;
+
+    // Step 1b
+    RunSectionStep(pool, sects, &SectionOptimizer::Step1b, diags);
+    if (diags.hasErrorOccurred())
+        return;
+
+    // If any span reaches outside its section, the sections are not
+    // independent after all; finish with a single combined optimizer.
+    bool external = false;
+    for (SectionOptimizers::const_iterator i=sects.begin(), end=sects.end();
+         i != end; ++i)
+    {
+        if (i->m_opt.hasExternalTerms())
+            external = true;
+    }
+    if (external)
+    {
+        ++num_combined_optimizers;
+        Optimizer opt(diags);
+        opt.setHints(hints);
+        for (SectionOptimizers::iterator i=sects.begin(), end=sects.end();
+             i != end; ++i)
+            opt.Absorb(i->m_opt);
+        OptimizeFinish(opt, diags);
+        opt.SaveHints();
+        return;
+    }
+
+    // Step 1c
+    RunSectionStep(pool, sects, &SectionOptimizer::UpdateOffsets, diags);
+    if (diags.hasErrorOccurred())
+        return;
+
+    // Step 1d
+    RunSectionStep(pool, sects, &SectionOptimizer::Step1d, diags);
+    bool done = true;
+    for (SectionOptimizers::const_iterator i=sects.begin(), end=sects.end();
+         i != end; ++i)
+    {
+        if (!i->m_done)
+            done = false;
+    }
+    if (done)
+        return;
+
+    // Step 1e
+    RunSectionStep(pool, sects, &SectionOptimizer::Step1e, diags);
+    if (diags.hasErrorOccurred())
+        return;
+
+    // Step 2
+    RunSectionStep(pool, sects, &SectionOptimizer::Step2, diags);
+    if (diags.hasErrorOccurred())
+        return;
+
+    // Step 3
+    RunSectionStep(pool, sects, &SectionOptimizer::UpdateOffsets, diags);
+}
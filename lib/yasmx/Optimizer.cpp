@@ -30,7 +30,6 @@
 
 #include <algorithm>
 #include <deque>
-#include <list>
 #include <memory>
 #include <vector>
 
@@ -43,7 +42,13 @@
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/SpanHints.h"
+#include "yasmx/Support/Arena.h"
+#ifdef OPTIMIZER_USE_ITREE
 #include "yasmx/Support/IntervalTree.h"
+#else
+#include "yasmx/Support/IntervalIndex.h"
+#endif
 #include "yasmx/Bytecode.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/Expr.h"
@@ -61,6 +66,10 @@ STATISTIC(num_offset_setters, "Number of offset setters");
 STATISTIC(num_recalc, "Number of span recalculations performed");
 STATISTIC(num_expansions, "Number of expansions performed");
 STATISTIC(num_initial_qb, "Number of spans on initial QB");
+STATISTIC(num_hinted_expansions, "Number of expansions seeded from hints");
+STATISTIC(peak_spans, "Peak spans held by one optimizer");
+STATISTIC(peak_span_bytes,
+          "Peak bytes of span and span term storage in one optimizer");
 
 using namespace yasm;
 
@@ -229,14 +238,30 @@ public:
         unsigned int m_subst;
     };
 
+    typedef std::vector<Term> Terms;
+
     Span(Bytecode& bc,
          int id,
          const Value& value,
          long neg_thres,
          long pos_thres,
-         size_t os_index);
+         size_t os_index,
+         Terms& terms);
     ~Span();
 
+    // Spans are allocated from the optimizer's arena.
+    static void* operator new(std::size_t size)
+    { return Arena::Allocate(size); }
+    static void operator delete(void* p, std::size_t size)
+    { Arena::Deallocate(p, size); }
+
+    Term* terms_begin()
+    { return m_num_terms == 0 ? 0 : &(*m_terms)[m_first_term]; }
+    Term* terms_end() { return terms_begin() + m_num_terms; }
+    const Term* terms_begin() const
+    { return m_num_terms == 0 ? 0 : &(*m_terms)[m_first_term]; }
+    const Term* terms_end() const { return terms_begin() + m_num_terms; }
+
     bool CreateTerms(Optimizer::Impl* optimize, DiagnosticsEngine& diags);
     bool RecalcNormal(DiagnosticsEngine& diags);
 
@@ -254,15 +279,21 @@ private:
 
     Bytecode& m_bc;
 
-    Value m_depval;
+    // Absolute portion of the dependent value.  Relative values are
+    // forced to the longest form, so their absolute portion isn't copied.
+    Expr m_abs;
+    bool m_relative;
 
-    // span terms in absolute portion of value
-    typedef std::vector<Term> Terms;
-    Terms m_span_terms;
+    // Span terms in absolute portion of value.  These are kept with all
+    // other spans' terms in the optimizer, so are referenced by index.
+    Terms* m_terms;
+    unsigned int m_first_term;
+    unsigned int m_num_terms;
     ExprTerms m_expr_terms;
 
     long m_cur_val;
     long m_new_val;
+    long m_min_val;     // value with minimum-length bytecodes (step 1b)
 
     long m_neg_thres;
     long m_pos_thres;
@@ -288,6 +319,9 @@ public:
     Impl(DiagnosticsEngine& diags);
     ~Impl();
 
+    void Absorb(Impl& oth);
+    void DeleteSpan(Span* span);
+    void UpdatePeakMemory();
     void Step1b();
     bool Step1d();
     void Step1e();
@@ -297,21 +331,88 @@ public:
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
 
+    bool ExpandFromHint(Span& span, bool* still_depend);
+    void RecordHint(const Span& span, long value);
+
     void ITreeAdd(Span& span, Span::Term& term);
-    void CheckCycle(IntervalTreeNode<Span::Term*> * node,
-                    Span& span);
-    void ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff);
+    void CheckCycle(Span::Term* term, Span& span);
+    void ExpandTerm(Span::Term* term, long len_diff);
+
+    // Enumeration callbacks.
+    class CheckCycleFunc
+    {
+    public:
+        CheckCycleFunc(Impl& impl, Span& span) : m_impl(impl), m_span(span)
+        {}
+        void operator() (Span::Term* term)
+        { m_impl.CheckCycle(term, m_span); }
+    private:
+        Impl& m_impl;
+        Span& m_span;
+    };
+
+    class ExpandTermFunc
+    {
+    public:
+        ExpandTermFunc(Impl& impl, long len_diff)
+            : m_impl(impl), m_len_diff(len_diff)
+        {}
+        void operator() (Span::Term* term)
+        { m_impl.ExpandTerm(term, m_len_diff); }
+    private:
+        Impl& m_impl;
+        long m_len_diff;
+    };
+
+#ifdef OPTIMIZER_USE_ITREE
+    template <typename F>
+    class NodeFunc
+    {
+    public:
+        NodeFunc(F& func) : m_func(func) {}
+        void operator() (IntervalTreeNode<Span::Term*>* node)
+        { m_func(node->getData()); }
+    private:
+        F& m_func;
+    };
+#endif
+
+    /// Call func for each span term spanning the bytecode with given index.
+    template <typename F>
+    void EnumerateTerms(unsigned long index, F func)
+    {
+        long i = static_cast<long>(index);
+#ifdef OPTIMIZER_USE_ITREE
+        m_itree.Enumerate(i, i, NodeFunc<F>(func));
+#else
+        m_itree.Enumerate(i, i, func);
+#endif
+    }
 
     DiagnosticsEngine& m_diags;
 
-    typedef std::list<Span*> Spans;
+    typedef std::vector<Span*> Spans;
     Spans m_spans;      // ownership list
+    Span::Terms m_terms;    // terms of all spans
+    Arena* m_arena;         // span storage
 
     typedef std::deque<Span*> SpanQueue;
     SpanQueue m_QA, m_QB;
 
+#ifdef OPTIMIZER_USE_ITREE
     IntervalTree<Span::Term*> m_itree;
+#else
+    IntervalIndex<Span::Term*> m_itree;     // built in Step1e
+#endif
     std::vector<OffsetSetter> m_offset_setters;
+
+    // True if a span term crosses into another container (set in Step1b).
+    bool m_external_terms;
+
+    // Hints used to seed expansions in Step1b (may be null), and the
+    // expansions made, to be saved into them.
+    SpanHints* m_hints;
+    std::vector<SpanHints::Hint> m_hint_log;
 };
 } // namespace yasm
 
@@ -357,17 +458,24 @@ Span::Span(Bytecode& bc,
            /*@null@*/ const Value& value,
            long neg_thres,
            long pos_thres,
-           size_t os_index)
+           size_t os_index,
+           Terms& terms)
     : m_bc(bc),
-      m_depval(value),
+      m_relative(value.isRelative()),
+      m_terms(&terms),
+      m_first_term(0),
+      m_num_terms(0),
       m_cur_val(0),
       m_new_val(0),
+      m_min_val(0),
       m_neg_thres(neg_thres),
       m_pos_thres(pos_thres),
       m_id(id),
       m_active(ACTIVE),
       m_os_index(os_index)
 {
+    if (!m_relative && value.hasAbs())
+        m_abs = *value.getAbs();
     ++num_spans;
 }
 
@@ -378,8 +486,10 @@ Optimizer::AddSpan(Bytecode& bc,
                    long neg_thres,
                    long pos_thres)
 {
+    Arena::Scope arena_scope(m_impl->m_arena);
     m_impl->m_spans.push_back(new Span(bc, id, value, neg_thres, pos_thres,
-                                       m_impl->m_offset_setters.size()-1));
+                                       m_impl->m_offset_setters.size()-1,
+                                       m_impl->m_terms));
 }
 
 void
@@ -390,23 +500,28 @@ Span::AddTerm(unsigned int subst, Location loc, Location loc2)
     ok = ok;    // avoid warning due to assert usage
     assert(ok && "could not calculate bc distance");
 
-    if (subst >= m_span_terms.size())
-        m_span_terms.resize(subst+1);
-    m_span_terms[subst] = Term(subst, loc, loc2, this, intn.getInt());
+    if (subst >= m_num_terms)
+    {
+        m_num_terms = subst+1;
+        m_terms->resize(m_first_term + m_num_terms);
+    }
+    (*m_terms)[m_first_term + subst] =
+        Term(subst, loc, loc2, this, intn.getInt());
 }
 
 bool
 Span::CreateTerms(Optimizer::Impl* optimize, DiagnosticsEngine& diags)
 {
     // Split out sym-sym terms in absolute portion of dependent value
-    if (m_depval.hasAbs())
+    if (!m_abs.isEmpty())
     {
-        SubstDist(*m_depval.getAbs(), diags,
-                  TR1::bind(&Span::AddTerm, this, _1, _2, _3));
-        if (m_span_terms.size() > 0)
+        // Terms are added to the end of the optimizer's term storage.
+        m_first_term = m_terms->size();
+        m_num_terms = 0;
+        SubstDist(m_abs, diags, TR1::bind(&Span::AddTerm, this, _1, _2, _3));
+        if (m_num_terms > 0)
         {
-            for (Terms::iterator i=m_span_terms.begin(),
-                 end=m_span_terms.end(); i != end; ++i)
+            for (Term* i=terms_begin(), *end=terms_end(); i != end; ++i)
             {
                 // Create expression terms with dummy value
                 m_expr_terms.push_back(ExprTerm(0));
@@ -436,18 +551,16 @@ Span::RecalcNormal(DiagnosticsEngine& diags)
     ++num_recalc;
     m_new_val = 0;
 
-    if (m_depval.isRelative())
+    if (m_relative)
         m_new_val = LONG_MAX;       // too complex; force to longest form
-    else if (m_depval.hasAbs())
+    else if (!m_abs.isEmpty())
     {
         ExprTerm result;
 
         // Update sym-sym terms and substitute back into expr
-        for (Terms::iterator i=m_span_terms.begin(), end=m_span_terms.end();
-             i != end; ++i)
+        for (const Term* i=terms_begin(), *end=terms_end(); i != end; ++i)
             *m_expr_terms[i->m_subst].getIntNum() = i->m_new_val;
-        if (!Evaluate(*m_depval.getAbs(), diags, &result, m_expr_terms, false,
-                      false)
+        if (!Evaluate(m_abs, diags, &result, m_expr_terms, false, false)
             || !result.isType(ExprTerm::INT))
             m_new_val = LONG_MAX;   // too complex; force to longest form
         else
@@ -489,18 +602,17 @@ Span::Write(pugi::xml_node out) const
         Twine::utohexstr((uint64_t)(&m_bc)).str().c_str();
     root.append_attribute("id") = m_id;
 
-    if (!m_depval.hasAbs() || m_depval.isRelative())
-        append_child(root, "DepVal", m_depval);
+    if (m_relative)
+        append_child(root, "DepVal", "relative");
     else
     {
         SmallString<256> ss;
         llvm::raw_svector_ostream oss(ss);
-        oss << *m_depval.getAbs() << '\0';
+        oss << m_abs << '\0';
         append_child(root, "DepVal", oss.str().data());
     }
 
-    for (Terms::const_iterator i=m_span_terms.begin(), end=m_span_terms.end();
-         i != end; ++i)
+    for (const Term* i=terms_begin(), *end=terms_end(); i != end; ++i)
         append_data(root, *i);
 
     root.append_attribute("curval") = m_cur_val;
@@ -536,6 +648,9 @@ Span::WriteRef(pugi::xml_node out) const
 
 Optimizer::Impl::Impl(DiagnosticsEngine& diags)
     : m_diags(diags)
+    , m_arena(new Arena)
+    , m_external_terms(false)
+    , m_hints(0)
 {
     // Create an placeholder offset setter for spans to point to; this will
     // get updated if/when we actually run into one.
@@ -544,11 +659,10 @@ Optimizer::Impl::Impl(DiagnosticsEngine& diags)
 
 Optimizer::Impl::~Impl()
 {
-    while (!m_spans.empty())
-    {
-        delete m_spans.back();
-        m_spans.pop_back();
-    }
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+        delete *spani;
+    delete m_arena;
 }
 
 #ifdef WITH_XML
@@ -632,9 +746,8 @@ Optimizer::Impl::ITreeAdd(Span& span, Span::Term& term)
 }
 
 void
-Optimizer::Impl::CheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
+Optimizer::Impl::CheckCycle(Span::Term* term, Span& span)
 {
-    Span::Term* term = node->getData();
     Span* depspan = term->m_span;
 
     // Only check for cycles in id=0 spans
@@ -658,9 +771,8 @@ Optimizer::Impl::CheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
 }
 
 void
-Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
+Optimizer::Impl::ExpandTerm(Span::Term* term, long len_diff)
 {
-    Span::Term* term = node->getData();
     Span* span = term->m_span;
     long precbc_index, precbc2_index;
 
@@ -687,7 +799,7 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
     else
         term->m_new_val -= len_diff;
     DEBUG(llvm::errs() << "updated " << span->getName() << " term "
-          << (term-&span->m_span_terms.front())
+          << (term-span->terms_begin())
           << " newval to " << term->m_new_val << '\n');
 
     // If already on Q, don't re-add
@@ -714,20 +826,133 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
     span->m_active = Span::ON_Q;    // Mark as being in Q
 }
 
+void
+Optimizer::Impl::Absorb(Impl& oth)
+{
+    // Our trailing placeholder is replaced by the other optimizer's offset
+    // setters (ending with its own placeholder), so the other's spans are
+    // rebased to refer to the same setters at their new positions.
+    std::size_t base = m_offset_setters.size()-1;
+    m_offset_setters.pop_back();
+    m_offset_setters.insert(m_offset_setters.end(),
+                            oth.m_offset_setters.begin(),
+                            oth.m_offset_setters.end());
+    oth.m_offset_setters.clear();
+    oth.m_offset_setters.push_back(OffsetSetter());
+
+    // Likewise, their terms move to the end of our term storage.  The
+    // spans themselves stay in the other optimizer's arena, which lives
+    // until they are deleted.
+    unsigned int term_base = m_terms.size();
+    m_terms.insert(m_terms.end(), oth.m_terms.begin(), oth.m_terms.end());
+    Span::Terms().swap(oth.m_terms);
+
+    for (Spans::iterator spani=oth.m_spans.begin(),
+         endspan=oth.m_spans.end(); spani != endspan; ++spani)
+    {
+        (*spani)->m_os_index += base;
+        (*spani)->m_terms = &m_terms;
+        (*spani)->m_first_term += term_base;
+    }
+    m_spans.insert(m_spans.end(), oth.m_spans.begin(), oth.m_spans.end());
+    oth.m_spans.clear();
+    UpdatePeakMemory();
+
+    if (oth.m_external_terms)
+        m_external_terms = true;
+    oth.m_external_terms = false;
+
+    m_hint_log.insert(m_hint_log.end(), oth.m_hint_log.begin(),
+                      oth.m_hint_log.end());
+    oth.m_hint_log.clear();
+}
+
+// Find the section and index within it that identify a span's bytecode for
+// hints.  Returns false if the bytecode is not directly in a section.
+static bool
+getHintIndex(const Bytecode& bc, StringRef* section, unsigned long* index)
+{
+    const BytecodeContainer* container = bc.getContainer();
+    if (!container || !container->getSection())
+        return false;
+    *section = container->getSection()->getName();
+    *index = bc.getIndex() - container->bytecodes_front().getIndex();
+    return true;
+}
+
+bool
+Optimizer::Impl::ExpandFromHint(Span& span, bool* still_depend)
+{
+    // Only size-selecting spans are hinted; TIMES values must be exact.
+    // The hint is only used if the span covers the same minimum-length
+    // code as when it was recorded.
+    StringRef section;
+    unsigned long index;
+    long value;
+    if (!m_hints || span.m_id <= 0
+        || !getHintIndex(span.m_bc, &section, &index)
+        || !m_hints->Lookup(section, index, span.m_id, span.m_min_val,
+                            &value)
+        || (value >= span.m_neg_thres && value <= span.m_pos_thres))
+        return true;
+
+    ++num_hinted_expansions;
+    DEBUG(llvm::errs() << "hinted " << span.getName() << " newval "
+          << value << '\n');
+    if (!span.m_bc.Expand(span.m_id, span.m_new_val, value, still_depend,
+                          &span.m_neg_thres, &span.m_pos_thres, m_diags))
+        return false;
+    RecordHint(span, value);
+    return true;
+}
+
+void
+Optimizer::Impl::RecordHint(const Span& span, long value)
+{
+    StringRef section;
+    SpanHints::Hint hint;
+    if (!m_hints || span.m_id <= 0
+        || !getHintIndex(span.m_bc, &section, &hint.index))
+        return;
+    hint.section = section;
+    hint.id = span.m_id;
+    hint.min_value = span.m_min_val;
+    hint.value = value;
+    m_hint_log.push_back(hint);
+}
+
 void
 Optimizer::Impl::Step1b()
 {
-    Spans::iterator spani = m_spans.begin();
-    while (spani != m_spans.end())
+    // Finished spans are deleted; the rest are kept in order.
+    Spans::iterator out = m_spans.begin();
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
     {
         Span* span = *spani;
-        if (span->CreateTerms(this, m_diags) && span->RecalcNormal(m_diags))
+        bool ok = span->CreateTerms(this, m_diags);
+
+        // Note any terms not in the span's container
+        for (const Span::Term* term=span->terms_begin(),
+             *endterm=span->terms_end(); term != endterm; ++term)
+        {
+            if ((term->m_loc.bc && term->m_loc.bc->getContainer() !=
+                 span->m_bc.getContainer()) ||
+                (term->m_loc2.bc && term->m_loc2.bc->getContainer() !=
+                 span->m_bc.getContainer()))
+                m_external_terms = true;
+        }
+
+        bool exceeded = ok && span->RecalcNormal(m_diags);
+        span->m_min_val = span->m_new_val;
+        if (exceeded)
         {
             bool still_depend = false;
             if (!span->m_bc.Expand(span->m_id, span->m_cur_val, span->m_new_val,
                                    &still_depend, &span->m_neg_thres,
                                    &span->m_pos_thres, m_diags))
             {
+                *out++ = span;
                 continue; // error
             }
             else if (still_depend)
@@ -740,16 +965,49 @@ Optimizer::Impl::Step1b()
             }
             else
             {
-                delete *spani;
-                spani = m_spans.erase(spani);
+                DeleteSpan(span);
                 continue;
             }
         }
+
+        // If a previous assembly expanded this span, do so now rather than
+        // waiting for step 2 to discover it.
+        bool still_depend = true;
+        if (ok && span->m_active != Span::INACTIVE
+            && ExpandFromHint(*span, &still_depend) && !still_depend)
+        {
+            DeleteSpan(span);
+            continue;
+        }
+
         DEBUG(llvm::errs() << "updated " << span->getName() << " curval from "
               << span->m_cur_val << " to " << span->m_new_val << '\n');
         span->m_cur_val = span->m_new_val;
-        ++spani;
+        *out++ = span;
     }
+    m_spans.erase(out, m_spans.end());
+    UpdatePeakMemory();
+}
+
+void
+Optimizer::Impl::DeleteSpan(Span* span)
+{
+    // The terms of the span being processed are the last ones created.
+    if (span->m_num_terms > 0 &&
+        span->m_first_term + span->m_num_terms == m_terms.size())
+        m_terms.resize(span->m_first_term);
+    delete span;
+}
+
+void
+Optimizer::Impl::UpdatePeakMemory()
+{
+    if (!llvm::AreStatisticsEnabled())
+        return;
+    peak_spans.updateMax(m_spans.size());
+    peak_span_bytes.updateMax(m_spans.size() * sizeof(Span)
+                              + m_spans.capacity() * sizeof(Span*)
+                              + m_terms.capacity() * sizeof(Span::Term));
 }
 
 bool
@@ -762,8 +1020,8 @@ Optimizer::Impl::Step1d()
         Span* span = *spani;
 
         // Update span terms based on new bc offsets
-        for (Span::Terms::iterator term=span->m_span_terms.begin(),
-             endterm=span->m_span_terms.end(); term != endterm; ++term)
+        for (Span::Term* term=span->terms_begin(),
+             *endterm=span->terms_end(); term != endterm; ++term)
         {
             IntNum intn;
             bool ok = CalcDist(term->m_loc, term->m_loc2, &intn);
@@ -772,7 +1030,7 @@ Optimizer::Impl::Step1d()
             term->m_cur_val = term->m_new_val;
             term->m_new_val = intn.getInt();
             DEBUG(llvm::errs() << "updated " << span->getName() << " term "
-                  << (term-span->m_span_terms.begin())
+                  << (term-span->terms_begin())
                   << " newval to " << term->m_new_val << '\n');
         }
 
@@ -809,10 +1067,13 @@ Optimizer::Impl::Step1e()
          spani != endspan; ++spani)
     {
         Span* span = *spani;
-        for (Span::Terms::iterator term=span->m_span_terms.begin(),
-             endterm=span->m_span_terms.end(); term != endterm; ++term)
+        for (Span::Term* term=span->terms_begin(),
+             *endterm=span->terms_end(); term != endterm; ++term)
             ITreeAdd(*span, *term);
     }
+#ifndef OPTIMIZER_USE_ITREE
+    m_itree.Build();
+#endif
 
     // Look for cycles in times expansion (span.id==0)
     for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
@@ -821,10 +1082,7 @@ Optimizer::Impl::Step1e()
         Span* span = *spani;
         if (span->m_id > 0)
             continue;
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::CheckCycle, this, _1,
-                                    TR1::ref(*span)));
+        EnumerateTerms(span->m_bc.getIndex(), CheckCycleFunc(*this, *span));
     }
 }
 
@@ -873,11 +1131,13 @@ Optimizer::Impl::Step2()
             // error
             continue;
         }
-        else if (still_depend)
+        RecordHint(*span, span->m_new_val);
+
+        if (still_depend)
         {
             // another threshold, keep active
-            for (Span::Terms::iterator term=span->m_span_terms.begin(),
-                 endterm=span->m_span_terms.end(); term != endterm; ++term)
+            for (Span::Term* term=span->terms_begin(),
+                 *endterm=span->terms_end(); term != endterm; ++term)
                 term->m_cur_val = term->m_new_val;
             DEBUG(llvm::errs() << "updated " << span->getName()
                   << " curval from " << span->m_cur_val << " to "
@@ -890,15 +1150,14 @@ Optimizer::Impl::Step2()
         long len_diff = span->m_bc.getTotalLen() - orig_len;
         if (len_diff == 0)
             continue;   // didn't increase in size
+        span->m_bc.getContainer()->InvalidateOffsets(span->m_bc);
 
         DEBUG(llvm::errs() << "BC@" << &span->m_bc << " ("
               << span->m_bc.getIndex() << ") expansion by "
               << len_diff << ":\n");
         // Iterate over all spans dependent across the bc just expanded
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::ExpandTerm, this, _1,
-                                    len_diff));
+        EnumerateTerms(span->m_bc.getIndex(),
+                       ExpandTermFunc(*this, len_diff));
 
         // Iterate over offset-setters that follow the bc just expanded.
         // Stop iteration if:
@@ -934,13 +1193,12 @@ Optimizer::Impl::Step2()
             len_diff = os->m_bc->getTailLen() - orig_len;
             if (len_diff != 0)
             {
+                os->m_bc->getContainer()->InvalidateOffsets(*os->m_bc);
                 DEBUG(llvm::errs() << "BC@" << os->m_bc << " ("
                       << os->m_bc->getIndex() << ") offset setter change by "
                       << len_diff << ":\n");
-                m_itree.Enumerate(static_cast<long>(os->m_bc->getIndex()),
-                                  static_cast<long>(os->m_bc->getIndex()),
-                                  TR1::bind(&Optimizer::Impl::ExpandTerm, this,
-                                            _1, len_diff));
+                EnumerateTerms(os->m_bc->getIndex(),
+                               ExpandTermFunc(*this, len_diff));
             }
 
             os->m_cur_val = os->m_new_val;
@@ -982,6 +1240,36 @@ Optimizer::Step2()
     m_impl->Step2();
 }
 
+bool
+Optimizer::hasExternalTerms() const
+{
+    return m_impl->m_external_terms;
+}
+
+void
+Optimizer::Absorb(Optimizer& oth)
+{
+    m_impl->Absorb(*oth.m_impl);
+}
+
+void
+Optimizer::setHints(SpanHints* hints)
+{
+    m_impl->m_hints = hints;
+}
+
+void
+Optimizer::SaveHints()
+{
+    if (!m_impl->m_hints)
+        return;
+    for (std::vector<SpanHints::Hint>::const_iterator
+         i=m_impl->m_hint_log.begin(), end=m_impl->m_hint_log.end();
+         i != end; ++i)
+        m_impl->m_hints->Add(*i);
+    m_impl->m_hint_log.clear();
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 Optimizer::Write(pugi::xml_node out) const
@@ -35,11 +35,27 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/ScanBlocks.h"
 
 
 using namespace yasm;
 
 unsigned char Lexer::s_char_info[256];
+const bool Lexer::s_char_info_init = Lexer::InitCharacterInfo();
+
+bool
+Lexer::InitCharacterInfo()
+{
+    // Initialize the character info table.
+    s_char_info[(int)' '] = s_char_info[(int)'\t'] =
+    s_char_info[(int)'\f'] = s_char_info[(int)'\v'] = CHAR_HORZ_WS;
+    s_char_info[(int)'\n'] = s_char_info[(int)'\r'] = CHAR_VERT_WS;
+    for (unsigned i = 'a'; i <= 'z'; ++i)
+        s_char_info[i] = s_char_info[i+'A'-'a'] = CHAR_LETTER;
+    for (unsigned i = '0'; i <= '9'; ++i)
+        s_char_info[i] = CHAR_NUMBER;
+    return true;
+}
 
 void
 Lexer::InitLexer(const char* start, const char* ptr, const char* end)
@@ -63,6 +79,9 @@ Lexer::InitLexer(const char* start, const char* ptr, const char* end)
     // expansion).  It is used to quickly lex the tokens of the buffer, e.g.
     // when handling a "%if 0" block or otherwise skipping over tokens.
     m_lexing_raw_mode = false;
+
+    // Only include files entered by the preprocessor are recorded.
+    m_recorded_tokens = 0;
 }
 
 Lexer::Lexer(FileID fid,
@@ -102,6 +121,7 @@ Lexer::Lexer(FileID fid,
 
 Lexer::~Lexer()
 {
+    delete m_recorded_tokens;
 }
 
 #if 0
@@ -146,8 +166,11 @@ Lexer::getSourceLocation(const char* loc, unsigned int tok_len) const
 }
 
 DiagnosticBuilder
-Lexer::Diag(const char* loc, unsigned diag_id) const
+Lexer::Diag(const char* loc, unsigned diag_id)
 {
+    // A replay of this file would not issue the diagnostic again.
+    delete m_recorded_tokens;
+    m_recorded_tokens = 0;
     return m_preproc->Diag(getSourceLocation(loc), diag_id);
 }
 
@@ -294,7 +317,13 @@ Lexer::SkipWhitespace(Token* result, const char* cur_ptr)
     unsigned char ch = *cur_ptr;  // Skip consequtive spaces efficiently.
     for (;;)
     {
-        // Skip horizontal whitespace very aggressively.
+        // Skip horizontal whitespace very aggressively.  Runs longer than
+        // a single character (e.g. column alignment) are skipped in blocks.
+        if (isHorizontalWhitespace(ch) && isHorizontalWhitespace(cur_ptr[1]))
+        {
+            cur_ptr = SkipHorizontalWhitespaceBlocks(cur_ptr, m_buf_end);
+            ch = *cur_ptr;
+        }
         while (isHorizontalWhitespace(ch))
             ch = *++cur_ptr;
     
@@ -349,12 +378,9 @@ Lexer::SkipLineComment(Token* result, const char* cur_ptr)
     // loop.
     char ch;
     do {
+        // Skip over characters in the fast loops.
+        cur_ptr = SkipLineCommentBlocks(cur_ptr, m_buf_end);
         ch = *cur_ptr;
-        // FIXME: Speedup BCPL comment lexing.  Just scan for a \n or \r
-        // character.  If we find a \n character, scan backwards, checking
-        // to see if it's an escaped newline, like we do for block comments.
-
-        // Skip over characters in the fast loop.
         while (ch != 0 &&                   // Potentially EOF.
                ch != '\\' &&                // Potentially escaped newline.
                ch != '\n' && ch != '\r')    // Newline or DOS-style newline.
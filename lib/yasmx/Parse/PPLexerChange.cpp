@@ -11,12 +11,18 @@
 // current lexer stack.
 //
 //===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "Preprocessor"
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/HeaderSearch.h"
 #include "yasmx/Parse/Preprocessor.h"
 
+STATISTIC(num_include_replays, "Number of include files replayed");
+STATISTIC(num_include_recorded, "Number of include files recorded");
+
 using namespace yasm;
 
 bool
@@ -55,7 +61,8 @@ Preprocessor::EnterSourceFile(FileID FID,
                               const DirectoryLookup* CurDir,
                               SourceLocation Loc)
 {
-    assert(m_cur_token_lexer == 0 && "Cannot #include a file inside a macro!");
+    // Files may be entered from within a token stream (e.g. an include in a
+    // repeated block); the token lexer is stacked just like a file lexer.
     ++m_NumEnteredSourceFiles;
 
     if (m_MaxIncludeStackDepth < m_include_macro_stack.size())
@@ -75,6 +82,51 @@ Preprocessor::EnterSourceFile(FileID FID,
     EnterSourceFileWithLexer(CreateLexer(FID, InputFile), CurDir);
 }
 
+void
+Preprocessor::EnterIncludeFile(FileID FID,
+                               const DirectoryLookup* CurDir,
+                               SourceLocation Loc)
+{
+    const FileEntry* File = m_source_mgr.getFileEntryForID(FID);
+    if (File == 0)
+    {
+        EnterSourceFile(FID, CurDir, Loc);
+        return;
+    }
+
+    llvm::DenseMap<const FileEntry*, RecordedFile>::const_iterator i =
+        m_recorded_files.find(File);
+    if (i == m_recorded_files.end() || i->second.tokens == 0)
+    {
+        EnterSourceFile(FID, CurDir, Loc);
+
+        // Record the tokens as they are lexed, unless the file could not be
+        // entered.
+        if (File->getSize() <= MaxRecordedFileSize && m_cur_lexer &&
+            m_cur_lexer->m_fid == FID)
+            m_cur_lexer->m_recorded_tokens = new std::vector<Token>;
+        return;
+    }
+
+    ++num_include_replays;
+    ++m_NumEnteredSourceFiles;
+
+    // Move the recorded tokens into the new FileID.  File locations are
+    // offsets, so this is a fixed adjustment to every token.
+    const std::vector<Token>& Recorded = *i->second.tokens;
+    unsigned int NumToks = Recorded.size();
+    SourceLocation FileLoc = m_source_mgr.getLocForStartOfFile(FID);
+    unsigned int RecordedStart = i->second.file_loc.getRawEncoding();
+    Token* Toks = new Token[NumToks];
+    for (unsigned int j = 0; j != NumToks; ++j)
+    {
+        Toks[j] = Recorded[j];
+        Toks[j].setLocation(FileLoc.getLocWithOffset(
+            Recorded[j].getLocation().getRawEncoding() - RecordedStart));
+    }
+    EnterTokenStream(Toks, NumToks, false, true);
+}
+
 void Preprocessor::EnterSourceFileWithLexer(Lexer* lexer,
                                             const DirectoryLookup* cur_dir)
 {
@@ -101,7 +153,8 @@ void
 Preprocessor::EnterTokenStream(const Token* toks,
                                unsigned int num_toks,
                                bool disable_macro_expansion,
-                               bool owns_tokens)
+                               bool owns_tokens,
+                               unsigned long repeat)
 {
     // Save our current state.
     PushIncludeMacroStack();
@@ -112,13 +165,13 @@ Preprocessor::EnterTokenStream(const Token* toks,
     {
         m_cur_token_lexer.reset(new TokenLexer(toks, num_toks,
                                                disable_macro_expansion,
-                                               owns_tokens, *this));
+                                               owns_tokens, *this, repeat));
     }
     else
     {
         m_cur_token_lexer.reset(m_token_lexer_cache[--m_num_cached_token_lexers]);
         m_cur_token_lexer->Init(toks, num_toks, disable_macro_expansion,
-                                owns_tokens);
+                                owns_tokens, repeat);
     }
 }
 
@@ -135,6 +188,20 @@ Preprocessor::HandleEndOfFile(Token* Result, bool isEndOfMacro)
     // lexing the #includer file.
     if (!m_include_macro_stack.empty())
     {
+        // Keep the tokens of a recorded file for later inclusions.
+        if (m_cur_lexer && m_cur_lexer->m_recorded_tokens)
+        {
+            RecordedFile& Rec = m_recorded_files[
+                m_source_mgr.getFileEntryForID(m_cur_lexer->m_fid)];
+            if (Rec.tokens == 0)
+            {
+                ++num_include_recorded;
+                Rec.file_loc = m_cur_lexer->m_file_loc;
+                Rec.tokens = m_cur_lexer->m_recorded_tokens;
+                m_cur_lexer->m_recorded_tokens = 0;
+            }
+        }
+
         // We're done with the #included file.
         RemoveTopOfLexerStack();
 
@@ -153,6 +220,21 @@ Preprocessor::HandleEndOfFile(Token* Result, bool isEndOfMacro)
         return false;
     }
 
+    // If the main source is being produced incrementally, continue lexing
+    // with the next piece of it.
+    if (m_cur_lexer)
+    {
+        FileID next = FetchNextMainBuffer();
+        if (!next.isInvalid())
+        {
+            m_cur_lexer.reset();
+            EnterSourceFile(next, 0, SourceLocation());
+
+            // Client should lex another token.
+            return false;
+        }
+    }
+
     // If the file ends with a newline, form the EOF token on the newline itself,
     // rather than "on the line following it", which doesn't exist.  This makes
     // diagnostics relating to the end of file include the last file that the user
@@ -94,6 +94,11 @@ Preprocessor::~Preprocessor()
     // Free any cached macro expanders.
     for (unsigned i = 0, e = m_num_cached_token_lexers; i != e; ++i)
         delete m_token_lexer_cache[i];
+
+    // Free recorded include files.
+    for (llvm::DenseMap<const FileEntry*, RecordedFile>::iterator i =
+         m_recorded_files.begin(), end = m_recorded_files.end(); i != end; ++i)
+        delete i->second.tokens;
 }
 
 void
@@ -120,6 +125,12 @@ Preprocessor::RegisterBuiltinMacros()
 {
 }
 
+FileID
+Preprocessor::FetchNextMainBuffer()
+{
+    return FileID();
+}
+
 std::string
 Preprocessor::getSpelling(const Token& tok) const
 {
@@ -76,7 +76,8 @@ void TokenLexer::Init(Token &Tok, SourceLocation ILEnd, MacroArgs *Actuals) {
 /// take ownership of the specified token vector.
 void
 TokenLexer::Init(const Token *TokArray, unsigned NumToks,
-                 bool disableMacroExpansion, bool ownsTokens)
+                 bool disableMacroExpansion, bool ownsTokens,
+                 unsigned long Repeat)
 {
     // If the client is reusing a TokenLexer, make sure to free any memory
     // associated with it.
@@ -89,8 +90,9 @@ TokenLexer::Init(const Token *TokArray, unsigned NumToks,
     m_tokens = TokArray;
     m_owns_tokens = ownsTokens;
     m_disable_macro_expansion = disableMacroExpansion;
-    m_num_tokens = NumToks;
+    m_num_tokens = Repeat == 0 ? 0 : NumToks;
     m_cur_token = 0;
+    m_repeat = Repeat;
     m_expand_loc_start = m_expand_loc_end = SourceLocation();
     m_at_start_of_line = false;
     m_has_leading_space = false;
@@ -350,6 +352,26 @@ void TokenLexer::Lex(Token* Tok) {
   // Get the next token to return.
   *Tok = m_tokens[m_cur_token++];
 
+  // If this is the first token, set the lexical properties of the token to
+  // match the lexical properties of the macro identifier.  This is done
+  // before a repeat wrap below resets them for the next pass.
+  if (isFirstToken) {
+    Tok->setFlagValue(Token::StartOfLine , m_at_start_of_line);
+    Tok->setFlagValue(Token::LeadingSpace, m_has_leading_space);
+  }
+
+  // Start the next pass over the tokens if the stream is being repeated.
+  // This keeps isAtEnd() true only at the end of the final pass.  The
+  // expansion point's lexical properties only apply to the very first
+  // token; later passes start with the first token exactly as it was lexed,
+  // so line-start-sensitive directives at the top of the body still work.
+  if (m_cur_token == m_num_tokens && m_repeat > 1) {
+    m_cur_token = 0;
+    --m_repeat;
+    m_at_start_of_line = m_tokens[0].isAtStartOfLine();
+    m_has_leading_space = m_tokens[0].hasLeadingSpace();
+  }
+
   // The token's current location indicate where the token was lexed from.  We
   // need this information to compute the spelling of the token, but any
   // diagnostics for the expanded token should appear as if they came from
@@ -363,13 +385,6 @@ void TokenLexer::Lex(Token* Tok) {
                                            Tok->getLength()));
   }
 
-  // If this is the first token, set the lexical properties of the token to
-  // match the lexical properties of the macro identifier.
-  if (isFirstToken) {
-    Tok->setFlagValue(Token::StartOfLine , m_at_start_of_line);
-    Tok->setFlagValue(Token::LeadingSpace, m_has_leading_space);
-  }
-
   // Otherwise, return a normal token.
 }
 
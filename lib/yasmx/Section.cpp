@@ -27,6 +27,7 @@
 #include "yasmx/Section.h"
 
 #include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Bytecode.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Reloc.h"
 
@@ -59,6 +60,16 @@ Section::AddReloc(std::auto_ptr<Reloc> reloc)
     m_relocs.push_back(reloc.release());
 }
 
+void
+Section::ReserveRelocs()
+{
+    std::size_t n = m_relocs.size();
+    for (bc_iterator i=bytecodes_begin(), end=bytecodes_end();
+         i != end; ++i)
+        n += i->getNumFixups();
+    m_relocs.reserve(n);
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 Section::Write(pugi::xml_node out) const
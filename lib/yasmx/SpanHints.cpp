@@ -0,0 +1,261 @@
+//
+// Span value hints.
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/SpanHints.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Support/MD5.h"
+
+
+using namespace yasm;
+
+// File layout (all integers little endian):
+//   magic[4], version (4 bytes), key[16], count (4 bytes),
+//   count * { section length (4), section name, index (4), id (4),
+//             min_value (8), value (8) }
+static const char hints_magic[4] = {'Y', 'S', 'H', 'T'};
+static const uint64_t hints_version = 2;
+enum
+{
+    HEADER_SIZE = 4+4+16+4,
+    HINT_SIZE = 4+4+4+8+8       // not including the section name
+};
+
+static inline uint64_t
+ReadLE(const unsigned char* p, int size)
+{
+    uint64_t v = 0;
+    for (int i=size-1; i>=0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void
+WriteLE(llvm::raw_ostream& os, uint64_t v, int size)
+{
+    for (int i=0; i<size; ++i, v >>= 8)
+        os << static_cast<unsigned char>(v & 0xff);
+}
+
+SpanHints::SpanHints()
+{
+    std::memset(m_key, 0, sizeof(m_key));
+}
+
+SpanHints::~SpanHints()
+{
+}
+
+void
+SpanHints::setKey(llvm::StringRef options, const SourceManager& smgr)
+{
+    MD5 md5;
+    md5.Update(reinterpret_cast<const unsigned char*>(options.data()),
+               options.size());
+
+    // Every file buffer, in the order they were entered.  Entry 0 is
+    // a placeholder.
+    for (unsigned int i=1, end=smgr.local_sloc_entry_size(); i<end; ++i)
+    {
+        const SrcMgr::SLocEntry& entry = smgr.getLocalSLocEntry(i);
+        if (!entry.isFile())
+            continue;
+        const llvm::MemoryBuffer* buf =
+            entry.getFile().getContentCache()->getRawBuffer();
+        if (!buf)
+            continue;
+        uint64_t bufsize = buf->getBufferSize();
+        unsigned char size[8];
+        for (int j=0; j<8; ++j, bufsize >>= 8)
+            size[j] = static_cast<unsigned char>(bufsize & 0xff);
+        md5.Update(size, 8);
+        md5.Update(reinterpret_cast<const unsigned char*>
+                   (buf->getBufferStart()), buf->getBufferSize());
+    }
+    md5.Final(m_key);
+}
+
+bool
+SpanHints::Read(llvm::StringRef filename)
+{
+    m_old.clear();
+
+    llvm::OwningPtr<llvm::MemoryBuffer> file;
+    if (llvm::MemoryBuffer::getFile(filename, file))
+        return false;
+
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(file->getBufferStart());
+    std::size_t size = file->getBufferSize();
+    if (size < HEADER_SIZE
+        || std::memcmp(p, hints_magic, 4) != 0
+        || ReadLE(p+4, 4) != hints_version
+        || std::memcmp(p+8, m_key, 16) != 0)
+        return false;
+
+    uint64_t count = ReadLE(p+24, 4);
+    if (count > (size - HEADER_SIZE) / HINT_SIZE)
+        return false;
+    const unsigned char* end = p + size;
+    p += HEADER_SIZE;
+
+    m_old.reserve(count);
+    for (uint64_t i=0; i<count; ++i)
+    {
+        if (static_cast<std::size_t>(end-p) < HINT_SIZE)
+            break;
+        uint64_t namelen = ReadLE(p, 4);
+        p += 4;
+        if (static_cast<std::size_t>(end-p) < HINT_SIZE-4 + namelen)
+            break;
+        Hint hint;
+        hint.section.assign(reinterpret_cast<const char*>(p),
+                            static_cast<std::size_t>(namelen));
+        p += namelen;
+        hint.index = static_cast<unsigned long>(ReadLE(p, 4));
+        hint.id = static_cast<int32_t>(ReadLE(p+4, 4));
+        hint.min_value =
+            static_cast<long>(static_cast<int64_t>(ReadLE(p+8, 8)));
+        hint.value = static_cast<long>(static_cast<int64_t>(ReadLE(p+16, 8)));
+        p += HINT_SIZE-4;
+        m_old.push_back(hint);
+    }
+    if (m_old.size() != count || p != end)
+    {
+        m_old.clear();
+        return false;
+    }
+
+    // Written sorted, but don't trust the file.
+    std::sort(m_old.begin(), m_old.end());
+    return true;
+}
+
+bool
+SpanHints::Write(llvm::StringRef filename) const
+{
+    // Keep only the last hint for each span.
+    std::vector<Hint> hints(m_new);
+    std::stable_sort(hints.begin(), hints.end());
+    std::vector<Hint>::iterator out = hints.begin();
+    for (std::vector<Hint>::const_iterator i=hints.begin(), end=hints.end();
+         i != end; ++i)
+    {
+        if (i+1 != end && !(*i < *(i+1)))
+            continue;   // superseded by the next one
+        *out++ = *i;
+    }
+    hints.erase(out, hints.end());
+
+    // Write to a temporary file and rename it into place, so that a
+    // concurrent reader never sees a partial file.
+    std::string tmpname = filename.str() + ".tmp";
+    {
+        std::string err;
+        llvm::raw_fd_ostream os(tmpname.c_str(), err,
+                                llvm::raw_fd_ostream::F_Binary);
+        if (!err.empty())
+            return false;
+
+        os.write(hints_magic, 4);
+        WriteLE(os, hints_version, 4);
+        os.write(reinterpret_cast<const char*>(m_key), 16);
+        WriteLE(os, hints.size(), 4);
+        for (std::vector<Hint>::const_iterator i=hints.begin(),
+             end=hints.end(); i != end; ++i)
+        {
+            WriteLE(os, i->section.size(), 4);
+            os << i->section;
+            WriteLE(os, i->index, 4);
+            WriteLE(os, static_cast<uint32_t>(i->id), 4);
+            WriteLE(os,
+                    static_cast<uint64_t>(static_cast<int64_t>(i->min_value)),
+                    8);
+            WriteLE(os, static_cast<uint64_t>(static_cast<int64_t>(i->value)),
+                    8);
+        }
+        os.close();
+        if (os.has_error())
+        {
+            os.clear_error();
+            std::remove(tmpname.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpname.c_str(), filename.str().c_str()) != 0)
+    {
+        std::remove(tmpname.c_str());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+// Hint lookup key; avoids copying the section name for every lookup.
+struct HintKey
+{
+    llvm::StringRef section;
+    unsigned long index;
+    int id;
+};
+
+struct HintKeyLess
+{
+    bool operator() (const SpanHints::Hint& hint, const HintKey& key) const
+    {
+        int cmp = llvm::StringRef(hint.section).compare(key.section);
+        return cmp < 0 || (cmp == 0 && (hint.index < key.index ||
+                           (hint.index == key.index && hint.id < key.id)));
+    }
+};
+} // anonymous namespace
+
+bool
+SpanHints::Lookup(llvm::StringRef section,
+                  unsigned long index,
+                  int id,
+                  long min_value,
+                  long* value) const
+{
+    HintKey key = {section, index, id};
+    std::vector<Hint>::const_iterator i =
+        std::lower_bound(m_old.begin(), m_old.end(), key, HintKeyLess());
+    if (i == m_old.end() || i->section != section || i->index != index
+        || i->id != id || i->min_value != min_value)
+        return false;
+    *value = i->value;
+    return true;
+}
@@ -0,0 +1,175 @@
+//
+// Bump allocation arena implementation
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/Arena.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "yasmx/Config/threads.h"
+
+
+using namespace yasm;
+
+// Each allocation is preceded by a header recording its arena (NULL for
+// the heap), or while it is on a free list, the next free block.
+// Allocations are kept aligned to the header size, which is enough for the
+// pointers, integers, and doubles that bytecodes hold.
+union Arena::Header
+{
+    Arena* arena;
+    Header* next;
+    double align_d;
+    long long align_ll;
+};
+
+struct Arena::Chunk
+{
+    Chunk* next;
+    Header align;
+};
+
+// Size of a normal chunk; larger requests get their own chunk.
+static const std::size_t CHUNK_SIZE = 64*1024;
+
+static YASM_THREAD_LOCAL Arena* current_arena = 0;
+
+Arena::Arena()
+    : m_chunks(0)
+    , m_cur(0)
+    , m_end(0)
+{
+    for (int i=0; i<NUM_FREE_LISTS; ++i)
+        m_free[i] = 0;
+}
+
+Arena::~Arena()
+{
+    while (m_chunks)
+    {
+        Chunk* next = m_chunks->next;
+        std::free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+void*
+Arena::AllocateChunk(std::size_t size)
+{
+    std::size_t chunk_size = size > CHUNK_SIZE/4 ? size : CHUNK_SIZE;
+    Chunk* chunk =
+        static_cast<Chunk*>(std::malloc(sizeof(Chunk) + chunk_size));
+    if (!chunk)
+        throw std::bad_alloc();
+    char* mem = reinterpret_cast<char*>(chunk + 1);
+
+    if (chunk_size != CHUNK_SIZE && m_chunks)
+    {
+        // Dedicated chunk; keep allocating from the current one.
+        chunk->next = m_chunks->next;
+        m_chunks->next = chunk;
+        return mem;
+    }
+
+    chunk->next = m_chunks;
+    m_chunks = chunk;
+    m_cur = mem + size;
+    m_end = mem + chunk_size;
+    return mem;
+}
+
+// Total size of an allocation, including its header.
+static inline std::size_t
+AllocSize(std::size_t size, std::size_t header_size)
+{
+    return header_size + (size + header_size - 1) / header_size * header_size;
+}
+
+void*
+Arena::Allocate(std::size_t size)
+{
+    std::size_t total = AllocSize(size, sizeof(Header));
+
+    Arena* arena = current_arena;
+    Header* header;
+    if (!arena)
+    {
+        header = static_cast<Header*>(::operator new(total));
+        header->arena = 0;
+        return header + 1;
+    }
+
+    std::size_t list = total / sizeof(Header) - 2;
+    if (list < NUM_FREE_LISTS && arena->m_free[list])
+    {
+        header = arena->m_free[list];
+        arena->m_free[list] = header->next;
+    }
+    else if (static_cast<std::size_t>(arena->m_end - arena->m_cur) >= total)
+    {
+        header = reinterpret_cast<Header*>(arena->m_cur);
+        arena->m_cur += total;
+    }
+    else
+        header = static_cast<Header*>(arena->AllocateChunk(total));
+    header->arena = arena;
+    return header + 1;
+}
+
+void
+Arena::Deallocate(void* p, std::size_t size)
+{
+    if (!p)
+        return;
+    Header* header = static_cast<Header*>(p) - 1;
+    Arena* arena = header->arena;
+    if (!arena)
+    {
+        ::operator delete(header);
+        return;
+    }
+
+    // Only the thread the arena is current on may touch its free lists;
+    // anything else is released with the arena.
+    if (arena != current_arena)
+        return;
+    std::size_t list = AllocSize(size, sizeof(Header)) / sizeof(Header) - 2;
+    if (list >= NUM_FREE_LISTS)
+        return;
+    header->next = arena->m_free[list];
+    arena->m_free[list] = header;
+}
+
+Arena::Scope::Scope(Arena* arena)
+    : m_prev(current_arena)
+{
+    current_arena = arena;
+}
+
+Arena::Scope::~Scope()
+{
+    current_arena = m_prev;
+}
@@ -0,0 +1,99 @@
+//
+// Per-thread object storage
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/ThreadLocal.h"
+
+#include <cassert>
+
+#include "yasmx/Config/threads.h"
+
+#ifdef YASM_ENABLE_THREADS
+#include <pthread.h>
+#endif
+
+
+using namespace yasm;
+
+#ifdef YASM_ENABLE_THREADS
+static inline pthread_key_t*
+getKey(void*& data)
+{
+    return static_cast<pthread_key_t*>(data);
+}
+
+ThreadLocalBase::ThreadLocalBase(Destructor dtor)
+    : m_dtor(dtor)
+    , m_data(new pthread_key_t)
+{
+    int errorcode = pthread_key_create(getKey(m_data), dtor);
+    assert(errorcode == 0 && "could not create thread-local key");
+    (void) errorcode;
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    if (void* p = getInstance())
+        m_dtor(p);
+    pthread_key_delete(*getKey(m_data));
+    delete getKey(m_data);
+}
+
+void*
+ThreadLocalBase::getInstance() const
+{
+    return pthread_getspecific(*static_cast<pthread_key_t*>(m_data));
+}
+
+void
+ThreadLocalBase::setInstance(void* p)
+{
+    pthread_setspecific(*getKey(m_data), p);
+}
+#else
+ThreadLocalBase::ThreadLocalBase(Destructor dtor)
+    : m_dtor(dtor)
+    , m_data(0)
+{
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    if (m_data)
+        m_dtor(m_data);
+}
+
+void*
+ThreadLocalBase::getInstance() const
+{
+    return m_data;
+}
+
+void
+ThreadLocalBase::setInstance(void* p)
+{
+    m_data = p;
+}
+#endif
@@ -0,0 +1,199 @@
+//
+// Thread pool implementation
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/ThreadPool.h"
+
+#include <deque>
+#include <vector>
+
+#include "llvm/Support/Threading.h"
+#include "yasmx/Config/threads.h"
+
+#ifdef YASM_ENABLE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+using namespace yasm;
+
+struct ThreadPool::Impl
+{
+    std::deque<Task> tasks;
+#ifdef YASM_ENABLE_THREADS
+    std::vector<pthread_t> threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;   // signalled when a task is queued
+    pthread_cond_t done_cond;   // signalled when the pool becomes idle
+    unsigned int active;        // number of tasks currently running
+    bool shutdown;
+
+    static void* WorkerMain(void* impl);
+    void Work();
+#endif
+};
+
+#ifdef YASM_ENABLE_THREADS
+void*
+ThreadPool::Impl::WorkerMain(void* impl)
+{
+    static_cast<Impl*>(impl)->Work();
+    return 0;
+}
+
+void
+ThreadPool::Impl::Work()
+{
+    pthread_mutex_lock(&mutex);
+    for (;;)
+    {
+        while (tasks.empty() && !shutdown)
+            pthread_cond_wait(&work_cond, &mutex);
+        if (tasks.empty())
+            break;
+
+        Task task;
+        task.swap(tasks.front());
+        tasks.pop_front();
+        ++active;
+        pthread_mutex_unlock(&mutex);
+
+        task();
+
+        pthread_mutex_lock(&mutex);
+        --active;
+        if (active == 0 && tasks.empty())
+            pthread_cond_broadcast(&done_cond);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+#endif
+
+ThreadPool::ThreadPool(unsigned int nthreads)
+    : m_impl(new Impl)
+{
+#ifdef YASM_ENABLE_THREADS
+    pthread_mutex_init(&m_impl->mutex, 0);
+    pthread_cond_init(&m_impl->work_cond, 0);
+    pthread_cond_init(&m_impl->done_cond, 0);
+    m_impl->active = 0;
+    m_impl->shutdown = false;
+
+    // The LLVM support library locks (statistics, timers, managed statics)
+    // only take effect once it is told that threads are in use.
+    if (nthreads > 0 && !llvm::llvm_is_multithreaded())
+        llvm::llvm_start_multithreaded();
+
+    m_impl->threads.reserve(nthreads);
+    for (unsigned int i=0; i<nthreads; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, &Impl::WorkerMain, m_impl) != 0)
+            break;  // run with what we have (possibly none)
+        m_impl->threads.push_back(thread);
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+    Wait();
+#ifdef YASM_ENABLE_THREADS
+    pthread_mutex_lock(&m_impl->mutex);
+    m_impl->shutdown = true;
+    pthread_cond_broadcast(&m_impl->work_cond);
+    pthread_mutex_unlock(&m_impl->mutex);
+
+    for (std::vector<pthread_t>::iterator i = m_impl->threads.begin(),
+         end = m_impl->threads.end(); i != end; ++i)
+        pthread_join(*i, 0);
+
+    pthread_cond_destroy(&m_impl->done_cond);
+    pthread_cond_destroy(&m_impl->work_cond);
+    pthread_mutex_destroy(&m_impl->mutex);
+#endif
+    delete m_impl;
+}
+
+unsigned int
+ThreadPool::getNumThreads() const
+{
+#ifdef YASM_ENABLE_THREADS
+    return m_impl->threads.size();
+#else
+    return 0;
+#endif
+}
+
+void
+ThreadPool::Async(const Task& task)
+{
+#ifdef YASM_ENABLE_THREADS
+    if (!m_impl->threads.empty())
+    {
+        pthread_mutex_lock(&m_impl->mutex);
+        m_impl->tasks.push_back(task);
+        pthread_cond_signal(&m_impl->work_cond);
+        pthread_mutex_unlock(&m_impl->mutex);
+        return;
+    }
+#endif
+    m_impl->tasks.push_back(task);
+}
+
+void
+ThreadPool::Wait()
+{
+#ifdef YASM_ENABLE_THREADS
+    if (!m_impl->threads.empty())
+    {
+        pthread_mutex_lock(&m_impl->mutex);
+        while (m_impl->active != 0 || !m_impl->tasks.empty())
+            pthread_cond_wait(&m_impl->done_cond, &m_impl->mutex);
+        pthread_mutex_unlock(&m_impl->mutex);
+        return;
+    }
+#endif
+    // No worker threads; run the queue on the calling thread.
+    while (!m_impl->tasks.empty())
+    {
+        Task task;
+        task.swap(m_impl->tasks.front());
+        m_impl->tasks.pop_front();
+        task();
+    }
+}
+
+unsigned int
+ThreadPool::getHardwareConcurrency()
+{
+#if defined(YASM_ENABLE_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return static_cast<unsigned int>(n);
+#endif
+    return 1;
+}
@@ -261,10 +261,12 @@ Value::operator= (const Value& rhs)
 {
     if (this != &rhs)
     {
-        if (rhs.m_abs)
-            m_abs.reset(rhs.m_abs->clone());
-        else
+        if (!rhs.m_abs)
             m_abs.reset(0);
+        else if (m_abs.get() != 0)
+            *m_abs = *rhs.m_abs;    // reuse the existing expression
+        else
+            m_abs.reset(rhs.m_abs->clone());
         m_rel = rhs.m_rel;
         m_wrt = rhs.m_wrt;
         m_sub = rhs.m_sub;
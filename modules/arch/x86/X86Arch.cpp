@@ -53,6 +53,8 @@ X86Arch::X86Arch(const ArchModule& module)
       m_mode_bits(0),
       m_force_strict(false),
       m_default_rel(false),
+      m_match_index(true),
+      m_encoding_cache(true),
       m_nop(NOP_BASIC)
 {
     // default to all instructions/features enabled
@@ -136,11 +138,38 @@ X86Arch::setVar(StringRef var, unsigned long val)
                "default_rel requires bits=64");
         m_default_rel = (val != 0);
     }
+    else if (var.equals_lower("match_index"))
+        m_match_index = (val != 0);
+    else if (var.equals_lower("encoding_cache"))
+        m_encoding_cache = (val != 0);
     else
         return false;
     return true;
 }
 
+const Bytes*
+X86Arch::getCachedEncoding(StringRef key, const CpuMask& active_cpu) const
+{
+    if (!m_encoding_cache)
+        return 0;
+    llvm::StringMap<CachedEncoding>::const_iterator i = m_encodings.find(key);
+    if (i == m_encodings.end() || i->second.active_cpu != active_cpu)
+        return 0;
+    return &i->second.encoding;
+}
+
+void
+X86Arch::setCachedEncoding(StringRef key,
+                           const CpuMask& active_cpu,
+                           const Bytes& encoding) const
+{
+    if (!m_encoding_cache)
+        return;
+    CachedEncoding& cached = m_encodings[key];
+    cached.active_cpu = active_cpu;
+    cached.encoding = encoding;
+}
+
 void
 X86Arch::DirCpu(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
@@ -28,8 +28,10 @@
 //
 #include <bitset>
 
+#include "llvm/ADT/StringMap.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Arch.h"
+#include "yasmx/Bytes.h"
 
 #include "X86Register.h"
 #include "X86TargetModifier.h"
@@ -197,6 +199,29 @@ public:
 
     unsigned int getModeBits() const { return m_mode_bits; }
 
+    /// Determine if encodings of instructions with only register operands
+    /// are cached.
+    /// @return True if the encoding cache is enabled.
+    bool hasEncodingCache() const { return m_encoding_cache; }
+
+    /// Get the cached encoding of an instruction with only register
+    /// operands.
+    /// @param key          instruction key (see X86Insn::getEncodingKey())
+    /// @param active_cpu   CPU features enabled when the instruction was
+    ///                     parsed
+    /// @return Encoding, or NULL if not cached (or caching is disabled).
+    const Bytes* getCachedEncoding(StringRef key,
+                                   const CpuMask& active_cpu) const;
+
+    /// Cache the encoding of an instruction with only register operands.
+    /// @param key          instruction key (see X86Insn::getEncodingKey())
+    /// @param active_cpu   CPU features enabled when the instruction was
+    ///                     parsed
+    /// @param encoding     complete instruction encoding
+    void setCachedEncoding(StringRef key,
+                           const CpuMask& active_cpu,
+                           const Bytes& encoding) const;
+
     static const char* getName()
     { return "x86 (IA-32 and derivatives), AMD64"; }
     static const char* getKeyword() { return "x86"; }
@@ -224,7 +249,18 @@ private:
     unsigned int m_mode_bits;
     bool m_force_strict;
     bool m_default_rel;
+    bool m_match_index;
+    bool m_encoding_cache;
     NopFormat m_nop;
+
+    // Encodings of instructions with only register operands, keyed by
+    // X86Insn::getEncodingKey().  Populated as instructions are appended.
+    struct CachedEncoding
+    {
+        CpuMask active_cpu;
+        Bytes encoding;
+    };
+    mutable llvm::StringMap<CachedEncoding> m_encodings;
 };
 
 }} // namespace yasm::arch
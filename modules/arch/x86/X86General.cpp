@@ -426,6 +426,16 @@ GeneralToBytes(Bytes& bytes,
     opcode.ToBytes(bytes);
 }
 
+// A register effective address needs only a Mod/RM byte, so it never
+// changes after parsing.
+static bool
+isRegisterEA(const X86EffAddr& ea)
+{
+    return ea.m_need_modrm && ea.m_valid_modrm && (ea.m_modrm & 0xC0) == 0xC0
+        && !ea.m_need_sib && !ea.m_need_disp && !ea.m_need_nonzero_len
+        && !ea.m_disp.hasAbs() && ea.m_segreg == 0;
+}
+
 bool
 X86General::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
@@ -565,22 +575,31 @@ arch::AppendGeneral(BytecodeContainer& container,
                     unsigned char rex,
                     X86GeneralPostOp postop,
                     bool default_rel,
-                    SourceLocation source)
+                    SourceLocation source,
+                    Bytes* encoding)
 {
     Bytecode& bc = container.FreshBytecode();
     ++num_generic;
 
-    // if no postop and no effective address, output the fixed contents
-    if (postop == X86_POSTOP_NONE && ea.get() == 0)
+    // if no postop and no effective address, output the fixed contents;
+    // when the encoding is being cached, a register effective address is
+    // also fixed
+    if (postop == X86_POSTOP_NONE &&
+        (ea.get() == 0 || (encoding && isRegisterEA(*ea))))
     {
         Bytes& bytes = bc.getFixed();
         unsigned long orig_size = bytes.size();
         GeneralToBytes(bytes, common, opcode, ea.get(), special_prefix, rex);
+        if (ea.get() != 0)
+            Write8(bytes, ea->m_modrm);
         if (imm.get() != 0)
         {
             imm->setInsnStart(bytes.size()-orig_size);
             bc.AppendFixed(imm);
         }
+        else if (encoding)
+            encoding->insert(encoding->end(), bytes.begin()+orig_size,
+                             bytes.end());
         return;
     }
 
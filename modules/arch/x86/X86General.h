@@ -134,6 +134,12 @@ private:
     X86GeneralPostOp m_postop;
 };
 
+/// Append a general instruction.  Instructions with no postop and no
+/// effective address are appended as fixed bytes.
+/// @param encoding     if not NULL, instructions with a register effective
+///                     address are also appended as fixed bytes, and if
+///                     the instruction is appended as only fixed bytes (no
+///                     immediate), these are also copied here
 YASM_STD_EXPORT
 void AppendGeneral(BytecodeContainer& container,
                    const X86Common& common,
@@ -144,7 +150,8 @@ void AppendGeneral(BytecodeContainer& container,
                    unsigned char rex,
                    X86GeneralPostOp postop,
                    bool default_rel,
-                   SourceLocation source);
+                   SourceLocation source,
+                   Bytes* encoding = 0);
 
 }} // namespace yasm::arch
 
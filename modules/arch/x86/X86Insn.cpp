@@ -33,12 +33,15 @@
 #include <cstring>
 #include <string>
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
 #include "yasmx/Support/phash.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/BytecodeContainer.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
@@ -213,6 +216,22 @@ enum X86OperandAction
     OPA_VEXImm = 16
 };
 
+// Classes of instruction operands, used to key the dispatch index.
+// Must be kept in sync with operand_classes in gen_x86_insn.py.
+enum X86OperandClass
+{
+    OPC_Imm = 0,        // immediate
+    OPC_Mem = 1,        // memory
+    OPC_SegReg = 2,     // segment register
+    OPC_Reg = 3,        // general purpose or FPU register
+    OPC_SIMDReg = 4,    // MMX, XMM, or YMM register
+    OPC_CRReg = 5,      // CR register
+    OPC_DRReg = 6,      // DR register
+    OPC_TRReg = 7,      // TR register
+    OPC_OtherReg = 8,   // any other register
+    OPC_Count = 9
+};
+
 enum X86OperandPostAction
 {
     OPAP_None = 0,
@@ -376,6 +395,23 @@ struct X86InsnInfo
     // operand, see above
     unsigned int operands_index:12;
 };
+
+// Dispatch index entry: the forms of a group which can match instructions
+// with a given key (see X86Insn::FindMatch()), in group order.
+struct X86InsnIndexEntry
+{
+    unsigned short key;
+    unsigned short first;   // index of first candidate in insn_candidates
+    unsigned char num;      // number of candidates
+};
+
+// Dispatch index for an instruction group.  Only generated for groups with
+// many forms; entries are sorted by key.
+struct X86InsnIndex
+{
+    const X86InsnIndexEntry* entries;
+    unsigned int num_entries;
+};
 }} // namespace yasm::arch
 
 inline
@@ -1025,9 +1061,84 @@ X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
 #endif
 }
 
+static X86OperandClass
+ClassifyOperand(const Operand& op)
+{
+    switch (op.getType())
+    {
+        case Operand::IMM:
+            return OPC_Imm;
+        case Operand::MEMORY:
+            return OPC_Mem;
+        case Operand::SEGREG:
+            return OPC_SegReg;
+        default:
+            break;
+    }
+
+    const X86Register* reg = static_cast<const X86Register*>(op.getReg());
+    if (!reg)
+        return OPC_OtherReg;
+    switch (reg->getType())
+    {
+        case X86Register::REG8:
+        case X86Register::REG8X:
+        case X86Register::REG16:
+        case X86Register::REG32:
+        case X86Register::REG64:
+        case X86Register::FPUREG:
+            return OPC_Reg;
+        case X86Register::MMXREG:
+        case X86Register::XMMREG:
+        case X86Register::YMMREG:
+            return OPC_SIMDReg;
+        case X86Register::CRREG:
+            return OPC_CRReg;
+        case X86Register::DRREG:
+            return OPC_DRReg;
+        case X86Register::TRREG:
+            return OPC_TRReg;
+        default:
+            return OPC_OtherReg;
+    }
+}
+
+static bool
+IndexEntryKeyLess(const X86InsnIndexEntry& entry, unsigned int key)
+{
+    return entry.key < key;
+}
+
 const X86InsnInfo*
 X86Insn::FindMatch(const unsigned int* size_lookup, int bypass) const
 {
+    if (m_index)
+    {
+        // Only check the forms that can match the number of operands,
+        // the class of the first operand (as written), the mode, and the
+        // parser.  Candidates are in group order, so first match wins.
+        unsigned int key = m_operands.size() * OPC_Count;
+        if (!m_operands.empty())
+            key += ClassifyOperand(m_operands.front());
+        key = key*4 + (m_mode_bits == 64 ? 2 : 0) +
+            (m_parser == X86Arch::PARSER_GAS ? 1 : 0);
+
+        const X86InsnIndexEntry* end =
+            &m_index->entries[m_index->num_entries];
+        const X86InsnIndexEntry* entry =
+            std::lower_bound(m_index->entries, end, key, IndexEntryKeyLess);
+        if (entry == end || entry->key != key)
+            return 0;
+
+        for (const unsigned char* cand = &insn_candidates[entry->first],
+             *cand_end = cand + entry->num; cand != cand_end; ++cand)
+        {
+            if (MatchInfo(m_group[*cand], size_lookup, bypass))
+                return &m_group[*cand];
+        }
+        return 0;
+    }
+
     // Just do a simple linear search through the info array for a match.
     // First match wins.
     const X86InsnInfo* info =
@@ -1152,6 +1263,22 @@ X86Insn::DoAppend(BytecodeContainer& container,
         }
     }
 
+    // Instructions with only register operands always encode the same way,
+    // so reuse the encoding of an earlier identical instruction if there is
+    // one.
+    SmallString<64> key;
+    bool cacheable = m_arch.hasEncodingCache() && getEncodingKey(key);
+    if (cacheable)
+    {
+        if (const Bytes* encoding =
+            m_arch.getCachedEncoding(key, m_active_cpu))
+        {
+            Bytes& fixed = container.FreshBytecode().getFixed();
+            fixed.insert(fixed.end(), encoding->begin(), encoding->end());
+            return true;
+        }
+    }
+
     const X86InsnInfo* info = FindMatch(size_lookup, 0);
 
     if (!info)
@@ -1174,7 +1301,66 @@ X86Insn::DoAppend(BytecodeContainer& container,
         }
     }
 
-    return DoAppendGeneral(container, *info, size_lookup, source, diags);
+    if (!cacheable)
+        return DoAppendGeneral(container, *info, size_lookup, source, diags);
+
+    // Only cache the encoding if no diagnostics were issued, as they
+    // would not be repeated for later instructions.
+    DiagnosticErrorTrap error_trap(diags);
+    unsigned int num_warnings = diags.getNumWarnings();
+    Bytes encoding;
+    if (!DoAppendGeneral(container, *info, size_lookup, source, diags,
+                         &encoding))
+        return false;
+    if (!encoding.empty() && !error_trap.hasErrorOccurred() &&
+        diags.getNumWarnings() == num_warnings)
+        m_arch.setCachedEncoding(key, m_active_cpu, encoding);
+    return true;
+}
+
+static inline void
+AppendKey(SmallVectorImpl<char>& key, unsigned int val)
+{
+    key.push_back(static_cast<char>(val & 0xff));
+    key.push_back(static_cast<char>((val >> 8) & 0xff));
+}
+
+bool
+X86Insn::getEncodingKey(SmallVectorImpl<char>& key) const
+{
+    // Operands (other than registers), prefixes, and segment overrides
+    // make the encoding variable.
+    if (!m_prefixes.empty() || m_segreg != 0)
+        return false;
+    for (Operands::const_iterator op = m_operands.begin(),
+         end = m_operands.end(); op != end; ++op)
+    {
+        if (!op->isType(Operand::REG) || op->getTargetMod() != 0 ||
+            op->getSeg() != 0)
+            return false;
+    }
+
+    // The group is identified by its (static) info table.
+    const char* group = reinterpret_cast<const char*>(&m_group);
+    key.append(group, group+sizeof(m_group));
+    key.append(m_mod_data, m_mod_data+3);
+    AppendKey(key, m_suffix);
+    key.push_back(static_cast<char>(m_misc_flags));
+    key.push_back(static_cast<char>(m_mode_bits));
+    key.push_back(static_cast<char>(m_parser));
+    key.push_back(static_cast<char>(m_force_strict));
+    key.push_back(static_cast<char>(m_default_rel));
+    for (Operands::const_iterator op = m_operands.begin(),
+         end = m_operands.end(); op != end; ++op)
+    {
+        const X86Register* reg = static_cast<const X86Register*>(op->getReg());
+        key.push_back(static_cast<char>(reg->getType()));
+        key.push_back(static_cast<char>(reg->getNum()));
+        AppendKey(key, op->getSize());
+        key.push_back(static_cast<char>(op->isDeref()));
+        key.push_back(static_cast<char>(op->isStrict()));
+    }
+    return true;
 }
 
 namespace {
@@ -1197,7 +1383,8 @@ public:
     void ApplySegReg(const SegmentRegister* segreg, SourceLocation source);
     bool Finish(BytecodeContainer& container,
                 const Insn::Prefixes& prefixes,
-                SourceLocation source);
+                SourceLocation source,
+                Bytes* encoding = 0);
 
 private:
     void ApplyOperand(const X86InfoOperand& info_op, Operand& op);
@@ -1701,7 +1888,8 @@ BuildGeneral::ApplySegReg(const SegmentRegister* segreg, SourceLocation source)
 bool
 BuildGeneral::Finish(BytecodeContainer& container,
                      const Insn::Prefixes& prefixes,
-                     SourceLocation source)
+                     SourceLocation source,
+                     Bytes* encoding)
 {
     std::auto_ptr<Value> imm_val(0);
 
@@ -1808,7 +1996,8 @@ BuildGeneral::Finish(BytecodeContainer& container,
                   m_rex,
                   m_postop,
                   m_default_rel,
-                  source);
+                  source,
+                  encoding);
     return true;
 }
 
@@ -1817,7 +2006,8 @@ X86Insn::DoAppendGeneral(BytecodeContainer& container,
                          const X86InsnInfo& info,
                          const unsigned int* size_lookup,
                          SourceLocation source,
-                         DiagnosticsEngine& diags)
+                         DiagnosticsEngine& diags,
+                         Bytes* encoding)
 {
     BuildGeneral buildgen(info, m_mode_bits, size_lookup, m_force_strict,
                           m_default_rel, diags);
@@ -1827,7 +2017,7 @@ X86Insn::DoAppendGeneral(BytecodeContainer& container,
     buildgen.ApplyOperands(static_cast<X86Arch::ParserSelect>(m_parser),
                            m_operands);
     buildgen.ApplySegReg(m_segreg, m_segreg_source);
-    return buildgen.Finish(container, m_prefixes, source);
+    return buildgen.Finish(container, m_prefixes, source, encoding);
 }
 
 namespace {
@@ -1859,6 +2049,9 @@ struct InsnPrefixParseData
     unsigned int cpu0:6;
     unsigned int cpu1:6;
     unsigned int cpu2:6;
+
+    // For instruction, dispatch index of group (if any).
+    const X86InsnIndex* index;
 };
 
 // Pull in all parse data
@@ -1955,7 +2148,7 @@ X86Arch::ParseCheckInsnPrefix(StringRef id,
     if (id_len > 16)
         return InsnPrefix();
 
-    static char lcaseid[17];
+    char lcaseid[17];
     for (size_t i=0; i<id_len; i++)
         lcaseid[i] = tolower(id[i]);
     lcaseid[id_len] = '\0';
@@ -2017,6 +2210,7 @@ X86Arch::ParseCheckInsnPrefix(StringRef id,
 inline
 X86Insn::X86Insn(const X86Arch& arch,
                  const X86InsnInfo* group,
+                 const X86InsnIndex* index,
                  const X86Arch::CpuMask& active_cpu,
                  unsigned char mod_data0,
                  unsigned char mod_data1,
@@ -2030,6 +2224,7 @@ X86Insn::X86Insn(const X86Arch& arch,
                  bool default_rel)
     : m_arch(arch),
       m_group(group),
+      m_index(index),
       m_active_cpu(active_cpu),
       m_num_info(num_info),
       m_mode_bits(mode_bits),
@@ -2089,6 +2284,7 @@ X86Arch::CreateEmptyInsn() const
     return std::auto_ptr<Insn>(new X86Insn(
         *this,
         empty_insn,
+        0,
         m_active_cpu,
         0,
         0,
@@ -2111,6 +2307,7 @@ X86Arch::CreateInsn(const Arch::InsnInfo* info) const
     return std::auto_ptr<Insn>(new X86Insn(
         *this,
         static_cast<const X86InsnInfo*>(pdata->struc),
+        m_match_index ? pdata->index : 0,
         m_active_cpu,
         pdata->mod_data0,
         pdata->mod_data1,
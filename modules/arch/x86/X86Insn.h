@@ -34,12 +34,14 @@
 namespace yasm
 {
 
+class Bytes;
 class SourceLocation;
 
 namespace arch
 {
 
 struct X86InfoOperand;
+struct X86InsnIndex;
 struct X86InsnInfo;
 class X86Opcode;
 
@@ -48,6 +50,7 @@ class YASM_STD_EXPORT X86Insn : public Insn
 public:
     X86Insn(const X86Arch& arch,
             const X86InsnInfo* group,
+            const X86InsnIndex* index,
             const X86Arch::CpuMask& active_cpu,
             unsigned char mod_data0,
             unsigned char mod_data1,
@@ -90,7 +93,10 @@ private:
                          const X86InsnInfo& info,
                          const unsigned int* size_lookup,
                          SourceLocation source,
-                         DiagnosticsEngine& diags);
+                         DiagnosticsEngine& diags,
+                         Bytes* encoding = 0);
+
+    bool getEncodingKey(SmallVectorImpl<char>& key) const;
 
     const X86InsnInfo* FindMatch(const unsigned int* size_lookup, int bypass)
         const;
@@ -112,6 +118,9 @@ private:
     // instruction parse group - NULL if empty instruction (just prefixes)
     /*@null@*/ const X86InsnInfo* m_group;
 
+    // dispatch index for m_group - NULL if none (search linearly)
+    /*@null@*/ const X86InsnIndex* m_index;
+
     // CPU feature flags enabled at the time of parsing the instruction
     X86Arch::CpuMask m_active_cpu;
 
@@ -487,6 +487,13 @@ class Insn(object):
         # Ensure modifiers is at least 3 long
         mods_str.extend(["0", "0", "0"])
 
+        if is_indexed(self.groupname):
+            index_str = "&%s_index" % self.groupname
+        else:
+            index_str = "0"
+
+        # num_info is an 8-bit field in InsnPrefixParseData
+        assert len(groups[self.groupname]) < 256, self.groupname
         return ",\t".join(["%s_insn" % self.groupname,
                            "%d" % len(groups[self.groupname]),
                            suffix_str,
@@ -496,7 +503,8 @@ class Insn(object):
                            "|".join(self.misc_flags or []) or "0",
                            cpus_str[0],
                            cpus_str[1],
-                           cpus_str[2]])
+                           cpus_str[2],
+                           index_str])
 
 insns = {}
 def add_insn(name, groupname, **kwargs):
@@ -524,6 +532,7 @@ class Prefix(object):
                            self.only64 and "ONLY_64" or "0",
                            "0",
                            "0",
+                           "0",
                            "0"])
 
 gas_insns = {}
@@ -591,6 +600,130 @@ def finalize_insns():
         lprint("warning: unused groups: %s" % ", ".join(unused_groups),
                file=sys.stderr)
 
+# Operand classes used to key the dispatch index; these must be kept in the
+# same order as X86OperandClass in X86Insn.cpp.
+operand_classes = ["Imm", "Mem", "SegReg", "Reg", "SIMDReg", "CRReg",
+                   "DRReg", "TRReg", "OtherReg"]
+reg_classes = ["Reg", "SIMDReg", "CRReg", "DRReg", "TRReg", "OtherReg"]
+
+# Operand classes each operand type can possibly match.
+operand_type_classes = {
+    "Imm": ["Imm"],
+    "Reg": ["Reg"],
+    "Mem": ["Mem"],
+    "RM": ["Reg", "Mem"],
+    "SIMDReg": ["SIMDReg"],
+    "SIMDRM": ["SIMDReg", "Mem"],
+    "SegReg": ["SegReg"],
+    "CRReg": ["CRReg"],
+    "DRReg": ["DRReg"],
+    "TRReg": ["TRReg"],
+    "ST0": ["Reg"],
+    "Areg": reg_classes,    # only the register number is always checked
+    "Creg": reg_classes,
+    "Dreg": reg_classes,
+    "CS": ["SegReg"],
+    "DS": ["SegReg"],
+    "ES": ["SegReg"],
+    "FS": ["SegReg"],
+    "GS": ["SegReg"],
+    "SS": ["SegReg"],
+    "CR4": ["CRReg"],
+    "MemOffs": ["Mem"],
+    "Imm1": ["Imm"],
+    "ImmNotSegOff": ["Imm"],
+    "XMM0": ["SIMDReg"],
+    "MemrAX": ["Mem"],
+    "MemEAX": ["Mem"],
+    "MemDX": ["Mem"],
+    "MemXMMIndex": ["Mem"],
+    "MemYMMIndex": ["Mem"],
+}
+
+# Groups with at least this many forms get a dispatch index.
+index_min_forms = 8
+
+def is_indexed(groupname):
+    return len(groups[groupname]) >= index_min_forms
+
+def index_key(num_operands, opclass, mode64, gas):
+    """Dispatch index key; must match X86Insn::FindMatch()."""
+    return ((num_operands*len(operand_classes) + opclass)*2 + mode64)*2 + gas
+
+def form_matches_key(form, num_operands, opclass, mode64, gas):
+    """Determine if form can possibly match an instruction with the given
+    key.  The operand class is that of the first operand as written, which
+    GAS matches against the last form operand unless not reversed."""
+    if len(form.operands) != num_operands:
+        return False
+    if mode64 and "NOT_64" in form.misc_flags:
+        return False
+    if not mode64 and "ONLY_64" in form.misc_flags:
+        return False
+    if gas and form.gas_illegal:
+        return False
+    if not gas and form.gas_only:
+        return False
+    if num_operands == 0:
+        return True
+    if gas and not form.gas_no_rev:
+        op = form.operands[-1]
+    else:
+        op = form.operands[0]
+    return operand_classes[opclass] in operand_type_classes[op.type]
+
+def output_indexes(f):
+    candidates = []
+    entries = {}
+    for name in sorted(groups):
+        if not is_indexed(name):
+            continue
+        forms = groups[name]
+        group_entries = []
+        for num_operands in sorted(set(len(x.operands) for x in forms)):
+            if num_operands == 0:
+                opclasses = [0]
+            else:
+                opclasses = range(len(operand_classes))
+            for opclass in opclasses:
+                for mode64 in [0, 1]:
+                    for gas in [0, 1]:
+                        matches = [i for i, form in enumerate(forms)
+                                   if form_matches_key(form, num_operands,
+                                                       opclass, mode64, gas)]
+                        if not matches:
+                            continue
+                        # Field widths of insn_candidates[] and
+                        # X86InsnIndexEntry {unsigned short key, first;
+                        # unsigned char num}
+                        assert max(matches) < 256, name
+                        assert len(matches) < 256, name
+                        assert len(candidates) < 65536, name
+                        assert index_key(num_operands, opclass, mode64,
+                                         gas) < 65536, name
+                        group_entries.append((index_key(num_operands,
+                                                        opclass, mode64, gas),
+                                              len(candidates), len(matches)))
+                        candidates.extend(matches)
+        entries[name] = group_entries
+
+    lprint("static const unsigned char insn_candidates[] = {", file=f)
+    for i in range(0, len(candidates), 16):
+        lprint("    " + ", ".join("%d" % x for x in candidates[i:i+16]) + ",",
+               file=f)
+    lprint("};\n", file=f)
+
+    for name in sorted(entries):
+        lprint("static const X86InsnIndexEntry %s_index_entries[] = {" % name,
+               file=f)
+        lprint("   ", end='', file=f)
+        lprint(",\n    ".join("{%d, %d, %d}" % x for x in entries[name]),
+               file=f)
+        lprint("};\n", file=f)
+        lprint("static const X86InsnIndex %s_index = {" % name, file=f)
+        lprint("    %s_index_entries, %d" % (name, len(entries[name])), file=f)
+        lprint("};\n", file=f)
+
 def output_insns(f, parser, insns):
     lprint("// Generated by %s, do not edit" % scriptname, file=f)
     lprint("""%%ignore-case
@@ -648,6 +781,9 @@ def output_groups(f):
         lprint(",\n    ".join(str(x) for x in groups[name]), file=f)
         lprint("};\n", file=f)
 
+    # Output dispatch indexes
+    output_indexes(f)
+
     # Output prefixes
     for name in sorted(prefixes):
         lprint(prefixes[name].code_str(), file=f)
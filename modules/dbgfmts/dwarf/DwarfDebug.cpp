@@ -58,6 +58,9 @@ DwarfDebug::DwarfDebug(const DebugFormatModule& module, Object& object)
         case FORMAT_64BIT: m_sizeof_offset = 8; break;
     }
     InitCfi(*object.getArch());
+
+    // Line information for asm source needs the start of each instruction.
+    object.getOptions().TrackInsnSources = true;
 }
 
 DwarfDebug::~DwarfDebug()
@@ -44,6 +44,7 @@ class BytecodeContainer;
 class DirectiveInfo;
 class FileEntry;
 class Section;
+class SourceLineCursor;
 
 namespace dbgfmt {
 struct DwarfLoc;
@@ -210,12 +211,9 @@ private:
                         DwarfLineState* state,
                         const DwarfLoc& loc,
                         const DwarfLoc* nextloc);
-    void GenerateLineBC(Section& debug_line,
-                        SourceManager& smgr,
-                        DwarfLineState* state,
-                        Bytecode& bc,
-                        DwarfLoc* loc,
-                        unsigned long* lastfile);
+    /// Generate locations for a code section from the asm source of its
+    /// instructions.
+    void GenerateLineLocs(Section& sect, SourceLineCursor& cursor);
     /// Append statement program prologue
     void AppendSPP(BytecodeContainer& container);
 
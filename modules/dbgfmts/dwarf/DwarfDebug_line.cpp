@@ -158,6 +158,7 @@ DwarfDebug::AddFile(const FileEntry* file)
         filenum = m_filenames.size();
         m_filenames.push_back(Filename());
     }
+    m_filenames[filenum].pathname = file->getName();
     m_filenames[filenum].filename = file->getName();
     m_filenames[filenum].dir = dir;
     m_filenames[filenum].time = file->getModificationTime();
@@ -364,46 +365,52 @@ DwarfDebug::GenerateLineOp(Section& debug_line,
     }
     state->prevloc = loc.loc;
 }
-#if 0
 void
-DwarfDebug::GenerateLineBC(Section& debug_line,
-                           SourceManager& smgr,
-                           DwarfLineState* state,
-                           Bytecode& bc,
-                           DwarfLoc* loc,
-                           unsigned long* lastfile)
+DwarfDebug::GenerateLineLocs(Section& sect, SourceLineCursor& cursor)
 {
-    unsigned long i;
-    const char *filename;
-    /*@null@*/ yasm_bytecode *nextbc = yasm_bc__next(bc);
-
-    if (nextbc && bc->offset == nextbc->offset)
-        return 0;
+    if (!sect.isCode() || sect.getAssocData<DwarfSection>())
+        return;
+    DwarfSection* dwarf2sect = new DwarfSection;
+    sect.AddAssocData(std::auto_ptr<DwarfSection>(dwarf2sect));
+
+    // Instructions are in source order, so each lookup is cheap.
+    const char* lastname = 0;
+    unsigned long lastfile = 0;
+    const Section::InsnSources& insns = sect.getInsnSources();
+    for (Section::InsnSources::const_iterator i=insns.begin(),
+         end=insns.end(); i != end; ++i)
+    {
+        // Skip instructions that generated no code.
+        Section::InsnSources::const_iterator next = i+1;
+        if (next != end && next->loc == i->loc)
+            continue;
 
-    info->loc.vline = bc->line;
-    info->loc.bc = bc;
+        const char* filename;
+        unsigned int line;
+        if (!cursor.Lookup(i->source, &filename, &line))
+            continue;
 
-    yasm_linemap_lookup(info->linemap, bc->line, &filename, &info->loc.line);
-    // Find file index; just linear search it unless it was the last used
-    if (*lastfile > 0 && filename == m_filenames[*lastfile-1].pathname)
-        loc->file = *lastfile;
-    else
-    {
-        for (i=0; i<dbgfmt_dwarf2->filenames_size; i++)
+        // Find file index; just linear search it unless it was the last used
+        if (filename != lastname)
         {
-            if (strcmp(filename, dbgfmt_dwarf2->filenames[i].pathname) == 0)
-                break;
+            Filenames::const_iterator f = m_filenames.begin();
+            for (; f != m_filenames.end(); ++f)
+            {
+                if (f->pathname == filename)
+                    break;
+            }
+            if (f != m_filenames.end())
+                lastfile = (f-m_filenames.begin())+1;
+            else
+                lastfile = AddFile(m_filenames.size()+1, filename)+1;
+            lastname = filename;
         }
-        if (i >= dbgfmt_dwarf2->filenames_size)
-            yasm_internal_error(N_("could not find filename in table"));
-        info->loc.file = i+1;
-        info->lastfile = i+1;
-    }
-    if (GenerateLineOp(debug_line, state, loc, NULL))
-        return 1;
-    return 0;
+
+        dwarf2sect->locs.push_back(
+            new DwarfLoc(i->loc, i->source, lastfile, line));
+    }
 }
-#endif
+
 void
 DwarfDebug::GenerateLineSection(Section& sect,
                                 Section& debug_line,
@@ -433,40 +440,22 @@ DwarfDebug::GenerateLineSection(Section& sect,
     state.column = 0;
     state.isa = 0;
     state.is_stmt = DWARF_LINE_DEFAULT_IS_STMT;
-    state.prevloc.bc = NULL;
+    state.prevloc = sect.getBeginLoc();
 
     // Set the starting address for the section
     AppendLineExtOp(debug_line, DW_LNE_set_address, m_sizeof_address,
                     sect.getSymbol());
 
-    if (asm_source)
+    for (DwarfSection::Locs::const_iterator i=dwarf2sect->locs.begin(),
+         end=dwarf2sect->locs.end(); i != end; ++i)
     {
-#if 0
-        unsigned long lastfile = 0;
-        DwarfLoc loc;
-
-        for (Section::bc_iterator i=sect.bytecodes_begin(),
-             end=sect.bytecodes_end(); i != end; ++i)
-        {
-            GenerateLineBC(debug_line, smgr, &state, *i, &loc, &lastfile);
-        }
-#endif
-    }
-    else
-    {
-        for (DwarfSection::Locs::const_iterator i=dwarf2sect->locs.begin(),
-             end=dwarf2sect->locs.end(); i != end; ++i)
-        {
-            DwarfSection::Locs::const_iterator next = i+1;
-            GenerateLineOp(debug_line, &state, *i, next != end ? &*next : 0);
-        }
+        DwarfSection::Locs::const_iterator next = i+1;
+        GenerateLineOp(debug_line, &state, *i, next != end ? &*next : 0);
     }
 
     // End sequence: bring address to end of section, then output end
     // sequence opcode.  Don't use a special opcode to do this as we don't
     // want an extra entry in the line matrix.
-    if (!state.prevloc.bc)
-        state.prevloc = sect.getBeginLoc();
     IntNum addr_delta;
     CalcDist(state.prevloc, sect.getEndLoc(), &addr_delta);
     if (addr_delta == DWARF_MAX_SPECIAL_ADDR_DELTA)
@@ -490,6 +479,15 @@ DwarfDebug::Generate_line(SourceManager& smgr,
         {
             AddFile(i->first);
         }
+
+        // Generate the locations before the prologue, as they may add
+        // filenames that only appear in line directives.
+        SourceLineCursor cursor(smgr);
+        for (Object::section_iterator i=m_object.sections_begin(),
+             end=m_object.sections_end(); i != end; ++i)
+        {
+            GenerateLineLocs(*i, cursor);
+        }
     }
 
     Section* debug_line = m_object.FindSection(".debug_line");
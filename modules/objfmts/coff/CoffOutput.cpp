@@ -370,6 +370,7 @@ CoffOutput::OutputSection(Section& sect)
     coffsect->m_size = 0;
 
     // Output bytecodes
+    sect.ReserveRelocs();
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
     {
@@ -418,15 +419,17 @@ CoffOutput::OutputSection(Section& sect)
         }
     }
 
+    // Serialize all relocations and write them as a single block.
+    Bytes& scratch = getScratch();
+    scratch.reserve(10 * sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const CoffReloc& reloc = static_cast<const CoffReloc&>(*i);
-        Bytes& scratch = getScratch();
         reloc.Write(scratch);
-        assert(scratch.size() == 10);
-        m_os << scratch;
     }
+    assert(scratch.size() == 10 * sect.getRelocs().size());
+    m_os << scratch;
     return true;
 }
 
@@ -751,6 +751,22 @@ ElfObject::FinalizeSymbol(Symbol& sym,
         elfsym->setName(strtab.getIndex(sym.getName()));
 }
 
+// Pad output with zeros up to a later file position.  Writing the padding
+// rather than seeking over it keeps output in the stream buffer.
+static void
+ElfPadOutput(raw_ostream& os, uint64_t pos, uint64_t newpos)
+{
+    static const char zeros[64] = {0};
+    while (pos < newpos)
+    {
+        uint64_t n = newpos - pos;
+        if (n > sizeof(zeros))
+            n = sizeof(zeros);
+        os.write(zeros, static_cast<size_t>(n));
+        pos += n;
+    }
+}
+
 namespace {
 class ElfOutput : public BytecodeStreamOutput
 {
@@ -777,7 +793,6 @@ public:
 private:
     ElfObject& m_objfmt;
     Object& m_object;
-    raw_fd_ostream& m_fd_os;
     BytecodeNoOutput m_no_output;
     SymbolRef m_GOT_sym;
     bool m_needs_GOT;
@@ -791,7 +806,6 @@ ElfOutput::ElfOutput(raw_fd_ostream& os,
     : BytecodeStreamOutput(os, diags)
     , m_objfmt(objfmt)
     , m_object(object)
-    , m_fd_os(os)
     , m_no_output(diags)
     , m_GOT_sym(object.FindSymbol("_GLOBAL_OFFSET_TABLE_"))
     , m_needs_GOT(false)
@@ -940,12 +954,7 @@ ElfOutput::OutputGroup(ElfGroup& group)
         return;
     }
 
-    m_fd_os.seek(group.elfsect->setFileOffset(pos));
-    if (m_os.has_error())
-    {
-        Diag(SourceLocation(), diag::err_file_output_seek);
-        return;
-    }
+    ElfPadOutput(m_os, pos, group.elfsect->setFileOffset(pos));
 
     Bytes& scratch = getScratch();
     m_objfmt.m_config.setEndian(scratch);
@@ -998,15 +1007,11 @@ ElfOutput::OutputSection(Section& sect, StringTable& shstrtab)
             return;
         }
 
-        m_fd_os.seek(elfsect->setFileOffset(pos));
-        if (m_os.has_error())
-        {
-            Diag(SourceLocation(), diag::err_file_output_seek);
-            return;
-        }
+        ElfPadOutput(m_os, pos, elfsect->setFileOffset(pos));
     }
 
     // Output bytecodes
+    sect.ReserveRelocs();
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
     {
@@ -1050,13 +1055,8 @@ ElfAlignOutput(raw_fd_ostream& os,
     unsigned long delta = align - (pos & (align-1));
     if (delta != align)
     {
+        ElfPadOutput(os, pos, pos + delta);
         pos += delta;
-        os.seek(pos);
-        if (os.has_error())
-        {
-            diags.Report(SourceLocation(), diag::err_file_output_seek);
-            return 0;
-        }
     }
     return static_cast<unsigned long>(pos);
 }
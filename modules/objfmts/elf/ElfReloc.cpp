@@ -152,7 +152,6 @@ ElfReloc::Write(Bytes& bytes, const ElfConfig& config)
     if (ElfSymbol* esym = getSymbol()->getAssocData<ElfSymbol>())
         r_sym = esym->getSymbolIndex();
 
-    bytes.resize(0);
     config.setEndian(bytes);
 
     if (config.cls == ELFCLASS32)
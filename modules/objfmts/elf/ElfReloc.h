@@ -79,6 +79,10 @@ public:
     virtual void HandleAddend(IntNum* intn,
                               const ElfConfig& config,
                               unsigned int insn_start);
+
+    /// Write the relocation entry.
+    /// @param bytes    bytes to append to
+    /// @param config   ELF configuration
     void Write(Bytes& bytes, const ElfConfig& config);
 
 protected:
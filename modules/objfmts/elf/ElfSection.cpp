@@ -370,17 +370,24 @@ ElfSection::WriteRelocs(raw_ostream& os,
         os << '\0';
     m_rel_offset = static_cast<unsigned long>(pos);
 
-    unsigned long size = 0;
+    // Serialize all relocations and write them as a single block.
+    unsigned int entsize;
+    if (m_config.cls == ELFCLASS32)
+        entsize = m_config.rela ? RELOC32A_SIZE : RELOC32_SIZE;
+    else
+        entsize = m_config.rela ? RELOC64A_SIZE : RELOC64_SIZE;
+
+    scratch.resize(0);
+    scratch.reserve(entsize * sect.getRelocs().size());
     for (Section::reloc_iterator i=sect.relocs_begin(), end=sect.relocs_end();
          i != end; ++i)
     {
         ElfReloc& reloc = static_cast<ElfReloc&>(*i);
-        scratch.resize(0);
         reloc.Write(scratch, m_config);
-        os << scratch;
-        size += scratch.size();
     }
-    return size;
+    assert(scratch.size() == entsize * sect.getRelocs().size());
+    os << scratch;
+    return scratch.size();
 }
 
 void
@@ -481,6 +481,7 @@ MachOutput::OutputSection(Section& sect)
     }
 
     // Output bytecodes
+    sect.ReserveRelocs();
     unsigned long size = 0;
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
@@ -505,15 +506,17 @@ MachOutput::OutputSectionRelocs(Section& sect, unsigned long* relocs_offset)
     MachSection* msect = sect.getAssocData<MachSection>();
     assert(msect != 0);
 
+    // Serialize all relocations and write them as a single block.
+    Bytes& scratch = getScratch();
+    scratch.reserve(RELINFO_SIZE * sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const MachReloc& reloc = static_cast<const MachReloc&>(*i);
-        Bytes& scratch = getScratch();
         reloc.Write(scratch);
-        assert(scratch.size() == RELINFO_SIZE);
-        m_os << scratch;
     }
+    assert(scratch.size() == RELINFO_SIZE * sect.getRelocs().size());
+    m_os << scratch;
 
     msect->reloff = *relocs_offset;
     *relocs_offset += RELINFO_SIZE * sect.getRelocs().size();
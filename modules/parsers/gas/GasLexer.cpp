@@ -37,6 +37,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/ScanBlocks.h"
 
 
 STATISTIC(num_identifier, "Number of identifiers lexed");
@@ -53,7 +54,6 @@ GasLexer::GasLexer(FileID fid,
                    Preprocessor& pp)
     : Lexer(fid, input_buffer, pp)
 {
-    InitCharacterInfo();
 }
 
 GasLexer::GasLexer(SourceLocation file_loc,
@@ -62,14 +62,16 @@ GasLexer::GasLexer(SourceLocation file_loc,
                    const char* end)
     : Lexer(file_loc, start, ptr, end)
 {
-    InitCharacterInfo();
 }
 
 GasLexer::~GasLexer()
 {
 }
 
-void
+unsigned char GasLexer::s_char_info[256];
+const bool GasLexer::s_char_info_init = GasLexer::InitCharacterInfo();
+
+bool
 GasLexer::InitCharacterInfo()
 {
     // Initialize the character info table.
@@ -85,6 +87,7 @@ GasLexer::InitCharacterInfo()
         s_char_info[i] = s_char_info[i+'A'-'a'] = CHAR_LETTER;
     for (unsigned i = '0'; i <= '9'; ++i)
         s_char_info[i] = CHAR_NUMBER;
+    return true;
 }
 
 void
@@ -94,7 +97,16 @@ GasLexer::LexIdentifier(Token* result, const char* cur_ptr, bool is_label)
     unsigned int size;
     unsigned char ch = *cur_ptr++;
     while (isIdentifierBody(ch))
+    {
         ch = *cur_ptr++;
+        // Most identifiers are short; only long ones (e.g. mangled names)
+        // are worth skipping in blocks.
+        if (cur_ptr - m_buf_ptr == 8)
+        {
+            cur_ptr = SkipIdentifierBlocks(cur_ptr-1, m_buf_end, "_.$");
+            ch = *cur_ptr++;
+        }
+    }
     --cur_ptr;  // Back up over the skipped character.
 
     // Fast path, no \ in identifier found.  '\' might be an escaped newline.
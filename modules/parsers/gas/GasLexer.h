@@ -80,6 +80,12 @@ protected:
         CHAR_ID_OTHER = 0x40   // e.g. '$', '#', '@', '~', '?'
     };
 
+    /// Character information, including the additional types above.
+    /// Hides Lexer::s_char_info.
+    static unsigned char s_char_info[256];
+    static const bool s_char_info_init;
+    static bool InitCharacterInfo();
+
     /// Return true if this is the body character of an
     /// identifier, which is [a-zA-Z0-9_].
     static inline bool
@@ -100,7 +106,6 @@ protected:
             ? true : false;
     }
 
-    void InitCharacterInfo();
     virtual void LexTokenInternal(Token* result);
 
     bool isEndOfBlockCommentWithEscapedNewLine(const char* cur_ptr);
@@ -103,7 +103,7 @@ GasPreproc::HandleInclude(StringRef filename, SourceLocation source)
     }
 
     // Finally, if all is good, enter the new file!
-    EnterSourceFile(fid, cur_dir, source);
+    EnterIncludeFile(fid, cur_dir, source);
     return true;
 }
 
@@ -37,6 +37,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/ScanBlocks.h"
 
 
 STATISTIC(num_identifier, "Number of identifiers lexed");
@@ -52,7 +53,6 @@ NasmLexer::NasmLexer(FileID fid,
                      Preprocessor& pp)
     : Lexer(fid, input_buffer, pp)
 {
-    InitCharacterInfo();
 }
 
 NasmLexer::NasmLexer(SourceLocation file_loc,
@@ -61,14 +61,16 @@ NasmLexer::NasmLexer(SourceLocation file_loc,
                      const char* end)
     : Lexer(file_loc, start, ptr, end)
 {
-    InitCharacterInfo();
 }
 
 NasmLexer::~NasmLexer()
 {
 }
 
-void
+unsigned char NasmLexer::s_char_info[256];
+const bool NasmLexer::s_char_info_init = NasmLexer::InitCharacterInfo();
+
+bool
 NasmLexer::InitCharacterInfo()
 {
     // Initialize the character info table.
@@ -87,6 +89,7 @@ NasmLexer::InitCharacterInfo()
         s_char_info[i] = s_char_info[i+'A'-'a'] = CHAR_LETTER;
     for (unsigned i = '0'; i <= '9'; ++i)
         s_char_info[i] = CHAR_NUMBER;
+    return true;
 }
 
 void
@@ -96,7 +99,16 @@ NasmLexer::LexIdentifier(Token* result, const char* cur_ptr, bool is_label)
     unsigned int size;
     unsigned char ch = *cur_ptr++;
     while (isIdentifierBody(ch))
+    {
         ch = *cur_ptr++;
+        // Most identifiers are short; only long ones (e.g. mangled names)
+        // are worth skipping in blocks.
+        if (cur_ptr - m_buf_ptr == 8)
+        {
+            cur_ptr = SkipIdentifierBlocks(cur_ptr-1, m_buf_end, "_.$#@~?");
+            ch = *cur_ptr++;
+        }
+    }
     --cur_ptr;  // Back up over the skipped character.
 
     // Fast path, no \ in identifier found.  '\' might be an escaped newline.
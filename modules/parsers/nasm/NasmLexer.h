@@ -97,6 +97,12 @@ protected:
         CHAR_ID_OTHER = 0x40   // e.g. '$', '#', '@', '~', '?'
     };
 
+    /// Character information, including the additional types above.
+    /// Hides Lexer::s_char_info.
+    static unsigned char s_char_info[256];
+    static const bool s_char_info_init;
+    static bool InitCharacterInfo();
+
     /// Return true if this is the body character of an
     /// identifier, which is [a-zA-Z0-9_].
     static inline bool
@@ -117,7 +123,6 @@ protected:
             ? true : false;
     }
 
-    void InitCharacterInfo();
     virtual void LexTokenInternal(Token* result);
 
     // Helper functions to lex the remainder of a token of the specific type.
@@ -30,21 +30,101 @@
 //
 #include "NasmPreproc.h"
 
+#include "config.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include "NasmLexer.h"
+#include "nasm.h"
+#include "nasmlib.h"
+#include "nasm-eval.h"
+#include "nasm-pp.h"
+
+#include "nasm-macros.i"
 
 
 using namespace yasm;
 using namespace yasm::parser;
 
+namespace {
+/// A MemoryBuffer that takes over the contents of a string rather than
+/// copying them.
+class StringMemoryBuffer : public MemoryBuffer
+{
+public:
+    StringMemoryBuffer(std::string* str, StringRef name)
+        : m_name(name)
+    {
+        m_str.swap(*str);
+        init(m_str.c_str(), m_str.c_str() + m_str.size(), true);
+    }
+
+    const char* getBufferIdentifier() const { return m_name.c_str(); }
+    BufferKind getBufferKind() const { return MemoryBuffer_Malloc; }
+
+private:
+    std::string m_str;
+    std::string m_name;
+};
+} // anonymous namespace
+
+void
+NasmPreproc::ErrorFunc(int severity, const char *fmt, ...)
+{
+    NasmPreproc* pp = static_cast<NasmPreproc*>(nasm::pp_get_preproc());
+    va_list va;
+
+    fprintf(stderr, "%s:%ld: ", nasm::nasm_src_get_fname(),
+            nasm::nasm_src_get_linnum());
+
+    va_start(va, fmt);
+    switch (severity & ERR_MASK) {
+        case ERR_WARNING:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            break;
+        case ERR_NONFATAL:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            ++pp->m_errors;
+            break;
+        case ERR_FATAL:
+        case ERR_PANIC:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            exit(1);
+            /*@notreached@*/
+            break;
+        case ERR_DEBUG:
+            break;
+    }
+    va_end(va);
+}
+
 NasmPreproc::NasmPreproc(DiagnosticsEngine& diags,
                          SourceManager& sm,
                          HeaderSearch& headers)
     : Preprocessor(diags, sm, headers)
+    , m_state(nasm::pp_new_state(this))
+    , m_errors(0)
+    , m_stream_prior_linnum(0)
+    , m_stream_presumed_linnum(0)
+    , m_stream_file_name(0)
+    , m_stream_lineinc(0)
+    , m_stream_done(true)
 {
 }
 
 NasmPreproc::~NasmPreproc()
 {
+    nasm::pp_delete_state(m_state);
+    nasm_free(m_stream_file_name);
 }
 
 void
@@ -107,3 +187,182 @@ NasmPreproc::CreateLexer(FileID fid, const MemoryBuffer* input_buffer)
 {
     return new NasmLexer(fid, input_buffer, *this);
 }
+
+void
+NasmPreproc::EnterPreprocessedMainFile(Object* object)
+{
+    nasm::pp_set_state(m_state);
+    nasm::pp_set_object(object);
+    m_errors = 0;
+    nasm::nasmpp.reset(m_source_mgr.getMainFileID(), 2, ErrorFunc,
+                       nasm::nasm_evaluate);
+
+    // pass down command line options
+    for (std::vector<Predef>::iterator i = m_predefs.begin(),
+         end = m_predefs.end(); i != end; ++i)
+    {
+        char *def = const_cast<char*>(i->m_string.c_str());
+        switch (i->m_type)
+        {
+            case Predef::PREINC:
+                nasm::pp_pre_include(def);
+                break;
+            case Predef::PREDEF:
+                nasm::pp_pre_define(def);
+                break;
+            case Predef::UNDEF:
+                nasm::pp_pre_undefine(def);
+                break;
+            case Predef::BUILTIN:
+                nasm::pp_builtin_define(def);
+                break;
+        }
+    }
+
+    // add version macros
+    int major = 0, minor = 0, subminor = 0, patchlevel = 0, matched;
+    matched = sscanf(PACKAGE_VERSION, "%d.%d.%d.%d", &major, &minor, &subminor,
+                     &patchlevel);
+
+    if (matched == 3)
+        patchlevel = 0;
+
+    char buf[100];
+    sprintf(buf, "%%define __YASM_MAJOR__ %d", major);
+    m_version_mac[0] = buf;
+    sprintf(buf, "%%define __YASM_MINOR__ %d", minor);
+    m_version_mac[1] = buf;
+    sprintf(buf, "%%define __YASM_SUBMINOR__ %d", subminor);
+    m_version_mac[2] = buf;
+    sprintf(buf, "%%define __YASM_BUILD__ %d", patchlevel);
+    m_version_mac[3] = buf;
+    sprintf(buf, "%%define __YASM_PATCHLEVEL__ %d", patchlevel);
+    m_version_mac[4] = buf;
+
+    /* Version id (hex number) */
+    sprintf(buf, "%%define __YASM_VERSION_ID__ 0%02x%02x%02x%02xh",
+            major, minor, subminor, patchlevel);
+    m_version_mac[5] = buf;
+
+    /* Version string */
+    m_version_mac[6] = "%define __YASM_VER__ \"" PACKAGE_VERSION "\"";
+
+    for (int i=0; i<NumVersionMacros; ++i)
+        m_version_mac_ptrs[i] = m_version_mac[i].c_str();
+    m_version_mac_ptrs[NumVersionMacros] = NULL;
+    nasm::pp_extra_stdmac(m_version_mac_ptrs);
+
+    // add standard macros
+    nasm::pp_extra_stdmac(nasm_standard_mac);
+
+    // start streaming preprocessed output
+    m_stream_name =
+        m_source_mgr.getBuffer(m_source_mgr.getMainFileID())
+        ->getBufferIdentifier();
+    m_stream_prior_linnum = 0;
+    m_stream_presumed_linnum = 0;
+    nasm_free(m_stream_file_name);
+    m_stream_file_name = 0;
+    m_stream_lineinc = 0;
+    m_stream_done = false;
+
+    FileID fid = FetchNextMainBuffer();
+    if (fid.isInvalid())
+    {
+        // Nothing to lex (empty input or errors); still need a lexer to
+        // return the end of file.
+        fid = m_source_mgr.createFileIDForMemBuffer(
+            MemoryBuffer::getMemBufferCopy("", m_stream_name));
+    }
+    EnterSourceFile(fid, 0, SourceLocation());
+
+    for (std::vector<MemoryBuffer*>::reverse_iterator
+         i=m_predefines.rbegin(), end=m_predefines.rend(); i != end; ++i)
+        EnterSourceFile(m_source_mgr.createFileIDForMemBuffer(*i), 0,
+                        SourceLocation());
+}
+
+bool
+NasmPreproc::FinishPreprocessedMainFile()
+{
+    nasm::pp_set_state(m_state);
+    if (!m_stream_done)
+    {
+        // Parsing stopped early; drain the preprocessor.
+        while (char* line = nasm::nasmpp.getline())
+            nasm_free(line);
+        nasm::nasmpp.cleanup(1);
+        m_stream_done = true;
+    }
+    std::string().swap(m_stream_chunk);
+    return m_errors == 0;
+}
+
+FileID
+NasmPreproc::FetchNextMainBuffer()
+{
+    if (m_stream_done)
+        return FileID();
+
+    nasm::pp_set_state(m_state);
+    m_stream_chunk.clear();
+    m_stream_chunk.reserve(StreamChunkSize + 4096);
+    bool chunk_start = true;
+    while (m_stream_chunk.size() < StreamChunkSize)
+    {
+        char* line = nasm::nasmpp.getline();
+        if (!line)
+        {
+            nasm::nasmpp.cleanup(1);
+            m_stream_done = true;
+            break;
+        }
+
+        long linnum = m_stream_prior_linnum += m_stream_lineinc;
+        int altline = nasm::nasm_src_get(&linnum, &m_stream_file_name);
+        if (altline != 0)
+        {
+            m_stream_lineinc = (altline != -1 || m_stream_lineinc != 1);
+            m_stream_prior_linnum = linnum;
+            m_stream_presumed_linnum = linnum;
+        }
+
+        // Each chunk is lexed as a separate buffer, so restate the current
+        // line at the start of every chunk to keep presumed locations
+        // identical to a single-buffer lex.
+        if (altline != 0 || chunk_start)
+        {
+            SmallString<64> linestr;
+            llvm::raw_svector_ostream los(linestr);
+            los << "%line " << m_stream_presumed_linnum << '+'
+                << m_stream_lineinc << ' ' << m_stream_file_name << '\n';
+            m_stream_chunk += los.str();
+            chunk_start = false;
+        }
+        m_stream_chunk += line;
+        m_stream_chunk += '\n';
+        ++m_stream_presumed_linnum;
+        nasm_free(line);
+    }
+
+    // Stop feeding the lexer as soon as the preprocessor reports an error;
+    // the parser reports the failure once lexing ends.
+    if (m_errors > 0)
+    {
+        if (!m_stream_done)
+        {
+            while (char* line = nasm::nasmpp.getline())
+                nasm_free(line);
+            nasm::nasmpp.cleanup(1);
+            m_stream_done = true;
+        }
+        return FileID();
+    }
+
+    if (m_stream_chunk.empty())
+        return FileID();
+
+    // Hand the chunk over to the source manager without copying it.
+    return m_source_mgr.createFileIDForMemBuffer(
+        new StringMemoryBuffer(&m_stream_chunk, m_stream_name));
+}
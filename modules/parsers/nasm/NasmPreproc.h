@@ -30,15 +30,21 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <string>
+#include <vector>
+
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Parse/Preprocessor.h"
 
 
+namespace nasm { struct PPState; }
+
 namespace yasm
 {
 
 class IdentifierInfo;
+class Object;
 
 namespace parser
 {
@@ -56,6 +62,20 @@ public:
     virtual void UndefineMacro(StringRef macroname);
     virtual void DefineBuiltin(StringRef macronameval);
 
+    /// Start the NASM preprocessor on the main file and enter its output as
+    /// the main source to lex.  Preprocessed lines are handed to the lexer
+    /// a chunk at a time as it consumes them, so parsing proceeds alongside
+    /// preprocessing.  Each chunk stays registered with the source manager
+    /// after it is lexed, since bytecode source locations point into it
+    /// and later diagnostics need its text, so one copy of the whole
+    /// preprocessed output is still held until the source manager goes away.
+    /// @param object       object (for symbol lookups in expressions)
+    void EnterPreprocessedMainFile(Object* object);
+
+    /// Shut down the NASM preprocessor after lexing has completed.
+    /// @return False if the NASM preprocessor reported any errors.
+    bool FinishPreprocessedMainFile();
+
     struct Predef
     {
         enum Type { PREINC, PREDEF, UNDEF, BUILTIN } m_type;
@@ -67,8 +87,36 @@ public:
 protected:
     virtual void RegisterBuiltinMacros();
     virtual Lexer* CreateLexer(FileID fid, const MemoryBuffer* input_buffer);
+    virtual FileID FetchNextMainBuffer();
 
 private:
+    /// Error reporting function passed to the NASM preprocessor.
+    static void ErrorFunc(int severity, const char* fmt, ...);
+
+    /// NASM preprocessor state for this instance.
+    nasm::PPState* m_state;
+
+    /// Number of errors reported by the NASM preprocessor.
+    unsigned int m_errors;
+
+    /// Preprocessed lines are accumulated into chunks of at least this many
+    /// bytes before being handed to the lexer.
+    enum { StreamChunkSize = 64*1024 };
+
+    /// Version macros passed to the NASM preprocessor.
+    enum { NumVersionMacros = 7 };
+    std::string m_version_mac[NumVersionMacros];
+    const char* m_version_mac_ptrs[NumVersionMacros+1];
+
+    /// Preprocessed output streaming state.
+    std::string m_stream_name;      ///< buffer name for output chunks
+    std::string m_stream_chunk;     ///< chunk being built
+    long m_stream_prior_linnum;     ///< last line number given by %line
+    long m_stream_presumed_linnum;  ///< presumed line of next output line
+    char* m_stream_file_name;       ///< current source filename
+    int m_stream_lineinc;           ///< current %line increment
+    bool m_stream_done;             ///< no more output will be produced
+
     /// Identifiers for builtin macros and other builtins.
     IdentifierInfo *m_LINE, *m_FILE;  // __LINE__, __FILE__
     IdentifierInfo *m_DATE, *m_TIME;  // __DATE__, __TIME__
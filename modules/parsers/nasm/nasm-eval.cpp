@@ -9,6 +9,7 @@
  */
 #include <cctype>
 
+#include "yasmx/Config/threads.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Object.h"
@@ -17,6 +18,7 @@
 #include "nasm.h"
 #include "nasmlib.h"
 #include "nasm-eval.h"
+#include "nasm-pp.h"
 
 
 using yasm::Expr;
@@ -24,16 +26,15 @@ using yasm::IntNum;
 
 namespace nasm {
 
-/* The assembler object (for symbol table). */
-yasm::Object *yasm_object;
+/* Per-evaluation scratch state; thread-local so that preprocessors on
+ * different threads can evaluate concurrently. */
+static YASM_THREAD_LOCAL scanner scan;  /* Address of scanner routine */
+static YASM_THREAD_LOCAL efunc error;   /* Address of error reporting routine */
 
-static scanner scan;    /* Address of scanner routine */
-static efunc error;     /* Address of error reporting routine */
+static YASM_THREAD_LOCAL struct tokenval *tokval; /* The current token */
+static YASM_THREAD_LOCAL int i;                   /* The t_type of tokval */
 
-static struct tokenval *tokval;   /* The current token */
-static int i;                     /* The t_type of tokval */
-
-static void *scpriv;
+static YASM_THREAD_LOCAL void *scpriv;
 
 /*
  * Recursive-descent parser. Called with a single boolean operand,
@@ -73,7 +74,7 @@ static bool rexp0(Expr*), rexp1(Expr*), rexp2(Expr*), rexp3(Expr*);
 static bool expr0(Expr*), expr1(Expr*), expr2(Expr*), expr3(Expr*);
 static bool expr4(Expr*), expr5(Expr*), expr6(Expr*);
 
-static bool (*bexpr)(Expr*);
+static YASM_THREAD_LOCAL bool (*bexpr)(Expr*);
 
 static bool rexp0(Expr* e)
 {
@@ -336,8 +337,8 @@ static bool expr6(Expr* e)
             *e = Expr(*tokval->t_integer);
             break;
           case TOKEN_ID:
-            if (yasm_object) {
-                yasm::SymbolRef sym = yasm_object->getSymbol(tokval->t_charptr);
+            if (yasm::Object* object = pp_get_object()) {
+                yasm::SymbolRef sym = object->getSymbol(tokval->t_charptr);
                 if (sym) {
                     sym->Use(yasm::SourceLocation());
                     *e = Expr(sym);
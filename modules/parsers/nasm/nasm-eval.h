@@ -15,8 +15,6 @@ namespace yasm { class Expr; class Object; }
 
 namespace nasm {
 
-extern yasm::Object* yasm_object;
-
 /*
  * The evaluator itself.
  */
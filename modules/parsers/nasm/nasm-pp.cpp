@@ -41,6 +41,7 @@
 
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Config/threads.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Parse/Preprocessor.h"
@@ -61,44 +62,6 @@ using yasm::StringRef;
 
 namespace nasm {
 
-int tasm_compatible_mode = 0;
-int tasm_locals;
-const char *tasm_segment;
-
-yasm::Preprocessor* yasm_preproc;
-
-const MemoryBuffer*
-yasm_fopen_include(StringRef filename,
-                   const DirectoryLookup* from_dir,
-                   const DirectoryLookup*& cur_dir,
-                   FileID from_file,
-                   FileID& cur_file)
-{
-    yasm::SourceManager& srcmgr = yasm_preproc->getSourceManager();
-
-    const yasm::FileEntry* from_file_ent = srcmgr.getFileEntryForID(from_file);
-
-    const yasm::FileEntry* file =
-        yasm_preproc->getHeaderSearch().LookupFile(filename, false, from_dir,
-                                                   cur_dir, from_file_ent);
-    if (!file)
-        return 0;
-
-    FileID fid =
-        srcmgr.createFileID(file, SourceLocation(), yasm::SrcMgr::C_User);
-    if (fid.isInvalid())
-        return 0;
-    cur_file = fid;
-
-    bool invalid = false;
-    const MemoryBuffer* input_file =
-        srcmgr.getBuffer(fid, SourceLocation(), &invalid);
-    if (invalid)
-        return 0;
-
-    return input_file;
-}
-
 char *
 yasm_fgets(char *buf, int n, const MemoryBuffer *in, size_t *pos)
 {
@@ -422,50 +385,12 @@ static const char *tasm_directives[] = {
     "ifndef", "include", "local"
 };
 
-static int StackSize = 4;
-static const char *StackPointer = "ebp";
-static int ArgOffset = 8;
-static int LocalOffset = 4;
-static int Level = 0;
-
-
-static Context *cstk;
-static Include *istk;
-
-static efunc _error;            /* Pointer to client-provided error reporting function */
-static evalfunc evaluate;
-
-static int pass;                /* HACK: pass 0 = generate dependencies only */
-
-static unsigned long unique;    /* unique identifier numbers */
-
-static Line *builtindef = NULL;
-static Line *stddef = NULL;
-static Line *predef = NULL;
-static int first_line = 1;
-
-/*
- * The number of hash values we use for the macro lookup tables.
- * FIXME: We should *really* be able to configure this at run time,
- * or even have the hash table automatically expanding when necessary.
- */
-#define NHASH 31
-
-/*
- * The current set of multi-line macros we have defined.
- */
-static MMacro *mmacros[NHASH];
-
 /*
- * The current set of single-line macros we have defined.
+ * The initial number of buckets in the macro lookup tables (a power of
+ * two), and the average chain length at which a table doubles in size.
  */
-static SMacro *smacros[NHASH];
-
-/*
- * The multi-line macro we are currently defining, or the %rep
- * block we are currently reading, if any.
- */
-static MMacro *defining;
+#define NHASH 32
+#define NHASH_MAX_LOAD 2
 
 /*
  * The number of macro parameters to allocate space for at a time.
@@ -530,20 +455,15 @@ static const char *tasm_compat_macros[] =
     NULL
 };
 
-static int nested_mac_count, nested_rep_count;
-
 /*
  * Tokens are allocated in blocks to improve speed
  */
 #define TOKEN_BLOCKSIZE 4096
-static Token *freeTokens = NULL;
 struct Blocks {
         Blocks *next;
         void *chunk;
 };
 
-static Blocks blocks = { NULL, NULL };
-
 /*
  * Forward declarations.
  */
@@ -580,10 +500,6 @@ typedef struct TMEndItem {
     struct TMEndItem *next;
 } TMEndItem;
 
-static TMEndItem *EndmStack = NULL, *EndsStack = NULL;
-
-char **TMParameters;
-
 struct TStrucField {
     char *name;
     char *type;
@@ -594,21 +510,257 @@ struct TStruc {
     struct TStrucField *fields, *lastField;
     struct TStruc *next;
 };
-static struct TStruc *TStrucs = NULL;
-static int inTstruc = 0;
-
 struct TSegmentAssume {
     char *segreg;
     char *segment;
 };
-struct TSegmentAssume *TAssumes;
+
+static unsigned long hash(const char *s);
+
+/*
+ * A macro lookup table, chained through the macros' `next' fields.
+ * Names differing only in case share a chain (see hash()), so lookups
+ * still walk the chain comparing names.  Callers report insertions and
+ * removals with added() and removed().  Whenever the average chain length
+ * exceeds NHASH_MAX_LOAD, resize() doubles the table; as that moves
+ * macros between chains, it is only called between directives, when no
+ * chain pointers are held.
+ */
+template <typename T>
+struct MacroTable
+{
+    T **buckets;
+    unsigned long size;         /* number of buckets, a power of two */
+    unsigned long count;        /* number of macros in the table */
+
+    MacroTable();
+    ~MacroTable();
+
+    /* The chain which holds (or would hold) macros called `name'. */
+    T **head(const char *name) { return &buckets[hash(name) & (size - 1)]; }
+
+    void added() { count++; }
+    void removed() { count--; }
+    void resize();
+
+    /* Forget all macros without freeing them. */
+    void clear();
+};
+
+template <typename T>
+MacroTable<T>::MacroTable()
+    : buckets(NULL)
+    , size(NHASH)
+    , count(0)
+{
+    buckets = (T **)nasm_malloc(size * sizeof(T *));
+    clear();
+}
+
+template <typename T>
+MacroTable<T>::~MacroTable()
+{
+    nasm_free(buckets);
+}
+
+template <typename T>
+void
+MacroTable<T>::clear()
+{
+    for (unsigned long i = 0; i < size; i++)
+        buckets[i] = NULL;
+    count = 0;
+}
+
+template <typename T>
+void
+MacroTable<T>::resize()
+{
+    if (count <= size * NHASH_MAX_LOAD)
+        return;
+
+    /*
+     * Double the table.  Old bucket i splits into new buckets i and
+     * i+size; appending in chain order keeps same-named macros in the
+     * order lookups expect.
+     */
+    T **newbuckets = (T **)nasm_malloc(2 * size * sizeof(T *));
+    for (unsigned long i = 0; i < size; i++)
+    {
+        T **lo = &newbuckets[i];
+        T **hi = &newbuckets[i + size];
+        T *m, *next;
+        for (m = buckets[i]; m; m = next)
+        {
+            next = m->next;
+            if (hash(m->name) & size)
+            {
+                *hi = m;
+                hi = &m->next;
+            }
+            else
+            {
+                *lo = m;
+                lo = &m->next;
+            }
+        }
+        *lo = NULL;
+        *hi = NULL;
+    }
+    nasm_free(buckets);
+    buckets = newbuckets;
+    size *= 2;
+}
+
+/*
+ * All mutable preprocessor state.  Each NasmPreproc owns one of these;
+ * it is made current for the calling thread (see pp_set_state) while the
+ * preprocessor runs, so independent assemblies can preprocess concurrently
+ * on different threads.
+ */
+struct PPState
+{
+    PPState();
+
+    yasm::Preprocessor* yasm_preproc;
+    yasm::Object* yasm_object;
+
+    /* Current source file name and line number (see nasmlib.h). */
+    char *file_name;
+    long line_number;
+
+    int tasm_compatible_mode;
+    int tasm_locals;
+    const char *tasm_segment;
+
+    int StackSize;
+    const char *StackPointer;
+    int ArgOffset;
+    int LocalOffset;
+    int Level;
+
+    Context *cstk;
+    Include *istk;
+
+    efunc _error;           /* Pointer to client-provided error reporting function */
+    evalfunc evaluate;
+
+    int pass;               /* HACK: pass 0 = generate dependencies only */
+
+    unsigned long unique;   /* unique identifier numbers */
+
+    Line *builtindef;
+    Line *stddef;
+    Line *predef;
+    int first_line;
+
+    /*
+     * The current set of multi-line macros we have defined.
+     */
+    MacroTable<MMacro> mmacros;
+
+    /*
+     * The current set of single-line macros we have defined.
+     */
+    MacroTable<SMacro> smacros;
+
+    /*
+     * The multi-line macro we are currently defining, or the %rep
+     * block we are currently reading, if any.
+     */
+    MMacro *defining;
+
+    int nested_mac_count, nested_rep_count;
+
+    Token *freeTokens;
+    Blocks blocks;
+
+    TMEndItem *EndmStack, *EndsStack;
+    char **TMParameters;
+    struct TStruc *TStrucs;
+    int inTstruc;
+    struct TSegmentAssume *TAssumes;
+};
+
+PPState::PPState()
+    : yasm_preproc(NULL)
+    , yasm_object(NULL)
+    , file_name(NULL)
+    , line_number(0)
+    , tasm_compatible_mode(0)
+    , tasm_locals(0)
+    , tasm_segment(NULL)
+    , StackSize(4)
+    , StackPointer("ebp")
+    , ArgOffset(8)
+    , LocalOffset(4)
+    , Level(0)
+    , cstk(NULL)
+    , istk(NULL)
+    , _error(NULL)
+    , evaluate(NULL)
+    , pass(0)
+    , unique(0)
+    , builtindef(NULL)
+    , stddef(NULL)
+    , predef(NULL)
+    , first_line(1)
+    , defining(NULL)
+    , nested_mac_count(0)
+    , nested_rep_count(0)
+    , freeTokens(NULL)
+    , EndmStack(NULL)
+    , EndsStack(NULL)
+    , TMParameters(NULL)
+    , TStrucs(NULL)
+    , inTstruc(0)
+    , TAssumes(NULL)
+{
+    blocks.next = NULL;
+    blocks.chunk = NULL;
+}
+
+/* The state current for this thread. */
+static YASM_THREAD_LOCAL PPState *pps;
+
+const MemoryBuffer*
+yasm_fopen_include(StringRef filename,
+                   const DirectoryLookup* from_dir,
+                   const DirectoryLookup*& cur_dir,
+                   FileID from_file,
+                   FileID& cur_file)
+{
+    yasm::SourceManager& srcmgr = pps->yasm_preproc->getSourceManager();
+
+    const yasm::FileEntry* from_file_ent = srcmgr.getFileEntryForID(from_file);
+
+    const yasm::FileEntry* file =
+        pps->yasm_preproc->getHeaderSearch().LookupFile(filename, false, from_dir,
+                                                   cur_dir, from_file_ent);
+    if (!file)
+        return 0;
+
+    FileID fid =
+        srcmgr.createFileID(file, SourceLocation(), yasm::SrcMgr::C_User);
+    if (fid.isInvalid())
+        return 0;
+    cur_file = fid;
+
+    bool invalid = false;
+    const MemoryBuffer* input_file =
+        srcmgr.getBuffer(fid, SourceLocation(), &invalid);
+    if (invalid)
+        return 0;
+
+    return input_file;
+}
 
 const char *tasm_get_segment_register(const char *segment)
 {
     struct TSegmentAssume *assume;
-    if (!TAssumes)
+    if (!pps->TAssumes)
         return NULL;
-    for (assume = TAssumes; assume->segreg; assume++) {
+    for (assume = pps->TAssumes; assume->segreg; assume++) {
         if (!strcmp(assume->segment, segment))
             break;
     }
@@ -698,13 +850,13 @@ check_tasm_directive(char *line)
     if (!nasm_stricmp(p, "endm")) {
         /* handle end of endm directive */
         char **parameter;
-        end = EndmStack;
+        end = pps->EndmStack;
         /* undef parameters */
         if (!end) {
             error(ERR_FATAL, "ENDM: not in an endm context");
             return line;
         }
-        EndmStack = EndmStack->next;
+        pps->EndmStack = pps->EndmStack->next;
         nasm_free(line);
         switch (end->type) {
         case TM_MACRO:
@@ -754,13 +906,13 @@ check_tasm_directive(char *line)
         /* handle repeat directive */
         end = (TMEndItem*)nasm_malloc(sizeof(*end));
         end->type = TM_REPT;
-        end->next = EndmStack;
-        EndmStack = end;
+        end->next = pps->EndmStack;
+        pps->EndmStack = end;
         memcpy(p, "%rep", 4);
         p[len] = oldchar;
         return line;
     } else if (!nasm_stricmp(p, "locals")) {
-        tasm_locals = 1;
+        pps->tasm_locals = 1;
         nasm_free(line);
         return nasm_strdup("");
     }
@@ -805,9 +957,9 @@ check_tasm_directive(char *line)
 
         end = (TMEndItem*)nasm_malloc(sizeof(*end));
         end->type = TM_IRP;
-        end->next = EndmStack;
+        end->next = pps->EndmStack;
         end->data = data;
-        EndmStack = end;
+        pps->EndmStack = end;
 
         nasm_free(oldline);
         return line;
@@ -817,7 +969,7 @@ check_tasm_directive(char *line)
         /* count parameters */
         j = 1;
         i = 0;
-        TMParameters = (char**)nasm_malloc(j*sizeof(*TMParameters));
+        pps->TMParameters = (char**)nasm_malloc(j*sizeof(*pps->TMParameters));
         len = 0;
         p = q + len2 + 1;
         /* Skip whitespaces */
@@ -829,15 +981,15 @@ check_tasm_directive(char *line)
             len2 = q-p;
             if (len2 == 0)
                 error(ERR_FATAL, "'%s': expected parameter name", p);
-            TMParameters[i] = (char*)nasm_malloc(len2 + 1);
-            memcpy(TMParameters[i], p, len2);
-            TMParameters[i][len2] = '\0';
+            pps->TMParameters[i] = (char*)nasm_malloc(len2 + 1);
+            memcpy(pps->TMParameters[i], p, len2);
+            pps->TMParameters[i][len2] = '\0';
             len += len2;
             i++;
             if (i + 1 > j) {
                 j *= 2;
-                TMParameters = (char**)nasm_realloc(TMParameters,
-                                               j*sizeof(*TMParameters));
+                pps->TMParameters = (char**)nasm_realloc(pps->TMParameters,
+                                               j*sizeof(*pps->TMParameters));
             }
             if (i == 1000)
                 error(ERR_FATAL, "too many parameters for macro %s", name);
@@ -852,23 +1004,23 @@ check_tasm_directive(char *line)
             while (isspace(*p) && *p)
                 p++;
         }
-        TMParameters[i] = NULL;
-        TMParameters = (char**)nasm_realloc(TMParameters,
-                                        (i+1)*sizeof(*TMParameters));
+        pps->TMParameters[i] = NULL;
+        pps->TMParameters = (char**)nasm_realloc(pps->TMParameters,
+                                        (i+1)*sizeof(*pps->TMParameters));
         len += 1 + 6 + 1 + strlen(name) + 1 + 3; /* macro definition */
         len += i * (1 + 9 + 1 + 1 + 1 + 3 + 2); /* macro parameter definition */
         oldline = line;
         p = line = (char*)nasm_malloc(len + 1);
         p += sprintf(p, "%%imacro %s 0-*", name);
         nasm_free(oldline);
-        for (j = 0; TMParameters[j]; j++) {
-            p += sprintf(p, "\n%%idefine %s %%{%-u}", TMParameters[j], j + 1);
+        for (j = 0; pps->TMParameters[j]; j++) {
+            p += sprintf(p, "\n%%idefine %s %%{%-u}", pps->TMParameters[j], j + 1);
         }
         end = (TMEndItem*)nasm_malloc(sizeof(*end));
         end->type = TM_MACRO;
-        end->next = EndmStack;
-        end->data = TMParameters;
-        EndmStack = end;
+        end->next = pps->EndmStack;
+        end->data = pps->TMParameters;
+        pps->EndmStack = end;
         return line;
     } else if (!nasm_stricmp(q, "proc")) {
         /* handle PROC */
@@ -880,7 +1032,7 @@ check_tasm_directive(char *line)
     } else if (!nasm_stricmp(q, "struc")) {
         /* handle struc */
         struct TStruc *struc;
-        if (inTstruc) {
+        if (pps->inTstruc) {
             error(ERR_FATAL, "STRUC: already in a struc context");
             return line;
         }
@@ -891,48 +1043,48 @@ check_tasm_directive(char *line)
         struc->name = nasm_strdup(p);
         struc->fields = NULL;
         struc->lastField = NULL;
-        struc->next = TStrucs;
-        TStrucs = struc;
-        inTstruc = 1;
+        struc->next = pps->TStrucs;
+        pps->TStrucs = struc;
+        pps->inTstruc = 1;
         nasm_free(oldline);
         end = (TMEndItem*)nasm_malloc(sizeof(*end));
         end->type = TM_STRUC;
-        end->next = EndsStack;
-        EndsStack = end;
+        end->next = pps->EndsStack;
+        pps->EndsStack = end;
         return line;
     } else if (!nasm_stricmp(q, "segment")) {
         /* handle SEGMENT */
         oldline = line;
         line = nasm_strdup(oldchar2?q+len2+1:"");
-        if (tasm_segment) {
+        if (pps->tasm_segment) {
             error(ERR_FATAL, "SEGMENT: already in a segment context");
             return line;
         }
-        tasm_segment = nasm_strdup(p);
+        pps->tasm_segment = nasm_strdup(p);
         nasm_free(oldline);
         end = (TMEndItem*)nasm_malloc(sizeof(*end));
         end->type = TM_SEGMENT;
-        end->next = EndsStack;
-        EndsStack = end;
+        end->next = pps->EndsStack;
+        pps->EndsStack = end;
         return line;
     } else if (!nasm_stricmp(p, "ends") || !nasm_stricmp(q, "ends")) {
         /* handle end of ends directive */
-        end = EndsStack;
+        end = pps->EndsStack;
         /* undef parameters */
         if (!end) {
             error(ERR_FATAL, "ENDS: not in an ends context");
             return line;
         }
-        EndsStack = EndsStack->next;
+        pps->EndsStack = pps->EndsStack->next;
         nasm_free(line);
         switch (end->type) {
         case TM_STRUC:
-            inTstruc = 0;
+            pps->inTstruc = 0;
             return nasm_strdup("endstruc");
         case TM_SEGMENT:
             /* XXX: yes, we leak memory here, but that permits labels
              * to avoid strduping... */
-            tasm_segment = NULL;
+            pps->tasm_segment = NULL;
             return nasm_strdup("");
         default:
             error(ERR_FATAL, "ENDS: bogus ends context type %d",end->type);
@@ -944,9 +1096,9 @@ check_tasm_directive(char *line)
     } else if (!nasm_stricmp(p, "assume")) {
         struct TSegmentAssume *assume;
         /* handle ASSUME */
-        if (!TAssumes) {
-            TAssumes = (TSegmentAssume*)nasm_malloc(sizeof(*TAssumes));
-            TAssumes[0].segreg = NULL;
+        if (!pps->TAssumes) {
+            pps->TAssumes = (TSegmentAssume*)nasm_malloc(sizeof(*pps->TAssumes));
+            pps->TAssumes[0].segreg = NULL;
         }
         i = 0;
         q[len2] = oldchar2;
@@ -959,14 +1111,14 @@ check_tasm_directive(char *line)
             if (!*q || *q == ';')
                 break;
             /* segment register name */
-            for (assume = TAssumes; assume->segreg; assume++)
+            for (assume = pps->TAssumes; assume->segreg; assume++)
                 if (strlen(assume->segreg) == (size_t)(q-p) &&
                     !nasm_strnicmp(assume->segreg, p, q-p))
                     break;
             if (!assume->segreg) {
-                i = assume - TAssumes + 1;
-                TAssumes = (TSegmentAssume*)nasm_realloc(TAssumes, (i+1)*sizeof(*TAssumes));
-                assume = TAssumes + i - 1;
+                i = assume - pps->TAssumes + 1;
+                pps->TAssumes = (TSegmentAssume*)nasm_realloc(pps->TAssumes, (i+1)*sizeof(*pps->TAssumes));
+                assume = pps->TAssumes + i - 1;
                 assume->segreg = nasm_strndup(p, q-p);
                 assume[1].segreg = NULL;
             }
@@ -987,11 +1139,11 @@ check_tasm_directive(char *line)
                 q++;
             for (; *q && isspace(*q); q++);
         }
-        TAssumes[i].segreg = NULL;
-        TAssumes = (TSegmentAssume*)nasm_realloc(TAssumes, (i+1)*sizeof(*TAssumes));
+        pps->TAssumes[i].segreg = NULL;
+        pps->TAssumes = (TSegmentAssume*)nasm_realloc(pps->TAssumes, (i+1)*sizeof(*pps->TAssumes));
         nasm_free(line);
         return nasm_strdup("");
-    } else if (inTstruc) {
+    } else if (pps->inTstruc) {
         struct TStrucField *field;
         /* TODO: handle unnamed data */
         field = (TStrucField*)nasm_malloc(sizeof(*field));
@@ -999,11 +1151,11 @@ check_tasm_directive(char *line)
         /* TODO: type struc ! */
         field->type = nasm_strdup(q);
         field->next = NULL;
-        if (!TStrucs->fields)
-                TStrucs->fields = field;
-        else if (TStrucs->lastField)
-                TStrucs->lastField->next = field;
-        TStrucs->lastField = field;
+        if (!pps->TStrucs->fields)
+                pps->TStrucs->fields = field;
+        else if (pps->TStrucs->lastField)
+                pps->TStrucs->lastField->next = field;
+        pps->TStrucs->lastField = field;
         if (!oldchar2) {
             error(ERR_FATAL, "Expected struc field initializer after %s %s", p, q);
             return line;
@@ -1016,7 +1168,7 @@ check_tasm_directive(char *line)
     }
     {
         struct TStruc *struc;
-        for (struc = TStrucs; struc; struc = struc->next) {
+        for (struc = pps->TStrucs; struc; struc = struc->next) {
             if (!nasm_stricmp(q, struc->name)) {
                 char *r = q + len2 + 1, *s, *t, tasm_param[6];
                 struct TStrucField *field = struc->fields;
@@ -1039,9 +1191,9 @@ check_tasm_directive(char *line)
                 oldline = line;
                 size = len + len2 + 128;
                 line = (char*)nasm_malloc(size);
-                if (defining)
-                    for (n=0;TMParameters[n];n++)
-                        if (!strcmp(TMParameters[n],p)) {
+                if (pps->defining)
+                    for (n=0;pps->TMParameters[n];n++)
+                        if (!strcmp(pps->TMParameters[n],p)) {
                             sprintf(tasm_param,"%%{%d}",n+1);
                             p = tasm_param;
                             break;
@@ -1147,7 +1299,7 @@ prepreproc(char *line)
         sprintf(line, "%%line %d %.*s", lineno, (int)fnlen, fname);
         nasm_free(oldline);
     }
-    if (tasm_compatible_mode)
+    if (pps->tasm_compatible_mode)
         line = check_tasm_directive(line);
 
     if (!(c = strchr(line, '\n')))
@@ -1157,7 +1309,7 @@ prepreproc(char *line)
     *c = '\0';
     ret = nasm_strdup(line);
 
-    lp = &istk->expansion;
+    lp = &pps->istk->expansion;
     do {
         d = strchr(c+1, '\n');
         if (d)
@@ -1178,30 +1330,20 @@ prepreproc(char *line)
  * The hash function for macro lookups. Note that due to some
  * macros having case-insensitive names, the hash function must be
  * invariant under case changes. We implement this by applying a
- * perfectly normal hash function to the uppercase of the string.
+ * perfectly normal hash function (FNV-1a) to the uppercase of the
+ * string.
  */
-static int
-hash(char *s)
+static unsigned long
+hash(const char *s)
 {
-    unsigned int h = 0;
-    unsigned int i = 0;
-    /*
-     * Powers of three, mod 31.
-     */
-    static const int multipliers[] = {
-        1, 3, 9, 27, 19, 26, 16, 17, 20, 29, 25, 13, 8, 24, 10,
-        30, 28, 22, 4, 12, 5, 15, 14, 11, 2, 6, 18, 23, 7, 21
-    };
-
+    unsigned long h = 2166136261UL;
 
     while (*s)
     {
-        h += multipliers[i] * (unsigned char) (toupper(*s));
+        h ^= (unsigned char) toupper(*s);
+        h *= 16777619UL;
         s++;
-        if (++i >= elements(multipliers))
-            i = 0;
     }
-    h %= NHASH;
     return h;
 }
 
@@ -1246,16 +1388,48 @@ free_mmacro(MMacro * m)
     nasm_free(m);
 }
 
+/*
+ * Free all global macros, both multi-line and single-line
+ */
+static void
+free_macros(void)
+{
+    unsigned long h;
+
+    for (h = 0; h < pps->mmacros.size; h++)
+    {
+        while (pps->mmacros.buckets[h])
+        {
+            MMacro *m = pps->mmacros.buckets[h];
+            pps->mmacros.buckets[h] = m->next;
+            free_mmacro(m);
+        }
+    }
+    pps->mmacros.clear();
+    for (h = 0; h < pps->smacros.size; h++)
+    {
+        while (pps->smacros.buckets[h])
+        {
+            SMacro *s = pps->smacros.buckets[h];
+            pps->smacros.buckets[h] = s->next;
+            nasm_free(s->name);
+            free_tlist(s->expansion);
+            nasm_free(s);
+        }
+    }
+    pps->smacros.clear();
+}
+
 /*
  * Pop the context stack.
  */
 static void
 ctx_pop(void)
 {
-    Context *c = cstk;
+    Context *c = pps->cstk;
     SMacro *smac, *s;
 
-    cstk = cstk->next;
+    pps->cstk = pps->cstk->next;
     smac = c->localmac;
     while (smac)
     {
@@ -1288,7 +1462,7 @@ read_line(void)
     continued_count = 0;
     while (1)
     {
-        q = yasm_fgets(p, bufsize - (int)(p - buffer), istk->in, &istk->pos);
+        q = yasm_fgets(p, bufsize - (int)(p - buffer), pps->istk->in, &pps->istk->pos);
         if (!q)
             break;
         p += strlen(p);
@@ -1327,7 +1501,7 @@ read_line(void)
         return NULL;
     }
 
-    nasm_src_set_linnum(nasm_src_get_linnum() + istk->lineinc + (continued_count * istk->lineinc));
+    nasm_src_set_linnum(nasm_src_get_linnum() + pps->istk->lineinc + (continued_count * pps->istk->lineinc));
 
     /*
      * Play safe: remove CRs as well as LFs, if any of either are
@@ -1521,7 +1695,7 @@ tokenise(char *line)
 static void *
 new_Block(size_t size)
 {
-        Blocks *b = &blocks;
+        Blocks *b = &pps->blocks;
         
         /* first, get to the end of the linked list      */
         while (b->next)
@@ -1543,7 +1717,7 @@ new_Block(size_t size)
 static void
 delete_Blocks(void)
 {
-        Blocks *a,*b = &blocks;
+        Blocks *a,*b = &pps->blocks;
 
         /* 
          * keep in mind that the first block, pointed to by blocks
@@ -1556,7 +1730,7 @@ delete_Blocks(void)
                         nasm_free(b->chunk);
                 a = b;
                 b = b->next;
-                if (a != &blocks)
+                if (a != &pps->blocks)
                         nasm_free(a);
         }
 }       
@@ -1572,15 +1746,15 @@ new_Token(Token * next, int type, const char *text, size_t txtlen)
     Token *t;
     int i;
 
-    if (freeTokens == NULL)
+    if (pps->freeTokens == NULL)
     {
-        freeTokens = (Token *)new_Block(TOKEN_BLOCKSIZE * sizeof(Token));
+        pps->freeTokens = (Token *)new_Block(TOKEN_BLOCKSIZE * sizeof(Token));
         for (i = 0; i < TOKEN_BLOCKSIZE - 1; i++)
-            freeTokens[i].next = &freeTokens[i + 1];
-        freeTokens[i].next = NULL;
+            pps->freeTokens[i].next = &pps->freeTokens[i + 1];
+        pps->freeTokens[i].next = NULL;
     }
-    t = freeTokens;
-    freeTokens = t->next;
+    t = pps->freeTokens;
+    pps->freeTokens = t->next;
     t->next = next;
     t->mac = NULL;
     t->type = type;
@@ -1604,8 +1778,8 @@ delete_Token(Token * t)
 {
     Token *next = t->next;
     nasm_free(t->text);
-    t->next = freeTokens;
-    freeTokens = t;
+    t->next = pps->freeTokens;
+    pps->freeTokens = t;
     return next;
 }
 
@@ -1822,13 +1996,13 @@ get_ctx(char *name, int all_contexts)
     if (!name || name[0] != '%' || name[1] != '$')
         return NULL;
 
-    if (!cstk)
+    if (!pps->cstk)
     {
         error(ERR_NONFATAL, "`%s': context stack is empty", name);
         return NULL;
     }
 
-    for (i = strspn(name + 2, "$"), ctx = cstk; (i > 0) && ctx; i--)
+    for (i = strspn(name + 2, "$"), ctx = pps->cstk; (i > 0) && ctx; i--)
     {
         ctx = ctx->next;
 /*        i--;  Lino - 02/25/02 */
@@ -1922,7 +2096,7 @@ inc_fopen(char *file,
         strcat(file2, pb);
 
     in = yasm_fopen_include(file2 ? file2 : file, from_dir, cur_dir, from_file, cur_file);
-    if (!in && tasm_compatible_mode)
+    if (!in && pps->tasm_compatible_mode)
     {
         char *thefile = file2 ? file2 : file;
         /* try a few case combinations */
@@ -1986,14 +2160,14 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
         m = ctx->localmac;
     else if (name[0] == '%' && name[1] == '$')
     {
-        if (cstk)
+        if (pps->cstk)
             ctx = get_ctx(name, FALSE);
         if (!ctx)
             return FALSE;       /* got to return _something_ */
         m = ctx->localmac;
     }
     else
-        m = smacros[hash(name)];
+        m = *pps->smacros.head(name);
 
     while (m)
     {
@@ -2089,7 +2263,7 @@ if_condition(Token * tline, int i)
         case PP_IFNCTX:
         case PP_ELIFNCTX:
             j = FALSE;          /* have we matched yet? */
-            while (cstk && tline)
+            while (pps->cstk && tline)
             {
                 skip_white_(tline);
                 if (!tline || tline->type != TOK_ID)
@@ -2100,7 +2274,7 @@ if_condition(Token * tline, int i)
                     free_tlist(origline);
                     return -1;
                 }
-                if (!nasm_stricmp(tline->text, cstk->name))
+                if (!nasm_stricmp(tline->text, pps->cstk->name))
                     j = TRUE;
                 tline = tline->next;
             }
@@ -2279,7 +2453,7 @@ if_condition(Token * tline, int i)
                 tline = tline->next;
                 searching.plus = TRUE;
             }
-            mmac = mmacros[hash(searching.name)];
+            mmac = *pps->mmacros.head(searching.name);
             while (mmac)
             {
                 if (!strcmp(mmac->name, searching.name) &&
@@ -2352,7 +2526,7 @@ if_condition(Token * tline, int i)
             t = tline = expand_smacro(tline);
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass | CRITICAL,
+            evalresult = pps->evaluate(ppscan, tptr, &tokval, pps->pass | CRITICAL,
                                   error);
             free_tlist(tline);
             if (!evalresult)
@@ -2360,7 +2534,7 @@ if_condition(Token * tline, int i)
             if (tokval.t_type)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            evalresult->Simplify(pps->yasm_preproc->getDiagnostics());
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL,
@@ -2416,7 +2590,7 @@ do_directive(Token * tline)
     Context *ctx;
     Cond *cond;
     SMacro *smac, **smhead;
-    MMacro *mmac;
+    MMacro *mmac, **mmhead;
     Token *t, *tt, *param_start, *macro_start, *last, **tptr, *origline;
     Line *l;
     struct tokenval tokval;
@@ -2425,6 +2599,10 @@ do_directive(Token * tline)
 
     origline = tline;
 
+    /* No chain pointers are held here, so the macro tables may grow */
+    pps->smacros.resize();
+    pps->mmacros.resize();
+
     skip_white_(tline);
     if (!tok_type_(tline, TOK_PREPROC_ID) ||
             (tline->text[1] == '%' || tline->text[1] == '$'
@@ -2438,7 +2616,7 @@ do_directive(Token * tline)
         k = (j + i) / 2;
         m = nasm_stricmp(tline->text, directives[k]);
         if (m == 0) {
-                if (tasm_compatible_mode) {
+                if (pps->tasm_compatible_mode) {
                 i = k;
                 j = -2;
                 } else if (k != PP_ARG && k != PP_LOCAL && k != PP_STACKSIZE) {
@@ -2460,8 +2638,8 @@ do_directive(Token * tline)
      * we should ignore all directives except for condition
      * directives.
      */
-    if (((istk->conds && !emitting(istk->conds->state)) ||
-         (istk->mstk && !istk->mstk->in_progress)) &&
+    if (((pps->istk->conds && !emitting(pps->istk->conds->state)) ||
+         (pps->istk->mstk && !pps->istk->mstk->in_progress)) &&
         !is_condition(i))
     {
         return NO_DIRECTIVE_FOUND;
@@ -2474,30 +2652,30 @@ do_directive(Token * tline)
      * %rep block) %endrep. If we're in a %rep block, another %rep
      * causes an error, so should be let through.
      */
-    if (defining && i != PP_MACRO && i != PP_IMACRO &&
+    if (pps->defining && i != PP_MACRO && i != PP_IMACRO &&
             i != PP_ENDMACRO && i != PP_ENDM &&
-            (defining->name || (i != PP_ENDREP && i != PP_REP)))
+            (pps->defining->name || (i != PP_ENDREP && i != PP_REP)))
     {
         return NO_DIRECTIVE_FOUND;
     }
 
-    if (defining) {
+    if (pps->defining) {
         if (i == PP_MACRO || i == PP_IMACRO) {
-            nested_mac_count++;
+            pps->nested_mac_count++;
             return NO_DIRECTIVE_FOUND;
-        } else if (nested_mac_count > 0) {
+        } else if (pps->nested_mac_count > 0) {
             if (i == PP_ENDMACRO) {
-                nested_mac_count--;
+                pps->nested_mac_count--;
                 return NO_DIRECTIVE_FOUND;
             }
         }
-        if (!defining->name) {
+        if (!pps->defining->name) {
             if (i == PP_REP) {
-                nested_rep_count++;
+                pps->nested_rep_count++;
                 return NO_DIRECTIVE_FOUND;
-            } else if (nested_rep_count > 0) {
+            } else if (pps->nested_rep_count > 0) {
                 if (i == PP_ENDREP) {
-                    nested_rep_count--;
+                    pps->nested_rep_count--;
                     return NO_DIRECTIVE_FOUND;
                 }
             }
@@ -2533,30 +2711,30 @@ do_directive(Token * tline)
             if (nasm_stricmp(tline->text, "flat") == 0)
             {
                 /* All subsequent ARG directives are for a 32-bit stack */
-                StackSize = 4;
-                StackPointer = "ebp";
-                ArgOffset = 8;
-                LocalOffset = 4;
+                pps->StackSize = 4;
+                pps->StackPointer = "ebp";
+                pps->ArgOffset = 8;
+                pps->LocalOffset = 4;
             }
             else if (nasm_stricmp(tline->text, "large") == 0)
             {
                 /* All subsequent ARG directives are for a 16-bit stack,
                  * far function call.
                  */
-                StackSize = 2;
-                StackPointer = "bp";
-                ArgOffset = 4;
-                LocalOffset = 2;
+                pps->StackSize = 2;
+                pps->StackPointer = "bp";
+                pps->ArgOffset = 4;
+                pps->LocalOffset = 2;
             }
             else if (nasm_stricmp(tline->text, "small") == 0)
             {
                 /* All subsequent ARG directives are for a 16-bit stack,
                    * far function call. We don't support near functions.
                  */
-                StackSize = 2;
-                StackPointer = "bp";
-                ArgOffset = 6;
-                LocalOffset = 2;
+                pps->StackSize = 2;
+                pps->StackPointer = "bp";
+                pps->ArgOffset = 6;
+                pps->LocalOffset = 2;
             }
             else
             {
@@ -2573,11 +2751,11 @@ do_directive(Token * tline)
              *
              *      ARG arg1:WORD, arg2:DWORD, arg4:QWORD
              */
-            offset = ArgOffset;
+            offset = pps->ArgOffset;
             do
             {
                 char *arg, directive[256];
-                int size = StackSize;
+                int size = pps->StackSize;
 
                 /* Find the argument name */
                 tline = tline->next;
@@ -2615,23 +2793,23 @@ do_directive(Token * tline)
                 tt = expand_smacro(tt);
                 if (nasm_stricmp(tt->text, "byte") == 0)
                 {
-                    size = MAX(StackSize, 1);
+                    size = MAX(pps->StackSize, 1);
                 }
                 else if (nasm_stricmp(tt->text, "word") == 0)
                 {
-                    size = MAX(StackSize, 2);
+                    size = MAX(pps->StackSize, 2);
                 }
                 else if (nasm_stricmp(tt->text, "dword") == 0)
                 {
-                    size = MAX(StackSize, 4);
+                    size = MAX(pps->StackSize, 4);
                 }
                 else if (nasm_stricmp(tt->text, "qword") == 0)
                 {
-                    size = MAX(StackSize, 8);
+                    size = MAX(pps->StackSize, 8);
                 }
                 else if (nasm_stricmp(tt->text, "tword") == 0)
                 {
-                    size = MAX(StackSize, 10);
+                    size = MAX(pps->StackSize, 10);
                 }
                 else
                 {
@@ -2644,7 +2822,7 @@ do_directive(Token * tline)
                 free_tlist(tt);
 
                 /* Now define the macro for the argument */
-                sprintf(directive, "%%define %s (%s+%d)", arg, StackPointer,
+                sprintf(directive, "%%define %s (%s+%d)", arg, pps->StackPointer,
                         offset);
                 do_directive(tokenise(directive));
                 offset += size;
@@ -2669,11 +2847,11 @@ do_directive(Token * tline)
              * required by TASM to define the local parameter size (and used
              * by the TASM macro package).
              */
-            offset = LocalOffset;
+            offset = pps->LocalOffset;
             do
             {
                 char *local, directive[256];
-                int size = StackSize;
+                int size = pps->StackSize;
 
                 /* Find the argument name */
                 tline = tline->next;
@@ -2712,23 +2890,23 @@ do_directive(Token * tline)
                 tt = expand_smacro(tt);
                 if (nasm_stricmp(tt->text, "byte") == 0)
                 {
-                    size = MAX(StackSize, 1);
+                    size = MAX(pps->StackSize, 1);
                 }
                 else if (nasm_stricmp(tt->text, "word") == 0)
                 {
-                    size = MAX(StackSize, 2);
+                    size = MAX(pps->StackSize, 2);
                 }
                 else if (nasm_stricmp(tt->text, "dword") == 0)
                 {
-                    size = MAX(StackSize, 4);
+                    size = MAX(pps->StackSize, 4);
                 }
                 else if (nasm_stricmp(tt->text, "qword") == 0)
                 {
-                    size = MAX(StackSize, 8);
+                    size = MAX(pps->StackSize, 8);
                 }
                 else if (nasm_stricmp(tt->text, "tword") == 0)
                 {
-                    size = MAX(StackSize, 10);
+                    size = MAX(pps->StackSize, 10);
                 }
                 else
                 {
@@ -2741,7 +2919,7 @@ do_directive(Token * tline)
                 free_tlist(tt);
 
                 /* Now define the macro for the argument */
-                sprintf(directive, "%%define %s (%s-%d)", local, StackPointer,
+                sprintf(directive, "%%define %s (%s-%d)", local, pps->StackPointer,
                         offset);
                 do_directive(tokenise(directive));
                 offset += size;
@@ -2765,23 +2943,7 @@ do_directive(Token * tline)
             if (tline->next)
                 error(ERR_WARNING,
                         "trailing garbage after `%%clear' ignored");
-            for (j = 0; j < NHASH; j++)
-            {
-                while (mmacros[j])
-                {
-                    MMacro *m2 = mmacros[j];
-                    mmacros[j] = m2->next;
-                    free_mmacro(m2);
-                }
-                while (smacros[j])
-                {
-                    SMacro *s = smacros[j];
-                    smacros[j] = smacros[j]->next;
-                    nasm_free(s->name);
-                    free_tlist(s->expansion);
-                    nasm_free(s);
-                }
-            }
+            free_macros();
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -2808,11 +2970,11 @@ do_directive(Token * tline)
                 p = tline->text;        /* internal_string is easier */
             expand_macros_in_string(&p);
             inc = (Include*)nasm_malloc(sizeof(Include));
-            inc->next = istk;
+            inc->next = pps->istk;
             inc->conds = NULL;
             const DirectoryLookup* to_dir;
             FileID to_file;
-            inc->in = inc_fopen(p, istk->cur_dir, to_dir, istk->fid, to_file);
+            inc->in = inc_fopen(p, pps->istk->cur_dir, to_dir, pps->istk->fid, to_file);
             inc->fid = to_file;
             inc->cur_dir = to_dir;
             inc->pos = 0;
@@ -2821,7 +2983,7 @@ do_directive(Token * tline)
             inc->lineinc = 1;
             inc->expansion = NULL;
             inc->mstk = NULL;
-            istk = inc;
+            pps->istk = inc;
             //list->uplevel(LIST_INCLUDE);
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -2840,11 +3002,11 @@ do_directive(Token * tline)
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%push' ignored");
             ctx = (Context*)nasm_malloc(sizeof(Context));
-            ctx->next = cstk;
+            ctx->next = pps->cstk;
             ctx->localmac = NULL;
             ctx->name = nasm_strdup(tline->text);
-            ctx->number = unique++;
-            cstk = ctx;
+            ctx->number = pps->unique++;
+            pps->cstk = ctx;
             free_tlist(origline);
             break;
 
@@ -2860,12 +3022,12 @@ do_directive(Token * tline)
             }
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%repl' ignored");
-            if (!cstk)
+            if (!pps->cstk)
                 error(ERR_NONFATAL, "`%%repl': context stack is empty");
             else
             {
-                nasm_free(cstk->name);
-                cstk->name = nasm_strdup(tline->text);
+                nasm_free(pps->cstk->name);
+                pps->cstk->name = nasm_strdup(tline->text);
             }
             free_tlist(origline);
             break;
@@ -2873,7 +3035,7 @@ do_directive(Token * tline)
         case PP_POP:
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%pop' ignored");
-            if (!cstk)
+            if (!pps->cstk)
                 error(ERR_NONFATAL,
                         "`%%pop': context stack is already empty");
             else
@@ -2884,25 +3046,25 @@ do_directive(Token * tline)
         case PP_SCOPE:
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%scope' ignored");
-            Level++;
+            pps->Level++;
             free_tlist(origline);
             break;
 
         case PP_ENDSCOPE:
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%endscope' ignored");
-            if (!Level)
+            if (!pps->Level)
                 error(ERR_NONFATAL,
                         "`%%endscope': already popped all levels");
             else
             {
-                for (k = 0; k < NHASH; k++)
+                for (k = 0; k < (int)pps->smacros.size; k++)
                 {
-                    SMacro **smlast = &smacros[k];
-                    smac = smacros[k];
+                    SMacro **smlast = &pps->smacros.buckets[k];
+                    smac = *smlast;
                     while (smac)
                     {
-                        if (smac->level < Level)
+                        if (smac->level < pps->Level)
                         {
                             smlast = &smac->next;
                             smac = smac->next;
@@ -2914,16 +3076,17 @@ do_directive(Token * tline)
                             free_tlist(smac->expansion);
                             nasm_free(smac);
                             smac = *smlast;
+                            pps->smacros.removed();
                         }
                     }
                 }
-                for (ctx = cstk; ctx; ctx = ctx->next)
+                for (ctx = pps->cstk; ctx; ctx = ctx->next)
                 {
                     SMacro **smlast = &ctx->localmac;
                     smac = ctx->localmac;
                     while (smac)
                     {
-                        if (smac->level < Level)
+                        if (smac->level < pps->Level)
                         {
                             smlast = &smac->next;
                             smac = smac->next;
@@ -2938,7 +3101,7 @@ do_directive(Token * tline)
                         }
                     }
                 }
-                Level--;
+                pps->Level--;
             }
             free_tlist(origline);
             break;
@@ -2981,7 +3144,7 @@ do_directive(Token * tline)
         case PP_IFNSTR:
         case PP_IFNUM:
         case PP_IFSTR:
-            if (istk->conds && !emitting(istk->conds->state))
+            if (pps->istk->conds && !emitting(pps->istk->conds->state))
                 j = COND_NEVER;
             else
             {
@@ -2991,9 +3154,9 @@ do_directive(Token * tline)
             }
             free_tlist(origline);
             cond = (Cond*)nasm_malloc(sizeof(Cond));
-            cond->next = istk->conds;
+            cond->next = pps->istk->conds;
             cond->state = j;
-            istk->conds = cond;
+            pps->istk->conds = cond;
             return DIRECTIVE_FOUND;
 
         case PP_ELIF:
@@ -3013,11 +3176,11 @@ do_directive(Token * tline)
         case PP_ELIFNSTR:
         case PP_ELIFNUM:
         case PP_ELIFSTR:
-            if (!istk->conds)
+            if (!pps->istk->conds)
                 error(ERR_FATAL, "`%s': no matching `%%if'", directives[i]);
-            if (emitting(istk->conds->state)
-                    || istk->conds->state == COND_NEVER)
-                istk->conds->state = COND_NEVER;
+            if (emitting(pps->istk->conds->state)
+                    || pps->istk->conds->state == COND_NEVER)
+                pps->istk->conds->state = COND_NEVER;
             else
             {
                 /*
@@ -3030,7 +3193,7 @@ do_directive(Token * tline)
                  */
                 j = if_condition(expand_mmac_params(tline->next), i);
                 tline->next = NULL; /* it got freed */
-                istk->conds->state =
+                pps->istk->conds->state =
                         j < 0 ? COND_NEVER : j ? COND_IF_TRUE : COND_IF_FALSE;
             }
             free_tlist(origline);
@@ -3039,13 +3202,13 @@ do_directive(Token * tline)
         case PP_ELSE:
             if (tline->next)
                 error(ERR_WARNING, "trailing garbage after `%%else' ignored");
-            if (!istk->conds)
+            if (!pps->istk->conds)
                 error(ERR_FATAL, "`%%else': no matching `%%if'");
-            if (emitting(istk->conds->state)
-                    || istk->conds->state == COND_NEVER)
-                istk->conds->state = COND_ELSE_FALSE;
+            if (emitting(pps->istk->conds->state)
+                    || pps->istk->conds->state == COND_NEVER)
+                pps->istk->conds->state = COND_ELSE_FALSE;
             else
-                istk->conds->state = COND_ELSE_TRUE;
+                pps->istk->conds->state = COND_ELSE_TRUE;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3053,17 +3216,17 @@ do_directive(Token * tline)
             if (tline->next)
                 error(ERR_WARNING,
                         "trailing garbage after `%%endif' ignored");
-            if (!istk->conds)
+            if (!pps->istk->conds)
                 error(ERR_FATAL, "`%%endif': no matching `%%if'");
-            cond = istk->conds;
-            istk->conds = cond->next;
+            cond = pps->istk->conds;
+            pps->istk->conds = cond->next;
             nasm_free(cond);
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
         case PP_MACRO:
         case PP_IMACRO:
-            if (defining)
+            if (pps->defining)
                 error(ERR_FATAL,
                         "`%%%smacro': already defining a macro",
                         (i == PP_IMACRO ? "i" : ""));
@@ -3077,13 +3240,13 @@ do_directive(Token * tline)
                         (i == PP_IMACRO ? "i" : ""));
                 return DIRECTIVE_FOUND;
             }
-            defining = (MMacro*)nasm_malloc(sizeof(MMacro));
-            defining->name = nasm_strdup(tline->text);
-            defining->casesense = (i == PP_MACRO);
-            defining->plus = FALSE;
-            defining->nolist = FALSE;
-            defining->in_progress = FALSE;
-            defining->rep_nest = NULL;
+            pps->defining = (MMacro*)nasm_malloc(sizeof(MMacro));
+            pps->defining->name = nasm_strdup(tline->text);
+            pps->defining->casesense = (i == PP_MACRO);
+            pps->defining->plus = FALSE;
+            pps->defining->nolist = FALSE;
+            pps->defining->in_progress = FALSE;
+            pps->defining->rep_nest = NULL;
             tline = expand_smacro(tline->next);
             skip_white_(tline);
             if (!tok_type_(tline, TOK_NUMBER))
@@ -3091,12 +3254,12 @@ do_directive(Token * tline)
                 error(ERR_NONFATAL,
                         "`%%%smacro' expects a parameter count",
                         (i == PP_IMACRO ? "i" : ""));
-                defining->nparam_min = defining->nparam_max = 0;
+                pps->defining->nparam_min = pps->defining->nparam_max = 0;
             }
             else
             {
                 IntNum intn = nasm_readnum(tline->text, &j);
-                defining->nparam_min = defining->nparam_max = intn.getInt();
+                pps->defining->nparam_min = pps->defining->nparam_max = intn.getInt();
                 if (j)
                     error(ERR_NONFATAL,
                             "unable to parse parameter count `%s'",
@@ -3106,7 +3269,7 @@ do_directive(Token * tline)
             {
                 tline = tline->next->next;
                 if (tok_is_(tline, "*"))
-                    defining->nparam_max = INT_MAX;
+                    pps->defining->nparam_max = INT_MAX;
                 else if (!tok_type_(tline, TOK_NUMBER))
                     error(ERR_NONFATAL,
                             "`%%%smacro' expects a parameter count after `-'",
@@ -3114,12 +3277,12 @@ do_directive(Token * tline)
                 else
                 {
                     IntNum intn = nasm_readnum(tline->text, &j);
-                    defining->nparam_max = intn.getInt();
+                    pps->defining->nparam_max = intn.getInt();
                     if (j)
                         error(ERR_NONFATAL,
                                 "unable to parse parameter count `%s'",
                                 tline->text);
-                    if (defining->nparam_min > defining->nparam_max)
+                    if (pps->defining->nparam_min > pps->defining->nparam_max)
                         error(ERR_NONFATAL,
                                 "minimum parameter count exceeds maximum");
                 }
@@ -3127,26 +3290,26 @@ do_directive(Token * tline)
             if (tline && tok_is_(tline->next, "+"))
             {
                 tline = tline->next;
-                defining->plus = TRUE;
+                pps->defining->plus = TRUE;
             }
             if (tline && tok_type_(tline->next, TOK_ID) &&
                     !nasm_stricmp(tline->next->text, ".nolist"))
             {
                 tline = tline->next;
-                defining->nolist = TRUE;
+                pps->defining->nolist = TRUE;
             }
-            mmac = mmacros[hash(defining->name)];
+            mmac = *pps->mmacros.head(pps->defining->name);
             while (mmac)
             {
-                if (!strcmp(mmac->name, defining->name) &&
-                        (mmac->nparam_min <= defining->nparam_max
-                                || defining->plus)
-                        && (defining->nparam_min <= mmac->nparam_max
+                if (!strcmp(mmac->name, pps->defining->name) &&
+                        (mmac->nparam_min <= pps->defining->nparam_max
+                                || pps->defining->plus)
+                        && (pps->defining->nparam_min <= mmac->nparam_max
                                 || mmac->plus))
                 {
                     error(ERR_WARNING,
                             "redefining multi-line macro `%s'",
-                            defining->name);
+                            pps->defining->name);
                     break;
                 }
                 mmac = mmac->next;
@@ -3156,32 +3319,33 @@ do_directive(Token * tline)
              */
             if (tline && tline->next)
             {
-                defining->dlist = tline->next;
+                pps->defining->dlist = tline->next;
                 tline->next = NULL;
-                count_mmac_params(defining->dlist, &defining->ndefs,
-                        &defining->defaults);
+                count_mmac_params(pps->defining->dlist, &pps->defining->ndefs,
+                        &pps->defining->defaults);
             }
             else
             {
-                defining->dlist = NULL;
-                defining->defaults = NULL;
+                pps->defining->dlist = NULL;
+                pps->defining->defaults = NULL;
             }
-            defining->expansion = NULL;
+            pps->defining->expansion = NULL;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
         case PP_ENDM:
         case PP_ENDMACRO:
-            if (!defining)
+            if (!pps->defining)
             {
                 error(ERR_NONFATAL, "`%s': not defining a macro",
                         tline->text);
                 return DIRECTIVE_FOUND;
             }
-            k = hash(defining->name);
-            defining->next = mmacros[k];
-            mmacros[k] = defining;
-            defining = NULL;
+            mmhead = pps->mmacros.head(pps->defining->name);
+            pps->defining->next = *mmhead;
+            *mmhead = pps->defining;
+            pps->mmacros.added();
+            pps->defining = NULL;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3200,21 +3364,21 @@ do_directive(Token * tline)
             tline = t;
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = pps->evaluate(ppscan, tptr, &tokval, pps->pass, error);
             free_tlist(tline);
             if (!evalresult)
                 return DIRECTIVE_FOUND;
             if (tokval.t_type)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            evalresult->Simplify(pps->yasm_preproc->getDiagnostics());
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL, "non-constant value given to `%%rotate'");
                 delete evalresult;
                 return DIRECTIVE_FOUND;
             }
-            mmac = istk->mstk;
+            mmac = pps->istk->mstk;
             while (mmac && !mmac->name) /* avoid mistaking %reps for macros */
                 mmac = mmac->next_active;
             if (!mmac)
@@ -3259,7 +3423,7 @@ do_directive(Token * tline)
                 t = expand_smacro(tline);
                 tptr = &t;
                 tokval.t_type = TOKEN_INVALID;
-                evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+                evalresult = pps->evaluate(ppscan, tptr, &tokval, pps->pass, error);
                 if (!evalresult)
                 {
                     free_tlist(origline);
@@ -3268,7 +3432,7 @@ do_directive(Token * tline)
                 if (tokval.t_type)
                     error(ERR_WARNING,
                           "trailing garbage after expression ignored");
-                evalresult->Simplify(yasm_preproc->getDiagnostics());
+                evalresult->Simplify(pps->yasm_preproc->getDiagnostics());
                 if (!evalresult->isIntNum())
                 {
                     error(ERR_NONFATAL, "non-constant value given to `%%rep'");
@@ -3285,23 +3449,23 @@ do_directive(Token * tline)
             }
             free_tlist(origline);
 
-            tmp_defining = defining;
-            defining = (MMacro*)nasm_malloc(sizeof(MMacro));
-            defining->name = NULL;      /* flags this macro as a %rep block */
-            defining->casesense = 0;
-            defining->plus = FALSE;
-            defining->nolist = nolist;
-            defining->in_progress = i;
-            defining->nparam_min = defining->nparam_max = 0;
-            defining->defaults = NULL;
-            defining->dlist = NULL;
-            defining->expansion = NULL;
-            defining->next_active = istk->mstk;
-            defining->rep_nest = tmp_defining;
+            tmp_defining = pps->defining;
+            pps->defining = (MMacro*)nasm_malloc(sizeof(MMacro));
+            pps->defining->name = NULL;      /* flags this macro as a %rep block */
+            pps->defining->casesense = 0;
+            pps->defining->plus = FALSE;
+            pps->defining->nolist = nolist;
+            pps->defining->in_progress = i;
+            pps->defining->nparam_min = pps->defining->nparam_max = 0;
+            pps->defining->defaults = NULL;
+            pps->defining->dlist = NULL;
+            pps->defining->expansion = NULL;
+            pps->defining->next_active = pps->istk->mstk;
+            pps->defining->rep_nest = tmp_defining;
             return DIRECTIVE_FOUND;
 
         case PP_ENDREP:
-            if (!defining || defining->name)
+            if (!pps->defining || pps->defining->name)
             {
                 error(ERR_NONFATAL, "`%%endrep': no matching `%%rep'");
                 return DIRECTIVE_FOUND;
@@ -3319,16 +3483,16 @@ do_directive(Token * tline)
              * from istk->expansion by a %exitrep.
              */
             l = (Line*)nasm_malloc(sizeof(Line));
-            l->next = istk->expansion;
-            l->finishes = defining;
+            l->next = pps->istk->expansion;
+            l->finishes = pps->defining;
             l->first = NULL;
-            istk->expansion = l;
+            pps->istk->expansion = l;
 
-            istk->mstk = defining;
+            pps->istk->mstk = pps->defining;
 
             //list->uplevel(defining->nolist ? LIST_MACRO_NOLIST : LIST_MACRO);
-            tmp_defining = defining;
-            defining = defining->rep_nest;
+            tmp_defining = pps->defining;
+            pps->defining = pps->defining->rep_nest;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3338,7 +3502,7 @@ do_directive(Token * tline)
              * macro-end marker for a macro with no name. Then we set
              * its `in_progress' flag to 0.
              */
-            for (l = istk->expansion; l; l = l->next)
+            for (l = pps->istk->expansion; l; l = l->next)
                 if (l->finishes && !l->finishes->name)
                     break;
 
@@ -3370,7 +3534,7 @@ do_directive(Token * tline)
 
             ctx = get_ctx(tline->text, FALSE);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = pps->smacros.head(tline->text);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3464,7 +3628,7 @@ do_directive(Token * tline)
                     free_tlist(macro_start);
                     return DIRECTIVE_FOUND;
                 }
-                else if (smac->level == Level)
+                else if (smac->level == pps->Level)
                 {
                     /*
                      * We're redefining in the same level, so we have to 
@@ -3479,6 +3643,8 @@ do_directive(Token * tline)
                     smac = (SMacro*)nasm_malloc(sizeof(SMacro));
                     smac->next = *smhead;
                     *smhead = smac;
+                    if (!ctx)
+                        pps->smacros.added();
                 }
             }
             else
@@ -3486,11 +3652,13 @@ do_directive(Token * tline)
                 smac = (SMacro*)nasm_malloc(sizeof(SMacro));
                 smac->next = *smhead;
                 *smhead = smac;
+                if (!ctx)
+                    pps->smacros.added();
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = ((i == PP_DEFINE) || (i == PP_XDEFINE));
             smac->nparam = nparam;
-            smac->level = Level;
+            smac->level = pps->Level;
             smac->expansion = macro_start;
             smac->in_progress = FALSE;
             free_tlist(origline);
@@ -3517,7 +3685,7 @@ do_directive(Token * tline)
             /* Find the context that symbol belongs to */
             ctx = get_ctx(tline->text, FALSE);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = pps->smacros.head(tline->text);
             else
                 smhead = &ctx->localmac;
 
@@ -3534,6 +3702,8 @@ do_directive(Token * tline)
                 if (*s)
                 {
                     *s = smac->next;
+                    if (!ctx)
+                        pps->smacros.removed();
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
                     nasm_free(smac);
@@ -3557,7 +3727,7 @@ do_directive(Token * tline)
             }
             ctx = get_ctx(tline->text, FALSE);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = pps->smacros.head(tline->text);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3610,6 +3780,8 @@ do_directive(Token * tline)
                 smac = (SMacro*)nasm_malloc(sizeof(SMacro));
                 smac->next = *smhead;
                 *smhead = smac;
+                if (!ctx)
+                    pps->smacros.added();
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_STRLEN);
@@ -3637,7 +3809,7 @@ do_directive(Token * tline)
             }
             ctx = get_ctx(tline->text, FALSE);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = pps->smacros.head(tline->text);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3662,14 +3834,14 @@ do_directive(Token * tline)
             tt = t->next;
             tptr = &tt;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = pps->evaluate(ppscan, tptr, &tokval, pps->pass, error);
             if (!evalresult)
             {
                 free_tlist(tline);
                 free_tlist(origline);
                 return DIRECTIVE_FOUND;
             }
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            evalresult->Simplify(pps->yasm_preproc->getDiagnostics());
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL, "non-constant value given to `%%substr`");
@@ -3722,6 +3894,8 @@ do_directive(Token * tline)
                 smac = (SMacro*)nasm_malloc(sizeof(SMacro));
                 smac->next = *smhead;
                 *smhead = smac;
+                if (!ctx)
+                    pps->smacros.added();
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_SUBSTR);
@@ -3751,7 +3925,7 @@ do_directive(Token * tline)
             }
             ctx = get_ctx(tline->text, FALSE);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = pps->smacros.head(tline->text);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3762,7 +3936,7 @@ do_directive(Token * tline)
             t = tline;
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = pps->evaluate(ppscan, tptr, &tokval, pps->pass, error);
             free_tlist(tline);
             if (!evalresult)
             {
@@ -3774,7 +3948,7 @@ do_directive(Token * tline)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
 
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            evalresult->Simplify(pps->yasm_preproc->getDiagnostics());
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL,
@@ -3818,6 +3992,8 @@ do_directive(Token * tline)
                 smac = (SMacro*)nasm_malloc(sizeof(SMacro));
                 smac->next = *smhead;
                 *smhead = smac;
+                if (!ctx)
+                    pps->smacros.added();
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_ASSIGN);
@@ -3857,7 +4033,7 @@ do_directive(Token * tline)
             }
             skip_white_(tline);
             nasm_src_set_linnum(k);
-            istk->lineinc = m;
+            pps->istk->lineinc = m;
             if (tline)
             {
                 nasm_free(nasm_src_set_fname(detoken(tline, FALSE)));
@@ -3948,7 +4124,7 @@ expand_mmac_params(Token * tline)
 
             second_text = strchr(t->text, ':');
 
-            mac = istk->mstk;
+            mac = pps->istk->mstk;
             while (mac && !mac->name)   /* avoid mistaking %reps for macros */
                 mac = mac->next_active;
             if (!mac)
@@ -4204,7 +4380,7 @@ expand_smacro(Token * tline)
             else
                 ctx = NULL;
             if (!ctx)
-                head = smacros[hash(mname)];
+                head = *pps->smacros.head(mname);
             else
                 head = ctx->localmac;
             /*
@@ -4613,7 +4789,7 @@ is_mmacro(Token * tline, Token *** params_array)
     Token **params;
     int nparam;
 
-    head = mmacros[hash(tline->text)];
+    head = *pps->mmacros.head(tline->text);
 
     /*
      * Efficiency: first we see if any macro exists with the given
@@ -4804,10 +4980,10 @@ expand_mmacro(Token * tline)
      * variables.
      */
     ll = (Line*)nasm_malloc(sizeof(Line));
-    ll->next = istk->expansion;
+    ll->next = pps->istk->expansion;
     ll->finishes = m;
     ll->first = NULL;
-    istk->expansion = ll;
+    pps->istk->expansion = ll;
 
     m->in_progress = TRUE;
     m->params = params;
@@ -4815,11 +4991,11 @@ expand_mmacro(Token * tline)
     m->nparam = nparam;
     m->rotate = 0;
     m->paramlen = paramlen;
-    m->unique = unique++;
+    m->unique = pps->unique++;
     m->lineno = 0;
 
-    m->next_active = istk->mstk;
-    istk->mstk = m;
+    m->next_active = pps->istk->mstk;
+    pps->istk->mstk = m;
 
     for (l = m->expansion; l; l = l->next)
     {
@@ -4827,8 +5003,8 @@ expand_mmacro(Token * tline)
 
         ll = (Line*)nasm_malloc(sizeof(Line));
         ll->finishes = NULL;
-        ll->next = istk->expansion;
-        istk->expansion = ll;
+        ll->next = pps->istk->expansion;
+        pps->istk->expansion = ll;
         tail = &ll->first;
 
         for (t = l->first; t; t = t->next)
@@ -4860,8 +5036,8 @@ expand_mmacro(Token * tline)
         {
             ll = (Line*)nasm_malloc(sizeof(Line));
             ll->finishes = NULL;
-            ll->next = istk->expansion;
-            istk->expansion = ll;
+            ll->next = pps->istk->expansion;
+            pps->istk->expansion = ll;
             ll->first = startline;
             if (!dont_prepend)
             {
@@ -4890,7 +5066,7 @@ error(int severity, const char *fmt, ...)
     char buff[1024];
 
     /* If we're in a dead branch of IF or something like it, ignore the error */
-    if (istk && istk->conds && !emitting(istk->conds->state))
+    if (pps->istk && pps->istk->conds && !emitting(pps->istk->conds->state))
         return;
 
     va_start(arg, fmt);
@@ -4901,11 +5077,11 @@ error(int severity, const char *fmt, ...)
 #endif
     va_end(arg);
 
-    if (istk && istk->mstk && istk->mstk->name)
-        _error(severity | ERR_PASS1, "(%s:%d) %s", istk->mstk->name,
-                istk->mstk->lineno, buff);
+    if (pps->istk && pps->istk->mstk && pps->istk->mstk->name)
+        pps->_error(severity | ERR_PASS1, "(%s:%d) %s", pps->istk->mstk->name,
+                pps->istk->mstk->lineno, buff);
     else 
-        _error(severity | ERR_PASS1, "%s", buff);
+        pps->_error(severity | ERR_PASS1, "%s", buff);
 }
 
 static void
@@ -4913,38 +5089,35 @@ pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval)
 {
     int h;
 
-    _error = errfunc;
-    cstk = NULL;
-    istk = (Include*)nasm_malloc(sizeof(Include));
-    istk->next = NULL;
-    istk->conds = NULL;
-    istk->expansion = NULL;
-    istk->mstk = NULL;
-    istk->fid = fid;
+    pps->_error = errfunc;
+    pps->cstk = NULL;
+    pps->istk = (Include*)nasm_malloc(sizeof(Include));
+    pps->istk->next = NULL;
+    pps->istk->conds = NULL;
+    pps->istk->expansion = NULL;
+    pps->istk->mstk = NULL;
+    pps->istk->fid = fid;
     bool invalid = false;
-    istk->in = yasm_preproc->getSourceManager()
+    pps->istk->in = pps->yasm_preproc->getSourceManager()
         .getBuffer(fid, SourceLocation(), &invalid);
-    istk->cur_dir = NULL;
-    istk->pos = 0;
-    istk->fname = NULL;
-    nasm_free(nasm_src_set_fname(nasm_strdup(istk->in->getBufferIdentifier())));
+    pps->istk->cur_dir = NULL;
+    pps->istk->pos = 0;
+    pps->istk->fname = NULL;
+    nasm_free(nasm_src_set_fname(nasm_strdup(pps->istk->in->getBufferIdentifier())));
     nasm_src_set_linnum(0);
-    istk->lineinc = 1;
-    defining = NULL;
-    nested_mac_count = 0;
-    nested_rep_count = 0;
-    for (h = 0; h < NHASH; h++)
-    {
-        mmacros[h] = NULL;
-        smacros[h] = NULL;
-    }
-    unique = 0;
-    if (tasm_compatible_mode) {
+    pps->istk->lineinc = 1;
+    pps->defining = NULL;
+    pps->nested_mac_count = 0;
+    pps->nested_rep_count = 0;
+    pps->mmacros.clear();
+    pps->smacros.clear();
+    pps->unique = 0;
+    if (pps->tasm_compatible_mode) {
         pp_extra_stdmac(tasm_compat_macros);
     }
-    evaluate = eval;
-    pass = apass;
-    first_line = 1;
+    pps->evaluate = eval;
+    pps->pass = apass;
+    pps->first_line = 1;
 }
 
 /*
@@ -4969,10 +5142,10 @@ poke_predef(Line *predef_lines)
             tail = &(*tail)->next;
         }
         l = (Line*)nasm_malloc(sizeof(Line));
-        l->next = istk->expansion;
+        l->next = pps->istk->expansion;
         l->first = head;
         l->finishes = FALSE;
-        istk->expansion = l;
+        pps->istk->expansion = l;
     }
 }
 
@@ -4990,20 +5163,20 @@ pp_getline(void)
          */
         tline = NULL;
 
-        if (first_line)
+        if (pps->first_line)
         {
             /* Reverse order */
-            poke_predef(predef);
-            poke_predef(stddef);
-            poke_predef(builtindef);
-            first_line = 0;
+            poke_predef(pps->predef);
+            poke_predef(pps->stddef);
+            poke_predef(pps->builtindef);
+            pps->first_line = 0;
         }
 
-        if (!istk)
+        if (!pps->istk)
             return NULL;
-        while (istk->expansion && istk->expansion->finishes)
+        while (pps->istk->expansion && pps->istk->expansion->finishes)
         {
-            Line *l = istk->expansion;
+            Line *l = pps->istk->expansion;
             if (!l->finishes->name && l->finishes->in_progress > 1)
             {
                 Line *ll;
@@ -5027,7 +5200,7 @@ pp_getline(void)
                     Token *t, *tt, **tail;
 
                     ll = (Line*)nasm_malloc(sizeof(Line));
-                    ll->next = istk->expansion;
+                    ll->next = pps->istk->expansion;
                     ll->finishes = NULL;
                     ll->first = NULL;
                     tail = &ll->first;
@@ -5041,7 +5214,7 @@ pp_getline(void)
                         }
                     }
 
-                    istk->expansion = ll;
+                    pps->istk->expansion = ll;
                 }
             }
             else
@@ -5053,13 +5226,13 @@ pp_getline(void)
                  * I'm too confused to work out how to recover
                  * sensibly from it.
                  */
-                if (defining)
+                if (pps->defining)
                 {
-                    if (defining->name)
+                    if (pps->defining->name)
                         error(ERR_PANIC, "defining with name in expansion");
-                    else if (istk->mstk->name)
+                    else if (pps->istk->mstk->name)
                         error(ERR_FATAL, "`%%rep' without `%%endrep' within"
-                                " expansion of macro `%s'", istk->mstk->name);
+                                " expansion of macro `%s'", pps->istk->mstk->name);
                 }
 
                 /*
@@ -5067,8 +5240,8 @@ pp_getline(void)
                  * istk->mstk and l->finishes
                  */
                 {
-                    MMacro *m = istk->mstk;
-                    istk->mstk = m->next_active;
+                    MMacro *m = pps->istk->mstk;
+                    pps->istk->mstk = m->next_active;
                     if (m->name)
                     {
                         /*
@@ -5084,7 +5257,7 @@ pp_getline(void)
                     else
                         free_mmacro(m);
                 }
-                istk->expansion = l->next;
+                pps->istk->expansion = l->next;
                 nasm_free(l);
                 //list->downlevel(LIST_MACRO);
             }
@@ -5092,14 +5265,14 @@ pp_getline(void)
         while (1)
         {                       /* until we get a line we can use */
 
-            if (istk->expansion)
+            if (pps->istk->expansion)
             {                   /* from a macro expansion */
                 char *p;
-                Line *l = istk->expansion;
-                if (istk->mstk)
-                    istk->mstk->lineno++;
+                Line *l = pps->istk->expansion;
+                if (pps->istk->mstk)
+                    pps->istk->mstk->lineno++;
                 tline = l->first;
-                istk->expansion = l->next;
+                pps->istk->expansion = l->next;
                 nasm_free(l);
                 p = detoken(tline, FALSE);
                 //list->line(LIST_MACRO, p);
@@ -5118,7 +5291,7 @@ pp_getline(void)
              * The current file has ended; work down the istk
              */
             {
-                Include *i = istk;
+                Include *i = pps->istk;
                 if (i->conds)
                     error(ERR_FATAL, "expected `%%endif' before end of file");
                 /* only set line and file name if there's a next node */
@@ -5127,12 +5300,12 @@ pp_getline(void)
                     nasm_src_set_linnum(i->lineno);
                     nasm_free(nasm_src_set_fname(nasm_strdup(i->fname)));
                 }
-                istk = i->next;
+                pps->istk = i->next;
                 //list->downlevel(LIST_INCLUDE);
                 nasm_free(i);
-                if (!istk)
+                if (!pps->istk)
                     return NULL;
-                if (istk->expansion && istk->expansion->finishes)
+                if (pps->istk->expansion && pps->istk->expansion->finishes)
                     break;
             }
         }
@@ -5147,7 +5320,7 @@ pp_getline(void)
          * condition, in which case we don't want to meddle with
          * anything.
          */
-        if (!defining && !(istk->conds && !emitting(istk->conds->state)))
+        if (!pps->defining && !(pps->istk->conds && !emitting(pps->istk->conds->state)))
             tline = expand_mmac_params(tline);
 
         /*
@@ -5157,7 +5330,7 @@ pp_getline(void)
         {
             continue;
         }
-        else if (defining)
+        else if (pps->defining)
         {
             /*
              * We're defining a multi-line macro. We emit nothing
@@ -5165,13 +5338,13 @@ pp_getline(void)
              * shove the tokenised line on to the macro definition.
              */
             Line *l = (Line*)nasm_malloc(sizeof(Line));
-            l->next = defining->expansion;
+            l->next = pps->defining->expansion;
             l->first = tline;
             l->finishes = FALSE;
-            defining->expansion = l;
+            pps->defining->expansion = l;
             continue;
         }
-        else if (istk->conds && !emitting(istk->conds->state))
+        else if (pps->istk->conds && !emitting(pps->istk->conds->state))
         {
             /*
              * We're in a non-emitting branch of a condition block.
@@ -5182,7 +5355,7 @@ pp_getline(void)
             free_tlist(tline);
             continue;
         }
-        else if (istk->mstk && !istk->mstk->in_progress)
+        else if (pps->istk->mstk && !pps->istk->mstk->in_progress)
         {
             /*
              * We're in a %rep block which has been terminated, so
@@ -5203,7 +5376,7 @@ pp_getline(void)
                 /*
                  * De-tokenise the line again, and emit it.
                  */
-                if (tasm_compatible_mode)
+                if (pps->tasm_compatible_mode)
                     tline = tasm_join_tokens(tline);
 
                 line = detoken(tline, TRUE);
@@ -5223,58 +5396,40 @@ pp_getline(void)
 static void
 pp_cleanup(int pass_)
 {
-    int h;
-
     if (pass_ == 1)
     {
-        if (defining)
+        if (pps->defining)
         {
             error(ERR_NONFATAL, "end of file while still defining macro `%s'",
-                    defining->name);
-            free_mmacro(defining);
+                    pps->defining->name);
+            free_mmacro(pps->defining);
         }
         return;
     }
-    while (cstk)
+    while (pps->cstk)
         ctx_pop();
-    for (h = 0; h < NHASH; h++)
+    free_macros();
+    while (pps->istk)
     {
-        while (mmacros[h])
-        {
-            MMacro *m = mmacros[h];
-            mmacros[h] = mmacros[h]->next;
-            free_mmacro(m);
-        }
-        while (smacros[h])
-        {
-            SMacro *s = smacros[h];
-            smacros[h] = smacros[h]->next;
-            nasm_free(s->name);
-            free_tlist(s->expansion);
-            nasm_free(s);
-        }
-    }
-    while (istk)
-    {
-        Include *i = istk;
-        istk = istk->next;
+        Include *i = pps->istk;
+        pps->istk = pps->istk->next;
         nasm_free(i->fname);
         nasm_free(i);
     }
-    while (cstk)
+    while (pps->cstk)
         ctx_pop();
     if (pass_ == 0)
         {
-                free_llist(builtindef);
-                free_llist(stddef);
-                free_llist(predef);
-                builtindef = NULL;
-                stddef = NULL;
-                predef = NULL;
-                freeTokens = NULL;
+                free_llist(pps->builtindef);
+                free_llist(pps->stddef);
+                free_llist(pps->predef);
+                pps->builtindef = NULL;
+                pps->stddef = NULL;
+                pps->predef = NULL;
+                pps->freeTokens = NULL;
                 delete_Blocks();
-                blocks.next = NULL;
-                blocks.chunk = NULL;
+                pps->blocks.next = NULL;
+                pps->blocks.chunk = NULL;
         }
 }
 
@@ -5289,10 +5444,10 @@ pp_pre_include(const char *fname)
     inc = new_Token(space, TOK_PREPROC_ID, "%include", 0);
 
     l = (Line*)nasm_malloc(sizeof(Line));
-    l->next = predef;
+    l->next = pps->predef;
     l->first = inc;
     l->finishes = FALSE;
-    predef = l;
+    pps->predef = l;
 }
 
 void
@@ -5312,10 +5467,10 @@ pp_pre_define(char *definition)
         *equals = '=';
 
     l = (Line*)nasm_malloc(sizeof(Line));
-    l->next = predef;
+    l->next = pps->predef;
     l->first = def;
     l->finishes = FALSE;
-    predef = l;
+    pps->predef = l;
 }
 
 void
@@ -5329,10 +5484,10 @@ pp_pre_undefine(char *definition)
     space->next = tokenise(definition);
 
     l = (Line*)nasm_malloc(sizeof(Line));
-    l->next = predef;
+    l->next = pps->predef;
     l->first = def;
     l->finishes = FALSE;
-    predef = l;
+    pps->predef = l;
 }
 
 void
@@ -5352,10 +5507,10 @@ pp_builtin_define(char *definition)
         *equals = '=';
 
     l = (Line*)nasm_malloc(sizeof(Line));
-    l->next = builtindef;
+    l->next = pps->builtindef;
     l->first = def;
     l->finishes = FALSE;
-    builtindef = l;
+    pps->builtindef = l;
 }
 
 void
@@ -5374,10 +5529,10 @@ pp_extra_stdmac(const char **macros)
         nasm_free(macro);
 
         l = (Line*)nasm_malloc(sizeof(Line));
-        l->next = stddef;
+        l->next = pps->stddef;
         l->first = t;
         l->finishes = FALSE;
-        stddef = l;
+        pps->stddef = l;
     }
 }
 
@@ -5390,6 +5545,91 @@ make_tok_num(Token * tok, const IntNum& val)
     tok->type = TOK_NUMBER;
 }
 
+PPState *
+pp_new_state(yasm::Preprocessor *preproc)
+{
+    PPState *state = new PPState;
+    state->yasm_preproc = preproc;
+    return state;
+}
+
+void
+pp_delete_state(PPState *state)
+{
+    PPState *prev = pps;
+    pps = state;
+    pp_cleanup(0);
+    nasm_free(pps->file_name);
+    pps = prev != state ? prev : NULL;
+    delete state;
+}
+
+void
+pp_set_state(PPState *state)
+{
+    pps = state;
+}
+
+void
+pp_set_object(yasm::Object *object)
+{
+    pps->yasm_object = object;
+}
+
+yasm::Object *
+pp_get_object(void)
+{
+    return pps->yasm_object;
+}
+
+yasm::Preprocessor *
+pp_get_preproc(void)
+{
+    return pps->yasm_preproc;
+}
+
+char *nasm_src_set_fname(char *newname) 
+{
+    char *oldname = pps->file_name;
+    pps->file_name = newname;
+    return oldname;
+}
+
+char *nasm_src_get_fname(void)
+{
+    return pps->file_name;
+}
+
+long nasm_src_set_linnum(long newline) 
+{
+    long oldline = pps->line_number;
+    pps->line_number = newline;
+    return oldline;
+}
+
+long nasm_src_get_linnum(void) 
+{
+    return pps->line_number;
+}
+
+int nasm_src_get(long *xline, char **xname) 
+{
+    if (!pps->file_name || !*xname || strcmp(*xname, pps->file_name)) 
+    {
+        nasm_free(*xname);
+        *xname = pps->file_name ? nasm_strdup(pps->file_name) : NULL;
+        *xline = pps->line_number;
+        return -2;
+    }
+    if (*xline != pps->line_number) 
+    {
+        long tmp = pps->line_number - *xline;
+        *xline = pps->line_number;
+        return tmp;
+    }
+    return 0;
+}
+
 Preproc nasmpp = {
     pp_reset,
     pp_getline,
@@ -9,7 +9,7 @@
 #ifndef YASM_NASM_PREPROC_H
 #define YASM_NASM_PREPROC_H
 
-namespace yasm { class Preprocessor; }
+namespace yasm { class Object; class Preprocessor; }
 
 namespace nasm {
 
@@ -20,7 +20,22 @@ void pp_builtin_define (char *);
 void pp_extra_stdmac (const char **);
 
 extern Preproc nasmpp;
-extern yasm::Preprocessor* yasm_preproc;
+
+/*
+ * Preprocessor state.  All of nasmpp's mutable state lives in a PPState;
+ * the preprocessor operates on whichever state was last made current on
+ * the calling thread with pp_set_state().
+ */
+struct PPState;
+
+PPState *pp_new_state(yasm::Preprocessor *preproc);
+void pp_delete_state(PPState *state);
+void pp_set_state(PPState *state);
+
+/* Accessors for the current state. */
+void pp_set_object(yasm::Object *object);
+yasm::Object *pp_get_object(void);
+yasm::Preprocessor *pp_get_preproc(void);
 
 void nasm_preproc_add_dep(char *);
 
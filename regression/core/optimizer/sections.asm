@@ -0,0 +1,19 @@
+; [yasm -f bin -j 3]
+; Each section is optimized separately.
+section .text
+a: jmp b
+times 126 nop
+b: jmp a
+c: jz d
+times 10 nop
+d:
+section .data
+e: jmp f
+times 200 nop
+f: jmp e
+align 16
+g: jmp g
+section foo
+h: jmp i
+times 127 nop
+i:
@@ -0,0 +1,12 @@
+; [yasm -f bin -j 3]
+; The times count depends on a distance in a later section, so the
+; sections must be optimized together.
+section .text
+a: jmp b
+times (d - c) nop
+b: jmp a
+section .data
+c: jmp e
+times 120 nop
+e: jmp c
+d:
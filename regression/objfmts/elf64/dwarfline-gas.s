@@ -0,0 +1,12 @@
+# [yasm -p gas -f elf64 -g dwarf2]
+# Each instruction gets its own line row, including runs of instructions
+# whose bytes share one bytecode.
+.text
+start:
+	movl %ebx, %eax
+	addl %ecx, %eax
+
+	incq %r8
+	jmp start
+	xorl %eax, %eax
+	ret
@@ -0,0 +1,14 @@
+; [yasm -p nasm -f elf64 -g dwarf2]
+; Each instruction gets its own line row, including runs of instructions
+; whose bytes share one bytecode.
+[bits 64]
+section .text
+start:
+	mov eax, ebx
+	add eax, ecx
+
+	inc r8
+	jmp start
+	xor eax, eax
+	dd 0
+	ret
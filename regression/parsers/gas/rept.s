@@ -0,0 +1,33 @@
+# Repeated and nested .rept blocks
+.rept 3
+.byte 1				# out: 01 02 00 03 00 02 00 03 00 04
+.rept 2				# out: 01 02 00 03 00 02 00 03 00 04
+.word 2, 3			# out: 01 02 00 03 00 02 00 03 00 04
+.endr
+.rept 0
+.long 99
+.endr
+.byte 4
+.endr
+.rept 1
+.quad 5				# out: 05 00 00 00 00 00 00 00
+.endr
+.rept 0
+.endr
+.rept 4
+.endr
+.byte 6				# out: 06
+label: .rept 2
+.byte label-.			# out: 00 ff
+.endr
+.rept 2
+.if 0
+.byte 8
+.endif
+.byte 7				# out: 07 07
+.endr
+.rept 2
+.rept 2
+.byte 9				# out: 09 09 09 09
+.endr
+.endr
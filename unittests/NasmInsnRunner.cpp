@@ -188,7 +188,7 @@ NasmInsnRunner::ParseAndTestLine(const char* filename,
                                  const llvm::StringRef& line,
                                  int linenum)
 {
-    SCOPED_TRACE(llvm::format("%s:%d", filename, linenum));
+    SCOPED_TRACE(::testing::Message() << filename << ":" << linenum);
 
     llvm::StringRef insn_in, golden_in;
     llvm::tie(insn_in, golden_in) = line.split(';');
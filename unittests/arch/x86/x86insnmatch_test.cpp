@@ -0,0 +1,270 @@
+//
+//  Copyright (C) 2009  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/Path.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/System/plugin.h"
+
+#include "unittests/unittest_config.h"
+#include "unittests/unittest_util.h"
+
+
+using namespace yasm;
+
+namespace {
+
+// Records the ID and location of each diagnostic.
+class RecordingDiagConsumer : public DiagnosticConsumer
+{
+public:
+    void HandleDiagnostic(DiagnosticsEngine::Level level,
+                          const Diagnostic& info)
+    {
+        m_diags.push_back(info.getID());
+        m_diags.push_back(info.getLocation().getRawEncoding());
+    }
+    DiagnosticConsumer* clone(DiagnosticsEngine& diags) const
+    {
+        return new RecordingDiagConsumer;
+    }
+
+    std::vector<unsigned int> m_diags;
+};
+
+struct Result
+{
+    bool ok;
+    std::string output;
+    std::vector<unsigned int> diags;
+};
+
+struct Source
+{
+    std::string name;
+    std::string text;
+    bool gas;
+};
+
+// Assemble a source to a flat binary, with the given arch variable set.
+void
+Assemble(const Source& source, const char* var, bool value, Result* result)
+{
+    RecordingDiagConsumer consumer;
+    yasmunit::AssembleOptions options;
+    options.parser = source.gas ? "gas" : "nasm";
+    options.source_name = source.name;
+    options.arch_var = var;
+    options.arch_value = value;
+    options.consumer = &consumer;
+    result->ok = yasmunit::Assemble(source.text, options, &result->output);
+    result->diags.swap(consumer.m_diags);
+}
+
+// Instruction tests, plus the x86 regression tests (which include GAS
+// sources).
+std::vector<Source>
+GetCorpus()
+{
+    static const char* dirs[] =
+    {
+        "/unittests/arch/x86/insn/",
+        "/regression/arch/x86/"
+    };
+
+    std::string srcdir;
+    if (const char* srcdirc = getenv("CMAKE_SOURCE_DIR"))
+        srcdir = srcdirc;
+    else
+        srcdir = CMAKE_SOURCE_DIR;
+
+    std::vector<Source> v;
+    for (unsigned int i=0; i<sizeof(dirs)/sizeof(dirs[0]); ++i)
+    {
+        using llvm::sys::Path;
+        Path srcpath(srcdir + dirs[i]);
+        std::set<Path> paths;
+        if (srcpath.getDirectoryContents(paths, NULL))
+            continue;
+
+        for (std::set<Path>::const_iterator j=paths.begin(),
+             end=paths.end(); j != end; ++j)
+        {
+            llvm::StringRef ext = llvm::sys::path::extension(j->str());
+            if (ext != ".asm" && ext != ".s")
+                continue;
+            llvm::OwningPtr<llvm::MemoryBuffer> buf;
+            if (llvm::MemoryBuffer::getFile(j->str(), buf))
+                continue;
+            Source source;
+            source.name = j->str();
+            source.text = buf->getBuffer();
+            source.gas = (ext == ".s");
+            v.push_back(source);
+        }
+    }
+    return v;
+}
+
+class X86InsnMatchTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_TRUE(LoadStandardPlugins());
+    }
+};
+
+// Matching through the dispatch index must select exactly the same forms
+// (and report the same errors) as a linear search of each group.
+TEST_F(X86InsnMatchTest, IndexMatchesLinear)
+{
+    std::vector<Source> corpus = GetCorpus();
+    ASSERT_FALSE(corpus.empty());
+
+    for (std::vector<Source>::const_iterator i=corpus.begin(),
+         end=corpus.end(); i != end; ++i)
+    {
+        Result linear, indexed;
+        Assemble(*i, "match_index", false, &linear);
+        Assemble(*i, "match_index", true, &indexed);
+        EXPECT_EQ(linear.ok, indexed.ok) << i->name;
+        EXPECT_TRUE(linear.output == indexed.output) << i->name;
+        EXPECT_TRUE(linear.diags == indexed.diags) << i->name;
+    }
+}
+
+// Instructions from large groups (mov, push, test, etc.) go through the
+// index's operand dispatch; check the selected encodings directly.
+TEST_F(X86InsnMatchTest, LargeGroups)
+{
+    static const struct
+    {
+        const char* line;
+        const char* bytes;
+        unsigned int len;
+    } insns[] =
+    {
+        {"mov eax, ebx",        "\x89\xd8", 2},
+        {"mov rax, [rbx+8]",    "\x48\x8b\x43\x08", 4},
+        {"mov es, ax",          "\x8e\xc0", 2},
+        {"mov cr0, rax",        "\x0f\x22\xc0", 3},
+        {"push rbx",            "\x53", 1},
+        {"push 100",            "\x6a\x64", 2},
+        {"test al, 1",          "\xa8\x01", 2},
+        {"imul eax, ebx, 10",   "\x6b\xc3\x0a", 3},
+        {"shl rdx, cl",         "\x48\xd3\xe2", 3},
+        {"in al, dx",           "\xec", 1},
+        {"out 0x80, al",        "\xe6\x80", 2},
+    };
+
+    for (unsigned int i=0; i<sizeof(insns)/sizeof(insns[0]); ++i)
+    {
+        Source source;
+        source.name = "group.asm";
+        source.gas = false;
+        source.text = "[bits 64]\n";
+        source.text += insns[i].line;
+        source.text += '\n';
+
+        for (int match_index=0; match_index<2; ++match_index)
+        {
+            Result result;
+            Assemble(source, "match_index", match_index != 0, &result);
+            ASSERT_TRUE(result.ok) << insns[i].line;
+            EXPECT_EQ(std::string(insns[i].bytes, insns[i].len),
+                      result.output)
+                << insns[i].line << (match_index ? " (indexed)" : "");
+        }
+    }
+}
+
+// Reusing cached encodings must produce the same output (and errors) as
+// encoding every instruction.
+TEST_F(X86InsnMatchTest, EncodingCacheMatchesUncached)
+{
+    std::vector<Source> corpus = GetCorpus();
+    ASSERT_FALSE(corpus.empty());
+
+    for (std::vector<Source>::const_iterator i=corpus.begin(),
+         end=corpus.end(); i != end; ++i)
+    {
+        Result uncached, cached;
+        Assemble(*i, "encoding_cache", false, &uncached);
+        Assemble(*i, "encoding_cache", true, &cached);
+        EXPECT_EQ(uncached.ok, cached.ok) << i->name;
+        EXPECT_TRUE(uncached.output == cached.output) << i->name;
+        EXPECT_TRUE(uncached.diags == cached.diags) << i->name;
+    }
+}
+
+// Repeated register-only instructions reuse the first encoding; each
+// copy must come out the same, and the same as without the cache.
+TEST_F(X86InsnMatchTest, EncodingCacheRepeats)
+{
+    enum { NumCopies = 3 };
+    static const char* lines[] =
+    {
+        "vaddps ymm0, ymm1, ymm2", "pxor xmm0, xmm1", "mov eax, ebx",
+        "mov ax, bx", "add rax, rcx", "inc r8", "shl rdx, cl",
+    };
+
+    Source source;
+    source.name = "kernel.asm";
+    source.gas = false;
+    source.text = "[bits 64]\n";
+    for (int i=0; i<NumCopies; ++i)
+    {
+        for (unsigned int j=0; j<sizeof(lines)/sizeof(lines[0]); ++j)
+        {
+            source.text += lines[j];
+            source.text += '\n';
+        }
+    }
+
+    Result uncached, cached;
+    Assemble(source, "encoding_cache", false, &uncached);
+    Assemble(source, "encoding_cache", true, &cached);
+    ASSERT_TRUE(uncached.ok);
+    ASSERT_TRUE(cached.ok);
+    EXPECT_TRUE(uncached.output == cached.output);
+
+    std::string::size_type len = cached.output.size() / NumCopies;
+    ASSERT_EQ(len*NumCopies, cached.output.size());
+    // vaddps (4) pxor (4) mov (2) mov (3) add (3) inc (3) shl (3)
+    EXPECT_EQ(22U, len);
+    for (int i=1; i<NumCopies; ++i)
+        EXPECT_EQ(cached.output.substr(0, len),
+                  cached.output.substr(i*len, len)) << "copy " << i;
+}
+
+} // anonymous namespace
@@ -0,0 +1,182 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Parse/HeaderSearch.h"
+#include "yasmx/Parse/Token.h"
+
+#include "modules/parsers/gas/GasLexer.h"
+#include "modules/parsers/gas/GasPreproc.h"
+
+
+using namespace yasm;
+using namespace yasm::parser;
+
+namespace {
+
+class NullDiagConsumer : public DiagnosticConsumer
+{
+public:
+    void HandleDiagnostic(DiagnosticsEngine::Level level,
+                          const Diagnostic& info)
+    {}
+    DiagnosticConsumer* clone(DiagnosticsEngine& diags) const
+    {
+        return new NullDiagConsumer;
+    }
+};
+
+struct LexedToken
+{
+    unsigned int kind;
+    unsigned int offset;
+    unsigned int length;
+    bool start_of_line;
+    bool leading_space;
+};
+
+// Lex a buffer to the end, optionally recording each token.
+// Returns the number of tokens (including the final eof).
+unsigned long
+LexAll(llvm::StringRef in, std::vector<LexedToken>* out)
+{
+    NullDiagConsumer consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine diags(diagids, &consumer, false);
+    FileSystemOptions opts;
+    FileManager fmgr(opts);
+    SourceManager smgr(diags, fmgr);
+    diags.setSourceManager(&smgr);
+    HeaderSearch headers(fmgr);
+    GasPreproc pp(diags, smgr, headers);
+
+    smgr.createMainFileIDForMemBuffer(
+        llvm::MemoryBuffer::getMemBuffer(in, "<string>"));
+    pp.EnterMainSourceFile();
+
+    unsigned long n = 0;
+    Token tok;
+    do {
+        pp.Lex(&tok);
+        ++n;
+        if (out)
+        {
+            LexedToken t;
+            t.kind = tok.getKind();
+            t.offset = smgr.getFileOffset(tok.getLocation());
+            t.length = tok.getLength();
+            t.start_of_line = tok.isAtStartOfLine();
+            t.leading_space = tok.hasLeadingSpace();
+            out->push_back(t);
+        }
+    } while (tok.isNot(Token::eof));
+    return n;
+}
+
+} // anonymous namespace
+
+// Whitespace, comment, and identifier runs of every length up to several
+// vector widths, including runs that end right at the end of the buffer.
+TEST(GasLexerTest, Runs)
+{
+    static const char id_chars[] = "aZ_9.$";
+    for (unsigned int n=1; n<=70; ++n)
+    {
+        std::string id;
+        for (unsigned int i=0; i<n; ++i)
+            id += id_chars[i % (sizeof(id_chars)-1)];
+        id[0] = 'a';
+        std::string ws;
+        for (unsigned int i=0; i<n; ++i)
+            ws += (i % 3 == 2) ? '\t' : ' ';
+        std::string comment(n, 'c');
+        if (n >= 3)
+            comment[n/2] = '\\';    // not an escaped newline
+
+        // id <ws> x <ws> # comment \n <ws> y <ws> // comment \n id
+        std::string in = id + ws + "x" + ws + "#" + comment + "\n" +
+            ws + "y" + ws + "//" + comment + "\n" + id;
+        std::vector<LexedToken> toks;
+        LexAll(in, &toks);
+
+        std::vector<LexedToken> ids;
+        for (std::vector<LexedToken>::iterator i=toks.begin(), end=toks.end();
+             i != end; ++i)
+        {
+            if (i->kind == GasToken::identifier)
+                ids.push_back(*i);
+        }
+        ASSERT_EQ(4U, ids.size()) << "n=" << n;
+
+        EXPECT_EQ(0U, ids[0].offset);
+        EXPECT_EQ(n, ids[0].length);
+
+        EXPECT_EQ(2*n, ids[1].offset);
+        EXPECT_EQ(1U, ids[1].length);
+        EXPECT_TRUE(ids[1].leading_space);
+
+        unsigned int y_off = 5*n + 3;
+        EXPECT_EQ(y_off, ids[2].offset) << "n=" << n;
+        EXPECT_EQ(1U, ids[2].length);
+        EXPECT_TRUE(ids[2].leading_space);
+
+        EXPECT_EQ(in.size() - n, ids[3].offset) << "n=" << n;
+        EXPECT_EQ(n, ids[3].length);
+    }
+}
+
+// Characters outside the identifier set stop a long identifier wherever
+// they fall within a block, including bytes with the high bit set.
+TEST(GasLexerTest, LongIdentifierStops)
+{
+    static const char stops[] = {'+', ' ', ',', '\x80', '\xff'};
+    enum { Len = 48 };
+    for (unsigned int s=0; s<sizeof(stops); ++s)
+    {
+        for (unsigned int p=1; p<Len-1; ++p)
+        {
+            std::string in(Len, 'q');
+            in[p] = stops[s];
+            std::vector<LexedToken> toks;
+            LexAll(in, &toks);
+
+            ASSERT_LE(2U, toks.size()) << "p=" << p;
+            EXPECT_EQ(GasToken::identifier, toks[0].kind) << "p=" << p;
+            EXPECT_EQ(0U, toks[0].offset);
+            EXPECT_EQ(p, toks[0].length) << "p=" << p;
+            EXPECT_EQ(GasToken::identifier, toks[toks.size()-2].kind)
+                << "p=" << p;
+            EXPECT_EQ(Len-p-1, toks[toks.size()-2].length) << "p=" << p;
+        }
+    }
+}
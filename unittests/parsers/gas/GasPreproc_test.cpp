@@ -0,0 +1,138 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Parse/HeaderSearch.h"
+#include "yasmx/Parse/Token.h"
+
+#include "modules/parsers/gas/GasLexer.h"
+#include "modules/parsers/gas/GasPreproc.h"
+
+#include "unittests/diag_mock.h"
+
+
+using namespace yasm;
+using namespace yasm::parser;
+
+namespace {
+
+class GasPreprocTest : public ::testing::Test
+{
+protected:
+    GasPreprocTest()
+        : m_diagids(new DiagnosticIDs)
+        , m_diags(m_diagids, &m_consumer, false)
+        , m_fmgr(m_opts)
+        , m_smgr(m_diags, m_fmgr)
+        , m_headers(m_fmgr)
+        , m_pp(m_diags, m_smgr, m_headers)
+    {
+        m_diags.setSourceManager(&m_smgr);
+    }
+
+    // Register an in-memory file.  Includes are looked up relative to the
+    // including file, so headers are named "./name".
+    const FileEntry* AddFile(const char* name, const char* contents)
+    {
+        const FileEntry* file =
+            m_fmgr.getVirtualFile(name, std::strlen(contents), 0);
+        m_smgr.overrideFileContents(file,
+            llvm::MemoryBuffer::getMemBufferCopy(contents, name));
+        return file;
+    }
+
+    // Lex one line of the main file and include name at its end.
+    // Returns the tokens lexed up to the end of the next main file line.
+    void IncludeAndLex(const char* name, std::vector<Token>* toks)
+    {
+        Token tok;
+        do {
+            m_pp.Lex(&tok);
+        } while (tok.isNot(Token::eol));
+        ASSERT_TRUE(m_pp.HandleInclude(name, tok.getLocation()));
+        FileID main = m_smgr.getMainFileID();
+        for (;;)
+        {
+            m_pp.Lex(&tok);
+            if (m_smgr.getFileID(tok.getLocation()) == main)
+                break;
+            toks->push_back(tok);
+        }
+    }
+
+    ::testing::StrictMock<yasmunit::MockDiagnosticId> m_consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> m_diagids;
+    DiagnosticsEngine m_diags;
+    FileSystemOptions m_opts;
+    FileManager m_fmgr;
+    SourceManager m_smgr;
+    HeaderSearch m_headers;
+    GasPreproc m_pp;
+};
+
+} // anonymous namespace
+
+// A file included more than once is replayed from the tokens recorded the
+// first time, with locations in the new inclusion's FileID.
+TEST_F(GasPreprocTest, RepeatedInclude)
+{
+    AddFile("./hdr.s", ".set foo, 1\n\t.byte foo, \"str\" # comment\n");
+    m_smgr.createMainFileID(AddFile("main.s", "a\nb\nc\n"));
+    m_pp.EnterMainSourceFile();
+
+    std::vector<Token> first, second;
+    IncludeAndLex("hdr.s", &first);
+    IncludeAndLex("hdr.s", &second);
+    ASSERT_EQ(first.size(), second.size());
+    ASSERT_FALSE(first.empty());
+
+    FileID first_fid = m_smgr.getFileID(first[0].getLocation());
+    FileID second_fid = m_smgr.getFileID(second[0].getLocation());
+    EXPECT_NE(first_fid, second_fid);
+    EXPECT_EQ(m_smgr.getFileEntryForID(first_fid),
+              m_smgr.getFileEntryForID(second_fid));
+
+    for (std::vector<Token>::size_type i=0; i<first.size(); ++i)
+    {
+        EXPECT_EQ(first[i].getKind(), second[i].getKind()) << "token " << i;
+        EXPECT_EQ(first[i].getLength(), second[i].getLength());
+        EXPECT_EQ(first[i].isAtStartOfLine(), second[i].isAtStartOfLine());
+        EXPECT_EQ(first[i].hasLeadingSpace(), second[i].hasLeadingSpace());
+        EXPECT_EQ(first[i].getIdentifierInfo(),
+                  second[i].getIdentifierInfo());
+        EXPECT_EQ(second_fid, m_smgr.getFileID(second[i].getLocation()));
+        EXPECT_EQ(m_smgr.getFileOffset(first[i].getLocation()),
+                  m_smgr.getFileOffset(second[i].getLocation()));
+        EXPECT_EQ(m_pp.getSpelling(first[i]), m_pp.getSpelling(second[i]));
+    }
+}
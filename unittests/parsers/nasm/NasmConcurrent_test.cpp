@@ -0,0 +1,137 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/System/plugin.h"
+
+#include "unittests/unittest_util.h"
+
+
+using namespace yasm;
+
+namespace {
+
+// Generate a distinct NASM source for each index.  Each one exercises the
+// preprocessor (macros, %rep, %assign, context-local labels, %if with
+// expression evaluation) as well as multi-word integer arithmetic.
+std::string
+MakeSource(int n)
+{
+    llvm::SmallString<1024> ss;
+    llvm::raw_svector_ostream os(ss);
+    os << "%define SEED " << n << "\n"
+       << "%macro emit 2\n"
+       << "%push emit\n"
+       << "%$top:\n"
+       << "    mov eax, %1 + SEED\n"
+       << "    add eax, %2\n"
+       << "    jnz %$top\n"
+       << "%pop\n"
+       << "%endmacro\n"
+       << "global entry" << n << "\n"
+       << "section .text\n"
+       << "entry" << n << ":\n"
+       << "%assign i 0\n"
+       << "%rep " << (50 + n*7) << "\n"
+       << "    emit i, SEED*i\n"
+       << "%if (i % 3) == " << (n % 3) << "\n"
+       << "    call entry" << n << "\n"
+       << "%endif\n"
+       << "%assign i i+1\n"
+       << "%endrep\n"
+       << "    ret\n"
+       << "section .data\n"
+       << "big: dq 0xfedcba9876543210 + " << n << "\n"
+       << "     dq (0xfedcba9876543210 >> " << (n % 8) << ") * 3\n"
+       << "msg: db \"source " << n << "\", __LINE__\n";
+    return os.str();
+}
+
+// Assemble source to ELF64 and return the object file contents.
+bool
+Assemble(const std::string* source, std::string* output)
+{
+    return yasmunit::AssembleNasm(*source, "elf64", output);
+}
+
+void
+AssembleTask(const std::string* source, std::string* output, bool* ok)
+{
+    *ok = Assemble(source, output);
+}
+
+class NasmConcurrentTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_TRUE(LoadStandardPlugins());
+    }
+};
+
+TEST_F(NasmConcurrentTest, ByteIdentical)
+{
+    enum { NumSources = 16, NumThreads = 4, NumRounds = 3 };
+
+    std::vector<std::string> sources;
+    std::vector<std::string> expected(NumSources);
+    for (int i=0; i<NumSources; ++i)
+    {
+        sources.push_back(MakeSource(i));
+        ASSERT_TRUE(Assemble(&sources[i], &expected[i])) << "source " << i;
+        ASSERT_FALSE(expected[i].empty());
+    }
+
+    // Run several copies of every source at once so that identical and
+    // differing assemblies overlap.
+    std::vector<std::string> outputs(NumSources*NumRounds);
+    bool oks[NumSources*NumRounds];
+    {
+        ThreadPool pool(NumThreads);
+        for (int i=0; i<NumSources*NumRounds; ++i)
+        {
+            oks[i] = false;
+            pool.Async(TR1::bind(&AssembleTask, &sources[i % NumSources],
+                                 &outputs[i], &oks[i]));
+        }
+        pool.Wait();
+    }
+
+    for (int i=0; i<NumSources*NumRounds; ++i)
+    {
+        EXPECT_TRUE(oks[i]) << "task " << i;
+        EXPECT_TRUE(outputs[i] == expected[i % NumSources]) << "task " << i;
+    }
+}
+
+} // anonymous namespace
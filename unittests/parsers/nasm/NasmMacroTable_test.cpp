@@ -0,0 +1,100 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/System/plugin.h"
+
+#include "unittests/unittest_util.h"
+
+
+using namespace yasm;
+
+namespace {
+
+// As many macros as a macro-heavy source defines, so the lookup tables
+// grow well past any fixed bucket count.
+enum { NumDefines = 100000, NumMacros = 10000 };
+
+// Define NumDefines single-line macros and NumMacros multi-line macros,
+// then expand every one of them.  Each single-line macro emits one dword
+// equal to its index; each multi-line macro emits its index and argument.
+std::string
+MakeSource()
+{
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    for (int i=0; i<NumDefines; ++i)
+        os << "%define sym" << i << " " << i << "\n";
+    for (int i=0; i<NumMacros; ++i)
+        os << "%macro mac" << i << " 1\n"
+           << "dd " << i << ", %1\n"
+           << "%endmacro\n";
+    for (int i=0; i<NumDefines; ++i)
+        os << "dd sym" << i << "\n";
+    for (int i=0; i<NumMacros; ++i)
+        os << "mac" << i << " sym" << (i*7 % NumDefines) << "\n";
+    os.flush();
+    return str;
+}
+
+unsigned long
+GetDword(const std::string& s, size_t i)
+{
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(s.data()) + i*4;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+class NasmMacroTableTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_TRUE(LoadStandardPlugins());
+    }
+};
+
+// Every macro must still be found after the tables have been resized.
+TEST_F(NasmMacroTableTest, ManyMacros)
+{
+    std::string source = MakeSource();
+    std::string output;
+    ASSERT_TRUE(yasmunit::AssembleNasm(source, "bin", &output));
+
+    ASSERT_EQ(4u*(NumDefines + 2*NumMacros), output.size());
+    for (size_t i=0; i<NumDefines; ++i)
+        ASSERT_EQ(i, GetDword(output, i)) << "sym" << i;
+    for (size_t i=0; i<NumMacros; ++i)
+    {
+        ASSERT_EQ(i, GetDword(output, NumDefines + 2*i)) << "mac" << i;
+        ASSERT_EQ(i*7 % NumDefines, GetDword(output, NumDefines + 2*i + 1))
+            << "mac" << i;
+    }
+}
+
+} // anonymous namespace
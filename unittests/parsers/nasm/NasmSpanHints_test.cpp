@@ -0,0 +1,144 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/System/plugin.h"
+
+#include "unittests/unittest_util.h"
+
+
+using namespace yasm;
+
+namespace {
+
+const char incbin_filename[] = "nasm_spanhints_test.bin";
+const char hints_filename[] = "nasm_spanhints_test.hints";
+
+// The first jump only expands once the second one has (so its expansion
+// is recorded as a hint), and only if the included file is large enough.
+const char source[] =
+    "bits 32\n"
+    "jmp target\n"
+    "incbin \"nasm_spanhints_test.bin\"\n"
+    "jmp later\n"
+    "target:\n"
+    "times 200 nop\n"
+    "later:\n";
+
+void
+WriteIncbin(unsigned int size)
+{
+    std::string err;
+    llvm::raw_fd_ostream os(incbin_filename, err,
+                            llvm::raw_fd_ostream::F_Binary);
+    ASSERT_TRUE(err.empty());
+    os << std::string(size, '\x90');
+}
+
+// Assemble source to a flat binary, optionally with span hints, and
+// return its contents.
+bool
+Assemble(bool use_hints, std::string* output)
+{
+    return yasmunit::AssembleNasm(source, "bin", output,
+                                  use_hints ? hints_filename : "");
+}
+
+class NasmSpanHintsTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_TRUE(LoadStandardPlugins());
+    }
+
+    ~NasmSpanHintsTest()
+    {
+        std::remove(incbin_filename);
+        std::remove(hints_filename);
+    }
+};
+
+// Hints recorded while the included file was large must not be used once
+// it shrinks.
+TEST_F(NasmSpanHintsTest, IncbinChanged)
+{
+    std::string output;
+    WriteIncbin(124);
+    ASSERT_TRUE(Assemble(true, &output));
+    ASSERT_EQ(5U+124U+5U+200U, output.size());
+    EXPECT_EQ('\xe9', output[0]);
+
+    // Unchanged input reuses the hints and gives the same output.
+    std::string again;
+    ASSERT_TRUE(Assemble(true, &again));
+    EXPECT_TRUE(output == again);
+
+    WriteIncbin(100);
+    std::string clean, hinted;
+    ASSERT_TRUE(Assemble(false, &clean));
+    ASSERT_TRUE(Assemble(true, &hinted));
+    ASSERT_EQ(2U+100U+5U+200U, clean.size());
+    EXPECT_EQ('\xeb', clean[0]);
+    EXPECT_TRUE(clean == hinted);
+}
+
+// A hint recorded before an edit must not keep a jump long once the
+// edit lets it be short, even when the code the jump itself covers is
+// unchanged.
+TEST_F(NasmSpanHintsTest, EditShrinksSpan)
+{
+    static const char edited[] =
+        "bits 32\n"
+        "jmp a\n"
+        "jmp b\n"
+        "times 124 nop\n"
+        "a:\n"
+        "times %u nop\n"
+        "b:\n"
+        "ret\n";
+    char text[sizeof(edited)+8];
+
+    std::string output;
+    std::sprintf(text, edited, 10U);
+    ASSERT_TRUE(yasmunit::AssembleNasm(text, "bin", &output,
+                                       hints_filename));
+    ASSERT_EQ(5U+5U+124U+10U+1U, output.size());
+
+    std::sprintf(text, edited, 0U);
+    std::string clean, hinted;
+    ASSERT_TRUE(yasmunit::AssembleNasm(text, "bin", &clean));
+    ASSERT_TRUE(yasmunit::AssembleNasm(text, "bin", &hinted,
+                                       hints_filename));
+    ASSERT_EQ(2U+2U+124U+1U, clean.size());
+    EXPECT_EQ(std::string("\xeb\x7e\xeb\x7c", 4), clean.substr(0, 4));
+    EXPECT_TRUE(clean == hinted);
+}
+
+} // anonymous namespace
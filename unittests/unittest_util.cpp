@@ -24,10 +24,32 @@
 //
 #include "unittest_util.h"
 
+#include <cstdio>
 #include <ostream>
 #include <string>
 
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Parse/HeaderSearch.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Assembler.h"
+
+
+using namespace yasm;
+
+namespace {
+class QuietDiagConsumer : public DiagnosticConsumer
+{
+public:
+    DiagnosticConsumer* clone(DiagnosticsEngine& diags) const
+    {
+        return new QuietDiagConsumer;
+    }
+};
+} // anonymous namespace
 
 
 namespace yasmunit
@@ -44,4 +66,81 @@ operator<< (std::ostream& os, const llvm::format_object_base& fmt)
     return os;
 }
 
+AssembleOptions::AssembleOptions()
+    : parser("nasm")
+    , objfmt("bin")
+    , source_name("unittest.asm")
+    , arch_value(0)
+    , consumer(0)
+{
+}
+
+bool
+Assemble(const std::string& source,
+         const AssembleOptions& options,
+         std::string* output)
+{
+    QuietDiagConsumer quiet;
+    DiagnosticConsumer* consumer = options.consumer;
+    if (!consumer)
+        consumer = &quiet;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine diags(diagids, consumer, false);
+    FileSystemOptions opts;
+    FileManager fmgr(opts);
+    SourceManager smgr(diags, fmgr);
+    diags.setSourceManager(&smgr);
+    HeaderSearch headers(fmgr);
+
+    Assembler assembler("x86", options.objfmt, diags);
+    assembler.setObjectFilename("unittest.out");
+    if (!options.hints_filename.empty())
+        assembler.setSpanHints(options.hints_filename, "options");
+    if (!options.arch_var.empty() &&
+        !assembler.getArch()->setVar(options.arch_var, options.arch_value))
+        return false;
+    if (!assembler.setParser(options.parser, diags))
+        return false;
+
+    smgr.createMainFileIDForMemBuffer(
+        llvm::MemoryBuffer::getMemBuffer(source, options.source_name));
+    if (!assembler.InitObject(smgr, diags))
+        return false;
+    assembler.InitParser(smgr, diags, headers);
+    if (!assembler.Assemble(smgr, diags))
+        return false;
+
+    // Object formats may seek, so output to a real file.
+    std::FILE* f = std::tmpfile();
+    if (!f)
+        return false;
+    bool ok;
+    {
+        llvm::raw_fd_ostream os(fileno(f), false);
+        ok = assembler.Output(os, diags);
+    }
+    if (ok)
+    {
+        std::rewind(f);
+        char buf[4096];
+        size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+            output->append(buf, n);
+    }
+    std::fclose(f);
+    return ok && !diags.hasErrorOccurred();
+}
+
+bool
+AssembleNasm(const std::string& source,
+             llvm::StringRef objfmt,
+             std::string* output,
+             llvm::StringRef hints_filename)
+{
+    AssembleOptions options;
+    options.objfmt = objfmt;
+    options.hints_filename = hints_filename;
+    return Assemble(source, options, output);
+}
+
 } // namespace yasmunit
@@ -30,13 +30,16 @@
 /// @endlicense
 ///
 #include <iosfwd>
+#include <string>
 
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Config/export.h"
 
 
 namespace llvm { class format_object_base; }
+namespace yasm { class DiagnosticConsumer; }
 
 namespace yasmunit
 {
@@ -45,6 +48,46 @@ namespace yasmunit
 YASM_UNIT_EXPORT
 std::ostream& operator<< (std::ostream& os, const llvm::format_object_base& fmt);
 
+/// Options for Assemble().
+struct YASM_UNIT_EXPORT AssembleOptions
+{
+    AssembleOptions();
+
+    std::string parser;             ///< parser keyword
+    std::string objfmt;             ///< object format keyword
+    std::string source_name;        ///< name of the source buffer
+    std::string hints_filename;     ///< span hints file (empty for none)
+    std::string arch_var;           ///< arch variable to set (empty for none)
+    unsigned long arch_value;       ///< value of arch_var
+
+    /// Diagnostic consumer; if null, diagnostics are discarded.
+    yasm::DiagnosticConsumer* consumer;
+};
+
+/// Assemble a source for x86 with a fresh assembler.  The standard plugins
+/// must already be loaded.
+/// @param source           source text
+/// @param options          parser, object format, etc.
+/// @param output           object file contents (appended)
+/// @return True if the source assembled and was output without errors.
+YASM_UNIT_EXPORT
+bool Assemble(const std::string& source,
+              const AssembleOptions& options,
+              std::string* output);
+
+/// Assemble a NASM source for x86 with a fresh assembler, discarding any
+/// diagnostics.  The standard plugins must already be loaded.
+/// @param source           source text
+/// @param objfmt           object format keyword
+/// @param output           object file contents (appended)
+/// @param hints_filename   span hints file (empty to not use hints)
+/// @return True if the source assembled and was output without errors.
+YASM_UNIT_EXPORT
+bool AssembleNasm(const std::string& source,
+                  llvm::StringRef objfmt,
+                  std::string* output,
+                  llvm::StringRef hints_filename = llvm::StringRef());
+
 } // namespace yasmunit
 
 namespace String
@@ -0,0 +1,176 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "yasmx/Support/Arena.h"
+#include "yasmx/Bytecode.h"
+
+
+using yasm::Arena;
+
+namespace {
+// Counts live instances.
+struct Counted
+{
+    Counted() { ++live; }
+    ~Counted() { --live; }
+
+    static void* operator new(std::size_t size)
+    { return Arena::Allocate(size); }
+    static void operator delete(void* p, std::size_t size)
+    { Arena::Deallocate(p, size); }
+
+    static int live;
+    char data[40];
+};
+int Counted::live = 0;
+} // anonymous namespace
+
+TEST(ArenaTest, HeapWithoutScope)
+{
+    void* p = Arena::Allocate(16);
+    ASSERT_TRUE(p != 0);
+    std::memset(p, 0xAA, 16);
+    Arena::Deallocate(p, 16);
+    Arena::Deallocate(0, 16);
+}
+
+TEST(ArenaTest, SequentialAllocations)
+{
+    Arena* arena = new Arena;
+    {
+        Arena::Scope scope(arena);
+        char* a = static_cast<char*>(Arena::Allocate(24));
+        char* b = static_cast<char*>(Arena::Allocate(24));
+        // Bump allocation: b directly follows a (and its header).
+        EXPECT_LT(a, b);
+        EXPECT_GE(b - a, 24);
+        EXPECT_LE(b - a, 48);
+        EXPECT_EQ(0u, reinterpret_cast<unsigned long>(b) % sizeof(double));
+        Arena::Deallocate(a, 24);
+        Arena::Deallocate(b, 24);
+    }
+    delete arena;
+}
+
+TEST(ArenaTest, LargeAllocations)
+{
+    Arena* arena = new Arena;
+    {
+        Arena::Scope scope(arena);
+        char* small1 = static_cast<char*>(Arena::Allocate(8));
+        char* big = static_cast<char*>(Arena::Allocate(1024*1024));
+        std::memset(big, 0x55, 1024*1024);
+        char* small2 = static_cast<char*>(Arena::Allocate(8));
+        // The large allocation gets its own chunk.
+        EXPECT_LE(small2 - small1, 16);
+        Arena::Deallocate(big, 1024*1024);
+        Arena::Deallocate(small1, 8);
+        Arena::Deallocate(small2, 8);
+    }
+    delete arena;
+}
+
+TEST(ArenaTest, NestedScopes)
+{
+    Arena* outer = new Arena;
+    Arena* inner = new Arena;
+    Counted *a, *b, *c, *d;
+    {
+        Arena::Scope scope1(outer);
+        a = new Counted;
+        {
+            Arena::Scope scope2(inner);
+            b = new Counted;
+            {
+                Arena::Scope scope3(0);
+                c = new Counted;    // heap
+            }
+        }
+        d = new Counted;
+    }
+    EXPECT_EQ(4, Counted::live);
+    // a and d are adjacent in the outer arena.
+    EXPECT_LE(reinterpret_cast<char*>(d) - reinterpret_cast<char*>(a), 56);
+    delete a;
+    delete b;
+    delete c;
+    delete d;
+    EXPECT_EQ(0, Counted::live);
+    delete outer;
+    delete inner;
+}
+
+// Freed arena memory is reused by the next allocation of the same size,
+// but only on the thread the arena is current on.
+TEST(ArenaTest, ReuseSameSize)
+{
+    Arena* arena = new Arena;
+    {
+        Arena::Scope scope(arena);
+        Counted* a = new Counted;
+        delete a;
+        EXPECT_EQ(0, Counted::live);
+        Counted* b = new Counted;
+        EXPECT_EQ(a, b);
+
+        // A different size doesn't use the freed block.
+        void* c = Arena::Allocate(8);
+        Arena::Deallocate(c, 8);
+        Counted* d = new Counted;
+        EXPECT_NE(c, static_cast<void*>(d));
+        void* e = Arena::Allocate(8);
+        EXPECT_EQ(c, e);
+        Arena::Deallocate(e, 8);
+
+        // Freed while another arena is current: not reused.
+        {
+            Arena::Scope other(0);
+            delete b;
+        }
+        Counted* f = new Counted;
+        EXPECT_NE(b, f);
+        delete d;
+        delete f;
+    }
+    delete arena;
+}
+
+TEST(ArenaTest, Bytecodes)
+{
+    Arena* arena = new Arena;
+    {
+        Arena::Scope scope(arena);
+        yasm::Bytecode::Ptr bc1(new yasm::Bytecode);
+        yasm::Bytecode::Ptr bc2(new yasm::Bytecode);
+        bc1->getFixed().push_back(1);
+        bc2->getFixed().push_back(2);
+        EXPECT_EQ(1, bc1->getFixed()[0]);
+        EXPECT_EQ(2, bc2->getFixed()[0]);
+    }
+    delete arena;
+}
@@ -0,0 +1,209 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Expr.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+#include "unittests/diag_mock.h"
+
+using namespace yasm;
+
+class BytecodeContainerTest : public ::testing::Test
+{
+protected:
+    yasmunit::MockDiagnosticConsumer mock_consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids;
+    DiagnosticsEngine diags;
+    BytecodeContainer container;
+
+    BytecodeContainerTest()
+        : diagids(new DiagnosticIDs)
+        , diags(diagids, &mock_consumer, false)
+        , container(0)
+    {}
+
+    // Start a new bytecode with len bytes of fixed data.
+    Bytecode& Append(unsigned int len)
+    {
+        Bytecode& bc = container.StartBytecode();
+        bc.getFixed().Write(len, 0);
+        bc.setIndex(container.size()-1);
+        return bc;
+    }
+
+    Bytecode& Get(int i) { return *(container.bytecodes_begin() + i); }
+
+    // TIMES contents consisting of a single fixed-only bytecode.
+    std::auto_ptr<BytecodeContainer> Contents(unsigned int len)
+    {
+        std::auto_ptr<BytecodeContainer> contents(new BytecodeContainer(0));
+        Bytes& fixed = contents->bytecodes_front().getFixed();
+        for (unsigned int i=0; i<len; ++i)
+            fixed.push_back(static_cast<unsigned char>(i+1));
+        return contents;
+    }
+
+    std::auto_ptr<Expr> Count(long n)
+    {
+        return std::auto_ptr<Expr>(new Expr(IntNum(n)));
+    }
+};
+
+TEST_F(BytecodeContainerTest, UpdateOffsets)
+{
+    container.bytecodes_front().setIndex(0);
+    for (int i=0; i<4; ++i)
+        Append(2);
+    container.UpdateOffsets(diags);
+    EXPECT_EQ(0UL, Get(0).getOffset());
+    for (unsigned long i=1; i<5; ++i)
+        EXPECT_EQ(2*(i-1), Get(i).getOffset());
+    EXPECT_EQ(8UL, container.bytecodes_back().getNextOffset());
+
+    // Bytecodes appended later are picked up by the next update.
+    Append(3);
+    container.UpdateOffsets(diags);
+    EXPECT_EQ(8UL, container.bytecodes_back().getOffset());
+    EXPECT_EQ(11UL, container.bytecodes_back().getNextOffset());
+}
+
+TEST_F(BytecodeContainerTest, InvalidateOffsets)
+{
+    container.bytecodes_front().setIndex(0);
+    for (int i=0; i<4; ++i)
+        Append(2);
+    container.UpdateOffsets(diags);
+
+    // A length change is not seen until it's noted.
+    Bytecode& bc = Get(2);
+    bc.getFixed().Write(4, 0);
+    container.UpdateOffsets(diags);
+    EXPECT_EQ(4UL, Get(3).getOffset());
+
+    container.InvalidateOffsets(bc);
+    container.UpdateOffsets(diags);
+    EXPECT_EQ(0UL, Get(1).getOffset());
+    EXPECT_EQ(2UL, Get(2).getOffset());
+    EXPECT_EQ(8UL, Get(3).getOffset());
+    EXPECT_EQ(10UL, Get(4).getOffset());
+
+    // Invalidating everything recomputes from the start.
+    Get(1).getFixed().Write(1, 0);
+    container.InvalidateOffsets();
+    container.UpdateOffsets(diags);
+    EXPECT_EQ(3UL, Get(2).getOffset());
+    EXPECT_EQ(13UL, container.bytecodes_back().getNextOffset());
+}
+
+TEST_F(BytecodeContainerTest, AppendMultipleConstant)
+{
+    Append(1);
+    AppendMultiple(container, Contents(2), Count(3), SourceLocation());
+
+    // merged into the fixed portion of the last bytecode
+    ASSERT_EQ(2U, container.size());
+    const Bytecode& bc = container.bytecodes_back();
+    EXPECT_FALSE(bc.hasContents());
+    ASSERT_EQ(7UL, bc.getFixedLen());
+    for (int i=0; i<3; ++i)
+    {
+        EXPECT_EQ(1, bc.getFixed()[1+2*i]);
+        EXPECT_EQ(2, bc.getFixed()[2+2*i]);
+    }
+}
+
+TEST_F(BytecodeContainerTest, AppendMultipleZero)
+{
+    Append(1);
+    AppendMultiple(container, Contents(2), Count(0), SourceLocation());
+    ASSERT_EQ(2U, container.size());
+    EXPECT_FALSE(container.bytecodes_back().hasContents());
+    EXPECT_EQ(1UL, container.bytecodes_back().getFixedLen());
+
+    // empty contents produce nothing, however large the count
+    AppendMultiple(container, Contents(0), Count(300000000),
+                   SourceLocation());
+    ASSERT_EQ(2U, container.size());
+    EXPECT_EQ(1UL, container.bytecodes_back().getFixedLen());
+}
+
+TEST_F(BytecodeContainerTest, AppendMultipleNegative)
+{
+    // not merged; the multiple bytecode reports the negative count later
+    AppendMultiple(container, Contents(2), Count(-1), SourceLocation());
+    EXPECT_TRUE(container.bytecodes_back().hasContents());
+    EXPECT_EQ(0UL, container.bytecodes_back().getFixedLen());
+}
+
+TEST_F(BytecodeContainerTest, AppendMultipleFixup)
+{
+    // contents referencing a label need a relocation per copy
+    Symbol label_sym("label");
+    std::auto_ptr<BytecodeContainer> contents(new BytecodeContainer(0));
+    contents->bytecodes_front().AppendFixed(4,
+        std::auto_ptr<Expr>(new Expr(SymbolRef(&label_sym))),
+        SourceLocation());
+    AppendMultiple(container, contents, Count(3), SourceLocation());
+    EXPECT_TRUE(container.bytecodes_back().hasContents());
+    EXPECT_EQ(0UL, container.bytecodes_back().getFixedLen());
+}
+
+TEST_F(BytecodeContainerTest, InsnSources)
+{
+    Object object("x", "y", 0);
+    Section* sect = new Section("x", true, false, SourceLocation());
+    object.AppendSection(std::auto_ptr<Section>(sect));
+    SourceLocation first = SourceLocation::getFromRawEncoding(10);
+    SourceLocation second = SourceLocation::getFromRawEncoding(20);
+
+    // nothing is recorded unless the object asks for it
+    EXPECT_FALSE(sect->isTrackingInsnSources());
+
+    // instructions sharing one bytecode's fixed bytes each keep their start
+    object.getOptions().TrackInsnSources = true;
+    EXPECT_TRUE(sect->isTrackingInsnSources());
+    Location start = sect->getEndLoc();
+    sect->FreshBytecode().getFixed().Write(2, 0);
+    sect->AddInsnSource(start, first);
+    start = sect->getEndLoc();
+    sect->FreshBytecode().getFixed().Write(3, 0);
+    sect->AddInsnSource(start, second);
+
+    const BytecodeContainer::InsnSources& insns = sect->getInsnSources();
+    ASSERT_EQ(2U, insns.size());
+    EXPECT_EQ(&sect->bytecodes_front(), insns[0].loc.bc);
+    EXPECT_EQ(0UL, insns[0].loc.off);
+    EXPECT_EQ(first, insns[0].source);
+    EXPECT_EQ(&sect->bytecodes_front(), insns[1].loc.bc);
+    EXPECT_EQ(2UL, insns[1].loc.off);
+    EXPECT_EQ(second, insns[1].source);
+}
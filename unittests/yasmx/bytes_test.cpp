@@ -0,0 +1,140 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "yasmx/Bytes.h"
+
+using namespace yasm;
+
+// Count heap allocations made through operator new so the tests can
+// check that short contents stay inline.  (Bytes grows its heap storage with malloc(), but none of
+// the encodings below are large enough to need it.)
+static unsigned long num_allocs = 0;
+
+void*
+operator new(std::size_t size) throw(std::bad_alloc)
+{
+    ++num_allocs;
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void
+operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+TEST(BytesTest, Inline)
+{
+    Bytes bytes;
+    unsigned long allocs = num_allocs;
+    for (int i=0; i<Bytes::INLINE_SIZE; ++i)
+        bytes.push_back(i);
+    EXPECT_EQ(allocs, num_allocs);
+    ASSERT_EQ(static_cast<Bytes::size_type>(Bytes::INLINE_SIZE),
+              bytes.size());
+    for (int i=0; i<Bytes::INLINE_SIZE; ++i)
+        EXPECT_EQ(i, bytes[i]);
+
+    // Growing past the inline size moves to the heap.
+    bytes.push_back(0xff);
+    EXPECT_LT(static_cast<Bytes::size_type>(Bytes::INLINE_SIZE),
+              bytes.capacity());
+    EXPECT_EQ(0, bytes[0]);
+    EXPECT_EQ(0xff, bytes.back());
+}
+
+TEST(BytesTest, Swap)
+{
+    Bytes a, b;
+    a.Write(3, 0x11);
+    a.setBigEndian();
+    b.Write(40, 0x22);
+    b.setLittleEndian();
+
+    a.swap(b);
+    ASSERT_EQ(40U, a.size());
+    EXPECT_EQ(0x22, a[39]);
+    EXPECT_TRUE(a.isLittleEndian());
+    ASSERT_EQ(3U, b.size());
+    EXPECT_EQ(0x11, b[2]);
+    EXPECT_TRUE(b.isBigEndian());
+}
+
+TEST(BytesTest, Copy)
+{
+    Bytes a;
+    a.WriteString("abc");
+    a.setBigEndian();
+    Bytes b(a);
+    EXPECT_EQ(3U, b.size());
+    EXPECT_EQ('c', b[2]);
+    EXPECT_TRUE(b.isBigEndian());
+
+    Bytes c;
+    c.Write(100, 0);
+    c = a;
+    EXPECT_EQ(3U, c.size());
+    EXPECT_EQ('a', c.front());
+}
+
+TEST(BytesTest, At)
+{
+    Bytes a;
+    a.push_back(5);
+    EXPECT_EQ(5, a.at(0));
+    EXPECT_THROW(a.at(1), std::out_of_range);
+}
+
+// Every instruction-sized encoding (1 to 15 bytes, as in the fixed
+// portion of x86 bytecodes) fits inline, including copies.
+TEST(BytesTest, Encodings)
+{
+    std::vector<Bytes> encodings(15);
+    unsigned long allocs = num_allocs;
+    for (int i=0; i<15; ++i)
+    {
+        for (int j=0; j<=i; ++j)
+            encodings[i].push_back(static_cast<unsigned char>(j));
+    }
+    std::vector<Bytes> copies(encodings.begin(), encodings.end());
+    // Only the outer vector allocates.
+    EXPECT_EQ(allocs+1, num_allocs);
+
+    for (int i=0; i<15; ++i)
+    {
+        ASSERT_EQ(static_cast<Bytes::size_type>(i+1), copies[i].size());
+        EXPECT_EQ(static_cast<Bytes::size_type>(Bytes::INLINE_SIZE),
+                  copies[i].capacity());
+        EXPECT_EQ(i, copies[i].back());
+    }
+}
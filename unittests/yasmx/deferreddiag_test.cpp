@@ -0,0 +1,98 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+
+
+using namespace yasm;
+
+namespace {
+// Records the presumed line and formatted text of the last diagnostic.
+class LastDiagConsumer : public DiagnosticConsumer
+{
+public:
+    LastDiagConsumer() : m_line(0) {}
+
+    void HandleDiagnostic(DiagnosticsEngine::Level level,
+                          const Diagnostic& info)
+    {
+        DiagnosticConsumer::HandleDiagnostic(level, info);
+        m_id = info.getID();
+        m_line = info.getSourceManager().getPresumedLoc(info.getLocation())
+            .getLine();
+        llvm::SmallString<100> str;
+        info.FormatDiagnostic(str);
+        m_str = str.str();
+    }
+
+    DiagnosticConsumer* clone(DiagnosticsEngine& diags) const
+    {
+        return new LastDiagConsumer;
+    }
+
+    unsigned int m_id;
+    unsigned int m_line;
+    std::string m_str;
+};
+
+// A worker engine reporting into a DeferredDiagConsumer has no source
+// manager; the raw location is only resolved when replayed.
+TEST(DeferredDiagTest, ReplayWithoutSourceManager)
+{
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    LastDiagConsumer consumer;
+    DiagnosticsEngine diags(diagids, &consumer, false);
+    FileSystemOptions opts;
+    FileManager fmgr(opts);
+    SourceManager smgr(diags, fmgr);
+    diags.setSourceManager(&smgr);
+
+    FileID fid = smgr.createMainFileIDForMemBuffer(
+        llvm::MemoryBuffer::getMemBufferCopy("a\nb\nc\n", "<test>"));
+    SourceLocation loc = smgr.getLocForStartOfFile(fid).getLocWithOffset(4);
+
+    DeferredDiagConsumer deferred;
+    DiagnosticsEngine worker(diagids, &deferred, false);
+    ASSERT_FALSE(worker.hasSourceManager());
+    std::string arg("foo");
+    worker.Report(loc, diag::warn_unknown_warning_option) << arg;
+    EXPECT_FALSE(deferred.empty());
+    EXPECT_EQ(0u, consumer.getNumWarnings());
+
+    deferred.Replay(diags);
+    EXPECT_EQ(1u, consumer.getNumWarnings());
+    EXPECT_EQ(static_cast<unsigned int>(diag::warn_unknown_warning_option),
+              consumer.m_id);
+    EXPECT_EQ(3u, consumer.m_line);
+    EXPECT_EQ("unknown warning option 'foo'", consumer.m_str);
+}
+} // anonymous namespace
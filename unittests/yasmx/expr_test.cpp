@@ -24,6 +24,8 @@
 //
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
@@ -216,6 +218,47 @@ TEST_F(ExprTest, Simplify)
     EXPECT_EQ("5", String::Format(x));
 }
 
+// Identical expressions are simplified from a memo; check that results
+// still take their sources from the expression being simplified.
+TEST_F(ExprTest, SimplifyMemo)
+{
+    yasmunit::MockDiagnosticConsumer mock_consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine diags(diagids, &mock_consumer, false);
+    FileSystemOptions opts;
+    FileManager fmgr(opts);
+    SourceManager smgr(diags, fmgr);
+    diags.setSourceManager(&smgr);
+
+    std::vector<unsigned int> first;
+    for (unsigned int base=100; base<=300; base+=100)
+    {
+        x = SUB(MUL(ADD(15, a, 16), 1), b);
+        ExprTerms& terms = x.getTerms();
+        for (unsigned int i=0; i<terms.size(); ++i)
+            terms[i].setSource(SourceLocation::getFromRawEncoding(base+i));
+
+        x.Simplify(diags);
+        EXPECT_EQ("a+31+(b*-1)", String::Format(x));
+
+        std::vector<unsigned int> sources;
+        for (unsigned int i=0; i<terms.size(); ++i)
+            sources.push_back(terms[i].getSource().getRawEncoding() - base);
+        if (first.empty())
+            first = sources;
+        else
+            EXPECT_EQ(first, sources);
+    }
+
+    // Leaf values must match, not just structure.
+    x = SUB(MUL(ADD(15, a, 17), 1), b);
+    x.Simplify(diags);
+    EXPECT_EQ("a+32+(b*-1)", String::Format(x));
+    x = SUB(MUL(ADD(15, c, 16), 1), b);
+    x.Simplify(diags);
+    EXPECT_EQ("c+31+(b*-1)", String::Format(x));
+}
+
 //
 // Expr::LevelOp() tests
 //
@@ -0,0 +1,170 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "yasmx/Support/IntervalIndex.h"
+#include "yasmx/Support/IntervalTree.h"
+
+using namespace yasm;
+
+namespace {
+// Collects enumerated data.
+class Collect
+{
+public:
+    Collect(std::vector<int>& out) : m_out(out) {}
+    void operator() (int data) { m_out.push_back(data); }
+    void operator() (IntervalTreeNode<int>* node)
+    { m_out.push_back(node->getData()); }
+private:
+    std::vector<int>& m_out;
+};
+
+// Simple deterministic generator so results don't depend on the platform.
+class Random
+{
+public:
+    Random() : m_state(12345) {}
+    long operator() (long n)
+    {
+        m_state = m_state * 1103515245UL + 12345UL;
+        return static_cast<long>((m_state >> 16) & 0x7fff) % n;
+    }
+private:
+    unsigned long m_state;
+};
+} // anonymous namespace
+
+TEST(IntervalIndexTest, Empty)
+{
+    IntervalIndex<int> index;
+    index.Build();
+    EXPECT_TRUE(index.empty());
+    std::vector<int> out;
+    index.Enumerate(0, 100, Collect(out));
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(IntervalIndexTest, Basic)
+{
+    IntervalIndex<int> index;
+    index.Insert(10, 20, 1);
+    index.Insert(0, 5, 0);
+    index.Insert(15, 15, 2);
+    index.Insert(21, 30, 3);
+    index.Build();
+    EXPECT_EQ(4U, index.size());
+
+    std::vector<int> out;
+    index.Enumerate(15, 15, Collect(out));
+    ASSERT_EQ(2U, out.size());
+    EXPECT_EQ(1, out[0]);
+    EXPECT_EQ(2, out[1]);
+
+    // endpoints are inclusive
+    out.clear();
+    index.Enumerate(20, 21, Collect(out));
+    ASSERT_EQ(2U, out.size());
+    EXPECT_EQ(1, out[0]);
+    EXPECT_EQ(3, out[1]);
+
+    out.clear();
+    index.Enumerate(6, 9, Collect(out));
+    EXPECT_TRUE(out.empty());
+
+    // enumerated in low endpoint order
+    out.clear();
+    index.Enumerate(0, 100, Collect(out));
+    ASSERT_EQ(4U, out.size());
+    for (int i=0; i<4; ++i)
+        EXPECT_EQ(i, out[i]);
+}
+
+TEST(IntervalIndexTest, MatchesIntervalTree)
+{
+    Random rand;
+    // Sizes around powers of two exercise the partial rightmost subtree.
+    int sizes[] = {1, 2, 3, 7, 8, 9, 15, 16, 17, 100, 1023, 1024, 1025};
+    for (unsigned int s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s)
+    {
+        IntervalIndex<int> index;
+        IntervalTree<int> tree;
+        for (int i=0; i<sizes[s]; ++i)
+        {
+            long low = rand(2000);
+            long high = low + rand(rand(10) == 0 ? 1000 : 20);
+            index.Insert(low, high, i);
+            tree.Insert(low, high, i);
+        }
+        index.Build();
+
+        for (long q=0; q<3000; q+=7)
+        {
+            long qhigh = q + rand(3) * rand(50);
+            std::vector<int> index_out, tree_out;
+            index.Enumerate(q, qhigh, Collect(index_out));
+            tree.Enumerate(q, qhigh, Collect(tree_out));
+            std::sort(index_out.begin(), index_out.end());
+            std::sort(tree_out.begin(), tree_out.end());
+            EXPECT_EQ(tree_out, index_out) << "size " << sizes[s]
+                                           << " query " << q;
+        }
+    }
+}
+
+// Inserting after a Build() and building again must not keep the old
+// subtree maxima around.
+TEST(IntervalIndexTest, Rebuild)
+{
+    IntervalIndex<int> index;
+    index.Insert(0, 1000, 0);
+    index.Insert(10, 20, 1);
+    index.Insert(30, 40, 2);
+    index.Build();
+
+    // Sorts ahead of everything else, so every node moves one slot right.
+    index.Insert(-10, -5, 3);
+    index.Build();
+
+    std::vector<int> out;
+    index.Enumerate(500, 600, Collect(out));
+    ASSERT_EQ(1U, out.size());
+    EXPECT_EQ(0, out[0]);
+
+    out.clear();
+    index.Enumerate(-7, 15, Collect(out));
+    ASSERT_EQ(3U, out.size());
+    EXPECT_EQ(3, out[0]);
+    EXPECT_EQ(0, out[1]);
+    EXPECT_EQ(1, out[2]);
+
+    out.clear();
+    index.Enumerate(41, 41, Collect(out));
+    ASSERT_EQ(1U, out.size());
+    EXPECT_EQ(0, out[0]);
+}
@@ -25,7 +25,10 @@
 #include <gtest/gtest.h>
 
 #include <cstdio>
+#include <limits>
 
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/IntNum.h"
@@ -546,4 +549,148 @@ TEST_P(IntNumGetSizedTest, Overwrite)
 }
 
 INSTANTIATE_TEST_CASE_P(IntNumGetSizedTests, IntNumGetSizedTest,
-                        ::testing::ValuesIn(GetSizedLongTestValues));
\ No newline at end of file
+                        ::testing::ValuesIn(GetSizedLongTestValues));
+namespace {
+typedef IntNumData::SmallValue SmallValue;
+
+const SmallValue SV_MAX = std::numeric_limits<SmallValue>::max();
+const SmallValue SV_MIN = std::numeric_limits<SmallValue>::min();
+
+// Values around the overflow boundaries of each operation.
+const SmallValue calc_values[] =
+{
+    0, 1, -1, 2, -2, 3, -3, 63, 100, -100,
+    0x7fffffffLL, -0x7fffffffLL-1, 0x80000000LL, 0xffffffffLL,
+    0x100000000LL, -0x100000000LL, 0x123456789LL,
+    0x3fffffffffffffffLL, 0x4000000000000000LL, -0x4000000000000000LL,
+    SV_MAX, SV_MAX-1, SV_MIN, SV_MIN+1, SV_MAX/3, SV_MIN/3
+};
+
+const SmallValue shift_values[] =
+{
+    0, 1, 2, 31, 32, 61, 62, 63, 64, 65, 100, 127, 128, 200,
+    -1, -2, -62, -63, -64, -65, -100
+};
+
+// Compute an operation with full bit vectors.
+llvm::APInt
+CalcBV(Op::Op op, SmallValue lhs, SmallValue rhs)
+{
+    unsigned int bits = IntNum::BITVECT_NATIVE_SIZE;
+    llvm::APInt x(bits, static_cast<uint64_t>(lhs), true);
+    llvm::APInt y(bits, static_cast<uint64_t>(rhs), true);
+    switch (op)
+    {
+        case Op::ADD:       return x + y;
+        case Op::SUB:       return x - y;
+        case Op::MUL:       return x * y;
+        case Op::SIGNDIV:   return x.sdiv(y);
+        case Op::SIGNMOD:   return x.srem(y);
+        case Op::NEG:       return -x;
+        case Op::NOT:       return ~x;
+        case Op::AND:       return x & y;
+        case Op::OR:        return x | y;
+        case Op::XOR:       return x ^ y;
+        case Op::SHL:       return rhs >= 0 ? x.shl(rhs) : x.ashr(-rhs);
+        case Op::SHR:       return rhs >= 0 ? x.ashr(rhs) : x.shl(-rhs);
+        default:            return x;
+    }
+}
+
+std::string
+BVStr(const llvm::APInt& bv)
+{
+    llvm::SmallString<80> str;
+    bv.toString(str, 10, true);
+    return str.str();
+}
+} // anonymous namespace
+
+// Small value computations (including ones that overflow a small value)
+// must match full bit vector computations.
+TEST(IntNumCalcTest, MatchesBV)
+{
+    static const Op::Op binary_ops[] =
+    {
+        Op::ADD, Op::SUB, Op::MUL, Op::SIGNDIV, Op::SIGNMOD,
+        Op::AND, Op::OR, Op::XOR
+    };
+    static const int num_values = sizeof(calc_values)/sizeof(calc_values[0]);
+    static const int num_shifts =
+        sizeof(shift_values)/sizeof(shift_values[0]);
+
+    for (int i=0; i<num_values; ++i)
+    {
+        SmallValue lhs = calc_values[i];
+
+        for (int j=0; j<num_values; ++j)
+        {
+            SmallValue rhs = calc_values[j];
+            for (unsigned int k=0; k<sizeof(binary_ops)/sizeof(binary_ops[0]);
+                 ++k)
+            {
+                Op::Op op = binary_ops[k];
+                if (rhs == 0 && (op == Op::SIGNDIV || op == Op::SIGNMOD))
+                    continue;
+                IntNum x(lhs);
+                x.CalcAssert(op, IntNum(rhs));
+                EXPECT_EQ(BVStr(CalcBV(op, lhs, rhs)), x.getStr())
+                    << lhs << " op " << op << " " << rhs;
+            }
+        }
+
+        for (int j=0; j<num_shifts; ++j)
+        {
+            SmallValue rhs = shift_values[j];
+            IntNum x(lhs);
+            x.CalcAssert(Op::SHL, IntNum(rhs));
+            EXPECT_EQ(BVStr(CalcBV(Op::SHL, lhs, rhs)), x.getStr())
+                << lhs << " << " << rhs;
+            x = lhs;
+            x.CalcAssert(Op::SHR, IntNum(rhs));
+            EXPECT_EQ(BVStr(CalcBV(Op::SHR, lhs, rhs)), x.getStr())
+                << lhs << " >> " << rhs;
+        }
+
+        IntNum x(lhs);
+        x.CalcAssert(Op::NEG);
+        EXPECT_EQ(BVStr(CalcBV(Op::NEG, lhs, 0)), x.getStr()) << "-" << lhs;
+        x = lhs;
+        x.CalcAssert(Op::NOT);
+        EXPECT_EQ(BVStr(CalcBV(Op::NOT, lhs, 0)), x.getStr()) << "~" << lhs;
+    }
+}
+
+// Chains of operations whose intermediate values fit in a small value but
+// fall outside the half range, or whose products overflow a small value,
+// must match the same computation on full bit vectors.
+TEST(IntNumCalcTest, Chains)
+{
+    unsigned int bits = IntNum::BITVECT_NATIVE_SIZE;
+    static const SmallValue starts[] = {0, 1, 77, 0x7fff, 0x12345678, 999999};
+
+    for (unsigned int i=0; i<sizeof(starts)/sizeof(starts[0]); ++i)
+    {
+        SmallValue v = starts[i];
+
+        IntNum x(v);
+        x *= IntNum(0x123456789LL);
+        x += IntNum(SV_MAX/4);
+        x <<= 1;
+        x -= IntNum(SV_MAX/2);
+
+        llvm::APInt bx(bits, static_cast<uint64_t>(v), true);
+        bx *= llvm::APInt(bits, 0x123456789ULL);
+        bx += llvm::APInt(bits, static_cast<uint64_t>(SV_MAX/4));
+        bx = bx.shl(1);
+        bx -= llvm::APInt(bits, static_cast<uint64_t>(SV_MAX/2));
+        EXPECT_EQ(BVStr(bx), x.getStr()) << "small chain from " << v;
+
+        IntNum y(v + 0x10000000000LL);
+        y *= IntNum(v + 0x20000000000LL);
+
+        llvm::APInt by(bits, static_cast<uint64_t>(v + 0x10000000000LL));
+        by *= llvm::APInt(bits, static_cast<uint64_t>(v + 0x20000000000LL));
+        EXPECT_EQ(BVStr(by), y.getStr()) << "overflowing chain from " << v;
+    }
+}
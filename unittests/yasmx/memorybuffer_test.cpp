@@ -0,0 +1,89 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unistd.h>
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/system_error.h"
+
+
+using llvm::MemoryBuffer;
+
+namespace {
+// Write a file of the given size and read it back as a MemoryBuffer.
+void
+CheckFileBuffer(size_t size, bool expect_mmap)
+{
+    std::string contents;
+    for (size_t i=0; i<size; ++i)
+        contents += "abcdefghijklmnopqrstuvwxyz\n"[i % 27];
+
+    int fd;
+    llvm::SmallString<128> path;
+    ASSERT_FALSE(llvm::sys::fs::unique_file("yasm-membuf-%%%%%%.s", fd, path));
+    ASSERT_EQ(ssize_t(size), ::write(fd, contents.data(), size));
+    ::close(fd);
+
+    llvm::OwningPtr<MemoryBuffer> buf;
+    llvm::error_code ec = MemoryBuffer::getFile(path.str(), buf);
+    bool existed;
+    llvm::sys::fs::remove(path.str(), existed);
+    ASSERT_FALSE(ec);
+
+    if (expect_mmap)
+    {
+        EXPECT_EQ(MemoryBuffer::MemoryBuffer_MMap, buf->getBufferKind());
+    }
+    EXPECT_EQ(path.str(), buf->getBufferIdentifier());
+    ASSERT_EQ(size, buf->getBufferSize());
+    EXPECT_EQ(contents, buf->getBuffer().str());
+    EXPECT_EQ(0, buf->getBufferEnd()[0]);
+}
+} // anonymous namespace
+
+TEST(MemoryBufferTest, SmallFile)
+{
+    CheckFileBuffer(100, false);
+}
+
+TEST(MemoryBufferTest, MappedFile)
+{
+    size_t page = llvm::sys::Process::GetPageSize();
+    CheckFileBuffer(8*page + 100, true);
+}
+
+// A file that exactly fills its last page is still mapped, with a zero page
+// after it providing the null terminator.
+TEST(MemoryBufferTest, MappedPageMultiple)
+{
+    size_t page = llvm::sys::Process::GetPageSize();
+    CheckFileBuffer(8*page, true);
+}
@@ -0,0 +1,210 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+
+
+using namespace yasm;
+
+namespace {
+class SourceLineCursorTest : public ::testing::Test
+{
+protected:
+    SourceLineCursorTest()
+        : m_diagids(new DiagnosticIDs)
+        , m_diags(m_diagids, 0, false)
+        , m_fmgr(m_opts)
+        , m_smgr(m_diags, m_fmgr)
+    {
+        m_diags.setSourceManager(&m_smgr);
+    }
+
+    FileID AddFile(const char* name, llvm::StringRef contents)
+    {
+        return m_smgr.createFileIDForMemBuffer(
+            llvm::MemoryBuffer::getMemBufferCopy(contents, name));
+    }
+
+    void AddLineNote(FileID fid, unsigned int offset, unsigned int line,
+                     const char* name)
+    {
+        m_smgr.AddLineNote(
+            m_smgr.getLocForStartOfFile(fid).getLocWithOffset(offset), line,
+            name ? m_smgr.getLineTableFilenameID(name) : -1);
+    }
+
+    // Check a lookup against getPresumedLoc().
+    void Check(SourceLineCursor& cursor, SourceLocation loc)
+    {
+        PresumedLoc expected = m_smgr.getPresumedLoc(loc);
+        const char* filename;
+        unsigned int line;
+        ASSERT_TRUE(cursor.Lookup(loc, &filename, &line));
+        EXPECT_STREQ(expected.getFilename(), filename)
+            << "offset " << m_smgr.getFileOffset(loc);
+        EXPECT_EQ(expected.getLine(), line)
+            << "offset " << m_smgr.getFileOffset(loc);
+    }
+
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> m_diagids;
+    DiagnosticsEngine m_diags;
+    FileSystemOptions m_opts;
+    FileManager m_fmgr;
+    SourceManager m_smgr;
+};
+
+const char text[] =
+    "mov eax, 1\n"
+    "\n"
+    "add eax, 2\r\n"
+    "%line 10+1 a.asm\n"
+    "nop\n"
+    "nop\n"
+    "%line 3+1 b.asm\n"
+    "\r"
+    "ret\n"
+    "%line 40+1\n"
+    "int 3";
+} // anonymous namespace
+
+TEST_F(SourceLineCursorTest, Invalid)
+{
+    SourceLineCursor cursor(m_smgr);
+    const char* filename;
+    unsigned int line;
+    EXPECT_FALSE(cursor.Lookup(SourceLocation(), &filename, &line));
+}
+
+TEST_F(SourceLineCursorTest, Forward)
+{
+    FileID fid = AddFile("main.asm", text);
+    SourceLocation start = m_smgr.getLocForStartOfFile(fid);
+
+    SourceLineCursor cursor(m_smgr);
+    for (unsigned int i=0; i<sizeof(text)-1; ++i)
+        Check(cursor, start.getLocWithOffset(i));
+}
+
+TEST_F(SourceLineCursorTest, LineDirectives)
+{
+    FileID fid = AddFile("main.asm", text);
+    const char* pos = std::strstr(text, "%line 10");
+    AddLineNote(fid, std::strchr(pos, '\n') - text, 10, "a.asm");
+    pos = std::strstr(text, "%line 3");
+    AddLineNote(fid, std::strchr(pos, '\n') - text, 3, "b.asm");
+    pos = std::strstr(text, "%line 40");
+    AddLineNote(fid, std::strchr(pos, '\n') - text, 40, 0);
+    SourceLocation start = m_smgr.getLocForStartOfFile(fid);
+
+    SourceLineCursor cursor(m_smgr);
+    for (unsigned int i=0; i<sizeof(text)-1; ++i)
+        Check(cursor, start.getLocWithOffset(i));
+
+    const char* filename;
+    unsigned int line;
+    ASSERT_TRUE(cursor.Lookup(
+        start.getLocWithOffset(std::strstr(text, "ret") - text),
+        &filename, &line));
+    EXPECT_STREQ("b.asm", filename);
+    EXPECT_EQ(3U, line);    // "\n\r" is a single line break
+
+    // Backwards, and skipping around.
+    for (unsigned int i=sizeof(text)-1; i>0; --i)
+        Check(cursor, start.getLocWithOffset(i-1));
+    for (unsigned int i=0; i<sizeof(text)-1; ++i)
+        Check(cursor, start.getLocWithOffset((i*7) % (sizeof(text)-1)));
+}
+
+TEST_F(SourceLineCursorTest, LongFile)
+{
+    std::string contents;
+    for (int i=0; i<1000; ++i)
+        contents += (i % 3 == 0) ? "\n" : "nop\n";
+    FileID fid = AddFile("long.asm", contents);
+    SourceLocation start = m_smgr.getLocForStartOfFile(fid);
+
+    // Far jumps forward and back.
+    SourceLineCursor cursor(m_smgr);
+    for (unsigned int i=0; i<contents.size(); i += 97)
+        Check(cursor, start.getLocWithOffset(i));
+    for (int i=contents.size()-1; i >= 0; i -= 97)
+        Check(cursor, start.getLocWithOffset(i));
+}
+
+TEST_F(SourceLineCursorTest, MultipleFiles)
+{
+    FileID fid1 = AddFile("one.asm", text);
+    FileID fid2 = AddFile("two.asm", "a\nb\nc\n");
+    SourceLocation start1 = m_smgr.getLocForStartOfFile(fid1);
+    SourceLocation start2 = m_smgr.getLocForStartOfFile(fid2);
+
+    SourceLineCursor cursor(m_smgr);
+    for (unsigned int i=0; i<6; ++i)
+    {
+        Check(cursor, start1.getLocWithOffset(i*3));
+        Check(cursor, start2.getLocWithOffset(i));
+    }
+}
+
+// Lookups of every line in order, as when generating DWARF line
+// information, across many line directives; then a few going backwards.
+TEST_F(SourceLineCursorTest, ManyLineNotes)
+{
+    enum { NUM_LINES = 1000, DIRECTIVE_EVERY = 64 };
+    std::string contents;
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> directives;
+    for (unsigned int i=0; i<NUM_LINES; ++i)
+    {
+        if (i % DIRECTIVE_EVERY == 0)
+        {
+            contents += "%line 1+1 notes.asm\n";
+            directives.push_back(contents.size()-1);
+        }
+        offsets.push_back(contents.size());
+        contents += "    mov eax, [ebx+4]\n";
+    }
+    FileID fid = AddFile("notes.asm", contents);
+    for (std::vector<unsigned int>::const_iterator i=directives.begin(),
+         end=directives.end(); i != end; ++i)
+        AddLineNote(fid, *i, (i-directives.begin())*DIRECTIVE_EVERY+1,
+                    "notes.asm");
+    SourceLocation start = m_smgr.getLocForStartOfFile(fid);
+
+    SourceLineCursor cursor(m_smgr);
+    for (std::vector<unsigned int>::const_iterator i=offsets.begin(),
+         end=offsets.end(); i != end; ++i)
+        Check(cursor, start.getLocWithOffset(*i));
+    for (int i=NUM_LINES; i>0; i-=97)
+        Check(cursor, start.getLocWithOffset(offsets[i-1]));
+}
@@ -0,0 +1,165 @@
+//
+//  Copyright (C) 2012  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/SpanHints.h"
+
+#include "unittests/diag_mock.h"
+
+using namespace yasm;
+
+class SpanHintsTest : public ::testing::Test
+{
+protected:
+    yasmunit::MockDiagnosticConsumer mock_consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids;
+    DiagnosticsEngine diags;
+    FileSystemOptions opts;
+    FileManager fmgr;
+    SourceManager smgr;
+    const char* filename;
+
+    SpanHintsTest()
+        : diagids(new DiagnosticIDs)
+        , diags(diagids, &mock_consumer, false)
+        , fmgr(opts)
+        , smgr(diags, fmgr)
+        , filename("spanhints_test.hints")
+    {
+        diags.setSourceManager(&smgr);
+        smgr.createMainFileIDForMemBuffer(
+            llvm::MemoryBuffer::getMemBuffer("jmp foo\n", "<string>"));
+    }
+
+    ~SpanHintsTest()
+    {
+        std::remove(filename);
+    }
+
+    static SpanHints::Hint MakeHint(const char* section,
+                                    unsigned long index,
+                                    int id,
+                                    long min_value,
+                                    long value)
+    {
+        SpanHints::Hint hint;
+        hint.section = section;
+        hint.index = index;
+        hint.id = id;
+        hint.min_value = min_value;
+        hint.value = value;
+        return hint;
+    }
+};
+
+TEST_F(SpanHintsTest, RoundTrip)
+{
+    {
+        SpanHints hints;
+        hints.setKey("options", smgr);
+        EXPECT_FALSE(hints.Read(filename));     // no file yet
+        hints.Add(MakeHint(".text", 7, 1, 100, 300));
+        hints.Add(MakeHint(".text", 3, 2, 50, -200));
+        hints.Add(MakeHint(".text", 7, 1, 100, 400));  // replaces the first
+        hints.Add(MakeHint(".text", 3, 1, 50, 0x7fffffffL));
+        hints.Add(MakeHint(".data", 7, 1, -10, 500));
+        ASSERT_TRUE(hints.Write(filename));
+    }
+
+    SpanHints hints;
+    hints.setKey("options", smgr);
+    ASSERT_TRUE(hints.Read(filename));
+
+    long value = 0;
+    EXPECT_TRUE(hints.Lookup(".text", 7, 1, 100, &value));
+    EXPECT_EQ(400, value);
+    EXPECT_TRUE(hints.Lookup(".text", 3, 2, 50, &value));
+    EXPECT_EQ(-200, value);
+    EXPECT_TRUE(hints.Lookup(".text", 3, 1, 50, &value));
+    EXPECT_EQ(0x7fffffffL, value);
+    EXPECT_TRUE(hints.Lookup(".data", 7, 1, -10, &value));
+    EXPECT_EQ(500, value);
+
+    // Must match section, index, and id.
+    EXPECT_FALSE(hints.Lookup(".text", 7, 2, 100, &value));
+    EXPECT_FALSE(hints.Lookup(".text", 8, 1, 100, &value));
+    EXPECT_FALSE(hints.Lookup(".bss", 7, 1, 100, &value));
+
+    // A span that now covers different code doesn't use the hint.
+    EXPECT_FALSE(hints.Lookup(".text", 7, 1, 101, &value));
+}
+
+TEST_F(SpanHintsTest, KeyMismatch)
+{
+    {
+        SpanHints hints;
+        hints.setKey("options", smgr);
+        hints.Add(MakeHint(".text", 1, 1, 10, 500));
+        ASSERT_TRUE(hints.Write(filename));
+    }
+
+    long value;
+    SpanHints other_options;
+    other_options.setKey("other options", smgr);
+    EXPECT_FALSE(other_options.Read(filename));
+    EXPECT_FALSE(other_options.Lookup(".text", 1, 1, 10, &value));
+
+    // Different source contents.
+    smgr.createFileIDForMemBuffer(
+        llvm::MemoryBuffer::getMemBuffer("jmp bar\n", "<include>"));
+    SpanHints other_source;
+    other_source.setKey("options", smgr);
+    EXPECT_FALSE(other_source.Read(filename));
+    EXPECT_FALSE(other_source.Lookup(".text", 1, 1, 10, &value));
+}
+
+TEST_F(SpanHintsTest, Corrupt)
+{
+    {
+        SpanHints hints;
+        hints.setKey("options", smgr);
+        hints.Add(MakeHint(".text", 1, 1, 10, 500));
+        ASSERT_TRUE(hints.Write(filename));
+    }
+
+    // Replace the file with a truncated header.
+    {
+        std::string err;
+        llvm::raw_fd_ostream os(filename, err, llvm::raw_fd_ostream::F_Binary);
+        ASSERT_TRUE(err.empty());
+        os << "YSHT";
+    }
+
+    SpanHints hints;
+    hints.setKey("options", smgr);
+    EXPECT_FALSE(hints.Read(filename));
+}
@@ -147,6 +147,32 @@ TEST_F(ValueTest, ConstructSymbol)
     EXPECT_EQ(8U, v.getSize());
 }
 
+TEST_F(ValueTest, Assign)
+{
+    Value v(6, Expr::Ptr(new Expr(sym1)));
+    Expr* e = v.getAbs();
+
+    // existing expression is reused
+    Value v2(8, Expr::Ptr(new Expr(ADD(sym2, 5))));
+    v = v2;
+    EXPECT_EQ(e, v.getAbs());
+    EXPECT_EQ("sym2+5", String::Format(*v.getAbs()));
+    EXPECT_EQ("sym2+5", String::Format(*v2.getAbs()));
+    EXPECT_EQ(8U, v.getSize());
+
+    // and dropped when there's nothing to copy
+    Value v3(4);
+    v = v3;
+    EXPECT_FALSE(v.hasAbs());
+    EXPECT_EQ(4U, v.getSize());
+
+    // and cloned when there was none
+    v = v2;
+    ASSERT_TRUE(v.hasAbs());
+    EXPECT_NE(v2.getAbs(), v.getAbs());
+    EXPECT_EQ("sym2+5", String::Format(*v.getAbs()));
+}
+
 TEST_F(ValueTest, Finalize)
 {
     Object object("x", "y", 0);